@@ -272,7 +272,10 @@ class IDummyVideoCapabilities : public IVideoCapabilities
 {
 public:
 	IDummyVideoCapabilities() : IVideoCapabilities(), mVideoMode(320, 200, 8, false)
-	{	mModeList.push_back(mVideoMode);	}
+	{
+		mModeList.push_back(mVideoMode);
+		mModeList.push_back(IVideoMode(320, 200, 32, false));
+	}
 
 	virtual ~IDummyVideoCapabilities() { }
 
@@ -567,15 +570,17 @@ public:
 	virtual const IVideoMode* getVideoMode() const
 	{	return &mVideoMode;	}
 
+	// The surface is only in memory, so any size can be used, such as for
+	// timing the renderer with -timedemo
 	virtual bool setMode(uint16_t width, uint16_t height, uint8_t bpp, bool fullscreen, bool vsync)
 	{
-		if (mPrimarySurface == NULL)
+		if (mPrimarySurface == NULL || mVideoMode.getWidth() != width ||
+			mVideoMode.getHeight() != height || mVideoMode.getBitsPerPixel() != bpp)
 		{
-			// ignore the requested mode and setup the hardcoded mode
-			width = mVideoMode.getWidth();
-			height = mVideoMode.getHeight();
-			bpp = mVideoMode.getBitsPerPixel();
+			IWindowSurface* old_surface = mPrimarySurface;
+			mVideoMode = IVideoMode(width, height, bpp, false);
 			mPrimarySurface = I_AllocateSurface(width, height, bpp);
+			delete old_surface;
 		}
 		return mPrimarySurface != NULL;
 	}
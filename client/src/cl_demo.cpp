@@ -38,6 +38,7 @@
 #include "st_stuff.h"
 #include "p_mobj.h"
 #include "g_level.h"
+#include "g_game.h"
 
 EXTERN_CVAR(sv_maxclients)
 EXTERN_CVAR(sv_maxplayers)
@@ -669,6 +670,11 @@ bool NetDemo::stopPlaying()
 	}
 	
 	Printf(PRINT_HIGH, "Demo has ended.\n");
+
+	// exits the application
+	if (timingdemo)
+		G_FinishTimeDemo(filename);
+
 	reset();
     gameaction = ga_fullconsole;
     gamestate = GS_FULLCONSOLE;
@@ -1541,6 +1547,14 @@ void NetDemo::readSnapshotData(byte *buf, size_t length)
 
 	P_ClearAllNetIds();
 
+	// the packets that follow the snapshot are somewhere in the middle of
+	// the reliable stream
+	CL_ResyncReliable();
+
+	// the baselines of the delta-compressed states were left at the old
+	// position, so wait for a full state of each entity
+	CL_ResetNetDelta();
+
 	// Remove all players	
 	players.clear();
 
@@ -142,6 +142,12 @@ std::set<byte> teleported_players;
 // [SL] 2012-04-06 - moving sector snapshots received from the server
 std::map<unsigned short, SectorSnapshotManager> sector_snaps;
 
+// states received in delta-compressed movement messages
+static NetDeltaHistory netdelta_history;
+
+// reliable messages received through svc_reliable
+static NetReliableReceiver netreliable;
+
 EXTERN_CVAR (sv_weaponstay)
 
 EXTERN_CVAR (cl_predictsectors)
@@ -650,7 +656,9 @@ void CL_StepTics(unsigned int count)
 //
 void CL_DisplayTics()
 {
+	G_BeginTimeDemoFrame();
 	D_Display();
+	G_EndTimeDemoFrame();
 }
 
 //
@@ -1701,6 +1709,14 @@ bool CL_Connect(void)
 		CL_RequestDownload(missing_file, missing_hash);
 
 	compressor.reset();
+	netdelta_history.clear();
+
+	// a netdemo has no record of the reliable messages sent before it
+	// started, so it joins the stream at the first message it has
+	if (netdemo.isPlaying())
+		netreliable.resync();
+	else
+		netreliable.clear();
 
 	connected = true;
     multiplayer = true;
@@ -1814,6 +1830,9 @@ void CL_TryToConnect(DWORD server_token)
 
         MSG_WriteString(&net_buffer, (char *)connectpasshash.c_str());
 
+		// optional protocol features, ignored by servers that don't know them
+		MSG_WriteLong(&net_buffer, NETCAP_DELTASTATE | NETCAP_RELIABLE);
+
 		NET_SendPacket(net_buffer, serveraddr);
 		SZ_Clear(&net_buffer);
 	}
@@ -1934,29 +1953,31 @@ void CL_ClearPlayerJustTeleported(player_t *player)
 		teleported_players.erase(player->id);
 }
 
-void CL_UpdatePlayer()
+//
+// CL_ApplyPlayerMove
+//
+// Updates another player from the state sent in svc_moveplayer or
+// svc_moveplayer_delta.  The angles are in the short form used on the wire
+// and the extra field holds the invisibility power.
+//
+static void CL_ApplyPlayerMove(player_t *p, const NetEntityState &state)
 {
-	byte who = MSG_ReadByte();
-	player_t *p = &idplayer(who);
-
-	MSG_ReadLong();	// Read and ignore for now
-
-	fixed_t x = MSG_ReadLong();
-	fixed_t y = MSG_ReadLong();
-	fixed_t z = MSG_ReadLong();
+	if	(!validplayer(*p) || !p->mo)
+		return;
 
-	angle_t angle = MSG_ReadShort() << FRACBITS;
-	angle_t pitch = MSG_ReadShort() << FRACBITS;
+	fixed_t x = state.x;
+	fixed_t y = state.y;
+	fixed_t z = state.z;
 
-	int frame = MSG_ReadByte();
-	fixed_t momx = MSG_ReadLong();
-	fixed_t momy = MSG_ReadLong();
-	fixed_t momz = MSG_ReadLong();
+	angle_t angle = state.angle << FRACBITS;
+	angle_t pitch = state.pitch << FRACBITS;
 
-	int invisibility = MSG_ReadByte();
+	int frame = state.frame;
+	fixed_t momx = state.momx;
+	fixed_t momy = state.momy;
+	fixed_t momz = state.momz;
 
-	if	(!validplayer(*p) || !p->mo)
-		return;
+	int invisibility = state.extra;
 
 	// Mark the gametic this update arrived in for prediction code
 	p->tic = gametic;
@@ -2006,6 +2027,46 @@ void CL_UpdatePlayer()
 	p->snapshots.addSnapshot(newsnap);
 }
 
+void CL_UpdatePlayer()
+{
+	byte who = MSG_ReadByte();
+
+	MSG_ReadLong();	// Read and ignore for now
+
+	NetEntityState state;
+	state.x = MSG_ReadLong();
+	state.y = MSG_ReadLong();
+	state.z = MSG_ReadLong();
+
+	state.angle = MSG_ReadShort();
+	state.pitch = MSG_ReadShort();
+
+	state.frame = MSG_ReadByte();
+	state.momx = MSG_ReadLong();
+	state.momy = MSG_ReadLong();
+	state.momz = MSG_ReadLong();
+
+	state.extra = MSG_ReadByte();
+
+	CL_ApplyPlayerMove(&idplayer(who), state);
+}
+
+//
+// CL_UpdatePlayerDelta
+//
+void CL_UpdatePlayerDelta()
+{
+	byte who = MSG_ReadByte();
+
+	MSG_ReadLong();	// Read and ignore for now
+
+	NetEntityState state;
+	if (!netdelta_history.read(&net_message, NET_DELTA_PLAYERKEY | who, state))
+		return;
+
+	CL_ApplyPlayerMove(&idplayer(who), state);
+}
+
 BOOL P_GiveWeapon(player_t *player, weapontype_t weapon, BOOL dropped);
 
 void CL_UpdatePlayerState(void)
@@ -2052,6 +2113,35 @@ void CL_UpdatePlayerState(void)
 		P_SetPsprite(&player, i, stnum[i]);
 }
 
+//
+// CL_ApplyLocalPlayerMove
+//
+// Saves the console player's position from svc_updatelocalplayer or
+// svc_updatelocalplayer_delta.  The extra field holds the waterlevel.
+//
+static void CL_ApplyLocalPlayerMove(const NetEntityState &state)
+{
+	player_t &p = consoleplayer();
+
+	int snaptime = last_svgametic;
+	PlayerSnapshot newsnapshot(snaptime);
+	newsnapshot.setAuthoritative(true);
+	newsnapshot.setX(state.x);
+	newsnapshot.setY(state.y);
+	newsnapshot.setZ(state.z);
+	newsnapshot.setMomX(state.momx);
+	newsnapshot.setMomY(state.momy);
+	newsnapshot.setMomZ(state.momz);
+	newsnapshot.setWaterLevel(state.extra);
+
+	// Mark the snapshot as continuous unless the player just teleported
+	// and lerping should be disabled
+	newsnapshot.setContinuous(!CL_PlayerJustTeleported(&p));
+	CL_ClearPlayerJustTeleported(&p);
+
+	consoleplayer().snapshots.addSnapshot(newsnapshot);
+}
+
 //
 // CL_UpdateLocalPlayer
 //
@@ -2063,33 +2153,34 @@ void CL_UpdateLocalPlayer(void)
 	// during the the tic referenced below
 	p.tic = MSG_ReadLong();
 
-	fixed_t x = MSG_ReadLong();
-	fixed_t y = MSG_ReadLong();
-	fixed_t z = MSG_ReadLong();
+	NetEntityState state;
+	state.x = MSG_ReadLong();
+	state.y = MSG_ReadLong();
+	state.z = MSG_ReadLong();
 
-	fixed_t momx = MSG_ReadLong();
-	fixed_t momy = MSG_ReadLong();
-	fixed_t momz = MSG_ReadLong();
+	state.momx = MSG_ReadLong();
+	state.momy = MSG_ReadLong();
+	state.momz = MSG_ReadLong();
 
-	byte waterlevel = MSG_ReadByte();
+	state.extra = (byte)MSG_ReadByte();
 
-	int snaptime = last_svgametic;
-	PlayerSnapshot newsnapshot(snaptime);
-	newsnapshot.setAuthoritative(true);
-	newsnapshot.setX(x);
-	newsnapshot.setY(y);
-	newsnapshot.setZ(z);
-	newsnapshot.setMomX(momx);
-	newsnapshot.setMomY(momy);
-	newsnapshot.setMomZ(momz);
-	newsnapshot.setWaterLevel(waterlevel);
+	CL_ApplyLocalPlayerMove(state);
+}
 
-	// Mark the snapshot as continuous unless the player just teleported
-	// and lerping should be disabled
-	newsnapshot.setContinuous(!CL_PlayerJustTeleported(&p));
-	CL_ClearPlayerJustTeleported(&p);
+//
+// CL_UpdateLocalPlayerDelta
+//
+void CL_UpdateLocalPlayerDelta(void)
+{
+	player_t &p = consoleplayer();
 
-	consoleplayer().snapshots.addSnapshot(newsnapshot);
+	p.tic = MSG_ReadLong();
+
+	NetEntityState state;
+	if (!netdelta_history.read(&net_message, NET_DELTA_LOCALPLAYERKEY, state))
+		return;
+
+	CL_ApplyLocalPlayerMove(state);
 }
 
 
@@ -2459,6 +2550,51 @@ void CL_SetMobjSpeedAndAngle(void)
 	}
 }
 
+//
+// CL_MoveMobjDelta
+//
+// Combines svc_movemobj and svc_mobjspeedangle for servers sending
+// delta-compressed movement.  The extra field holds the rndindex.
+//
+void CL_MoveMobjDelta(void)
+{
+	int netid = MSG_ReadShort();
+
+	NetEntityState state;
+	if (!netdelta_history.read(&net_message, netid, state))
+		return;
+
+	AActor *mo = P_FindThingById(netid);
+	if (!mo)
+		return;
+
+	if (mo->player)
+	{
+		int snaptime = last_svgametic;
+		PlayerSnapshot newsnap(snaptime);
+		newsnap.setAuthoritative(true);
+
+		newsnap.setX(state.x);
+		newsnap.setY(state.y);
+		newsnap.setZ(state.z);
+		newsnap.setMomX(state.momx);
+		newsnap.setMomY(state.momy);
+		newsnap.setMomZ(state.momz);
+
+		mo->player->snapshots.addSnapshot(newsnap);
+	}
+	else
+	{
+		CL_MoveThing(mo, state.x, state.y, state.z);
+		mo->rndindex = state.extra;
+
+		mo->angle = state.angle;
+		mo->momx = state.momx;
+		mo->momy = state.momy;
+		mo->momz = state.momz;
+	}
+}
+
 //
 // CL_ExplodeMissile
 //
@@ -2525,6 +2661,7 @@ void CL_RemoveMobj(void)
 		displayplayer_id = consoleplayer_id;
 
 	P_ClearId(netid);
+	netdelta_history.clear(netid);
 }
 
 
@@ -2979,10 +3116,54 @@ void CL_CheckMissedPacket(void)
 	}
 }
 
+//
+// CL_ReadReliable
+//
+// Reads an svc_reliable record and parses every reliable message it
+// completes, in place of the rest of the packet until they are done.
+//
+void CL_ReadReliable(void)
+{
+	if (!netreliable.read(&net_message))
+		return;
+
+	buf_t &messages = netreliable.messages();
+	if (!messages.size())
+		return;
+
+	net_message.swap(messages);
+	CL_ParseCommands();
+	net_message.swap(messages);
+
+	messages.clear();
+}
+
+//
+// CL_ResyncReliable
+//
+// Netdemo snapshots skip over part of the reliable stream.
+//
+void CL_ResyncReliable(void)
+{
+	netreliable.resync();
+}
+
+//
+// CL_ResetNetDelta
+//
+// Forgets the baselines of every entity.  A delta whose baseline stamp
+// happens to match an entry from before a netdemo seek would otherwise be
+// decoded against the wrong state, so every entity has to be sent in full
+// again before its deltas are used.
+//
+void CL_ResetNetDelta(void)
+{
+	netdelta_history.clear();
+}
+
 // Decompress the packet sequence
-// [Russell] - reason this was failing is because of huffman routines, so just
-// use minilzo for now (cuts a packet size down by roughly 45%), huffman is the
-// if 0'd sections
+// The server compresses packets with minilzo only.  The adaptive huffman
+// codecs are not used.
 void CL_Decompress(int sequence)
 {
 	if(!MSG_BytesLeft() || MSG_NextByte() != svc_compressed)
@@ -2992,22 +3173,8 @@ void CL_Decompress(int sequence)
 
 	byte method = MSG_ReadByte();
 
-#if 0
-	if(method & adaptive_mask)
-		MSG_DecompressAdaptive(compressor.codec_for_received(method & adaptive_select_mask ? 1 : 0));
-	else
-	{
-		// otherwise compressed packets can still contain codec updates
-		compressor.codec_for_received(method & adaptive_select_mask ? 1 : 0);
-	}
-#endif
-
 	if(method & minilzo_mask)
 		MSG_DecompressMinilzo();
-#if 0
-	if(method & adaptive_record_mask)
-		compressor.ack_sent(net_message.ptr(), MSG_BytesLeft());
-#endif
 }
 
 //
@@ -3314,6 +3481,7 @@ void CL_LoadMap(void)
 
 	movingsectors.clear();
 	teleported_players.clear();
+	netdelta_history.clear();
 
 	CL_ClearSectorSnapshots();
 	for (Players::iterator it = players.begin();it != players.end();++it)
@@ -3502,6 +3670,8 @@ void CL_InitCommands(void)
 	cmds[svc_updatefrags]		= &CL_UpdateFrags;
 	cmds[svc_moveplayer]		= &CL_UpdatePlayer;
 	cmds[svc_updatelocalplayer]	= &CL_UpdateLocalPlayer;
+	cmds[svc_moveplayer_delta]	= &CL_UpdatePlayerDelta;
+	cmds[svc_updatelocalplayer_delta] = &CL_UpdateLocalPlayerDelta;
 	cmds[svc_userinfo]			= &CL_SetupUserInfo;
 	cmds[svc_teampoints]		= &CL_TeamPoints;
 	cmds[svc_playerstate]		= &CL_UpdatePlayerState;
@@ -3515,6 +3685,8 @@ void CL_InitCommands(void)
 
 	cmds[svc_killmobj]			= &CL_KillMobj;
 	cmds[svc_movemobj]			= &CL_MoveMobj;
+	cmds[svc_movemobj_delta]	= &CL_MoveMobjDelta;
+	cmds[svc_reliable]			= &CL_ReadReliable;
 	cmds[svc_damagemobj]		= &CL_DamageMobj;
 	cmds[svc_corpse]			= &CL_Corpse;
 	cmds[svc_spawnplayer]		= &CL_SpawnPlayer;
@@ -3653,6 +3825,21 @@ void CL_SendCmd(void)
 	if (netdemo.isPlaying())	// we're not really connected to a server
 		return;
 
+	// the server stops sending reliable messages until they are
+	// acknowledged, so acknowledgements go out even without a player
+	if (netreliable.ackPending())
+	{
+		MSG_WriteMarker(&net_buffer, clc_reliableack);
+		netreliable.writeAck(&net_buffer);
+
+		if (!p->mo || gametic < 1)
+		{
+			NET_SendPacket(net_buffer, serveraddr);
+			outrate += net_buffer.size();
+			SZ_Clear(&net_buffer);
+		}
+	}
+
 	if (!p->mo || gametic < 1 )
 		return;
 
@@ -53,6 +53,8 @@ void CL_RequestConnectInfo(void);
 bool CL_PrepareConnect(void);
 void CL_ParseCommands(void);
 void CL_ReadPacketHeader(void);
+void CL_ResyncReliable(void);
+void CL_ResetNetDelta(void);
 void CL_SendCmd(void);
 void CL_SaveCmd(void);
 void CL_MoveThing(AActor *mobj, fixed_t x, fixed_t y, fixed_t z);
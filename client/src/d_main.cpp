@@ -218,7 +218,8 @@ void D_DisplayTicker()
 //
 void D_Display()
 {
-	if (nodrawers || I_IsHeadless())
+	// headless clients only draw when timing the renderer
+	if (nodrawers || (I_IsHeadless() && !timingdemo))
 		return; 				// for comparative timing / profiling
 
 	BEGIN_STAT(D_Display);
@@ -886,8 +887,19 @@ void D_DoomMain()
 	p = Args.CheckParm("-timedemo");
 	if (p && p < Args.NumArgs() - 1)
 	{
-		singledemo = true;
-		G_TimeDemo(Args.GetArg(p + 1));
+		std::string demoarg = Args.GetArg(p + 1);
+		std::string ext;
+		M_ExtractFileExtension(demoarg, ext);
+
+		if (iequals(ext, "odd"))
+		{
+			G_TimeNetDemo(demoarg);
+		}
+		else
+		{
+			singledemo = true;
+			G_TimeDemo(Args.GetArg(p + 1));
+		}
 	}
 
 	// denis - this will run a demo and quit
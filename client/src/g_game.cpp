@@ -2229,8 +2229,8 @@ BOOL G_CheckDemoStatus (void)
 				Printf(PRINT_HIGH, "timed %i gametics in %i realtics (%.1f fps)\n",
 						gametic, realtics, fps);
 
-				// exit the application
-				CL_QuitCommand();
+				// exits the application
+				G_FinishTimeDemo(defdemoname);
 				return false;
 			}
 			else
@@ -528,13 +528,11 @@ void G_DoLoadLevel (int position)
 	}
 
 	// initialize the msecnode_t freelist.					phares 3/25/98
-	// any nodes in the freelist are gone by now, cleared
-	// by Z_FreeTags() when the previous level ended or player
-	// died.
+	// the nodes of the previous level go back to the pool,
+	// so no actor may hold on to them.
 
 	{
-		extern msecnode_t *headsecnode; // phares 3/25/98
-		headsecnode = NULL;
+		P_ClearSecnodes ();
 
 		// denis - todo - wtf is this crap?
 		// [RH] Need to prevent the AActor destructor from trying to
@@ -0,0 +1,267 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Frame timing for -timedemo
+//
+//	Each frame of the level that is drawn while a demo or netdemo is timed
+//	is measured with the tic profiler, so the report breaks the frames down
+//	by the scopes in the renderer and the HUD.  With -novideo the frames are
+//	drawn to a surface in memory, sized by -width, -height and -bits, so the
+//	renderer can be timed on machines without a display.  -timedemojson
+//	<file> also writes the report as JSON.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "doomtype.h"
+#include "doomstat.h"
+#include "c_cvars.h"
+#include "g_game.h"
+#include "i_system.h"
+#include "i_video.h"
+#include "m_argv.h"
+#include "stats.h"
+
+EXTERN_CVAR(r_optimize)
+EXTERN_CVAR(r_threads)
+
+void CL_NetDemoPlay(const std::string &filename);
+void CL_QuitCommand();
+
+static bool timedemo_inframe = false;
+static dtime_t timedemo_start = 0;		// when the first frame was started
+static dtime_t timedemo_end = 0;		// when the last frame was finished
+
+static std::vector<dtime_t> timedemo_frames;
+static std::map<const FProfileStat*, std::vector<dtime_t> > timedemo_scopes;
+
+//
+// G_TimeNetDemo
+//
+void G_TimeNetDemo(const std::string& filename)
+{
+	nodrawers = Args.CheckParm("-nodraw");
+	noblit = Args.CheckParm("-noblit");
+	timingdemo = true;
+
+	CL_NetDemoPlay(filename);
+}
+
+//
+// G_BeginTimeDemoFrame
+//
+// Called before each frame is drawn.  Only the frames of the level itself
+// are measured.
+//
+void G_BeginTimeDemoFrame()
+{
+	timedemo_inframe = timingdemo && !nodrawers && gamestate == GS_LEVEL;
+	if (!timedemo_inframe)
+		return;
+
+	if (timedemo_frames.empty())
+		timedemo_start = I_GetTime();
+
+	Prof_BeginTic(true);
+}
+
+//
+// G_EndTimeDemoFrame
+//
+void G_EndTimeDemoFrame()
+{
+	if (!timedemo_inframe)
+		return;
+
+	timedemo_inframe = false;
+
+	Prof_EndTic();
+	timedemo_end = I_GetTime();
+
+	const size_t frame = timedemo_frames.size();
+	timedemo_frames.push_back(Prof_LastTic());
+
+	const std::vector<FProfileStat*> &stats = FProfileStat::getstats();
+	for (size_t i = 0; i < stats.size(); i++)
+	{
+		const dtime_t elapsed = Prof_LastTic(stats[i]);
+		if (elapsed == 0 && timedemo_scopes.find(stats[i]) == timedemo_scopes.end())
+			continue;
+
+		std::vector<dtime_t> &times = timedemo_scopes[stats[i]];
+		times.resize(frame, 0);
+		times.push_back(elapsed);
+	}
+}
+
+struct timedemosummary_t
+{
+	double mean, p50, p90, p99, max, total;		// in ms
+};
+
+static timedemosummary_t G_SummarizeTimes(std::vector<dtime_t> values)
+{
+	timedemosummary_t sum = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+	if (values.empty())
+		return sum;
+
+	dtime_t total = 0;
+	for (size_t i = 0; i < values.size(); i++)
+		total += values[i];
+
+	std::sort(values.begin(), values.end());
+
+	const size_t last = values.size() - 1;
+	sum.total = total / 1000000.0;
+	sum.mean = sum.total / values.size();
+	sum.p50 = values[last / 2] / 1000000.0;
+	sum.p90 = values[last * 90 / 100] / 1000000.0;
+	sum.p99 = values[last * 99 / 100] / 1000000.0;
+	sum.max = values[last] / 1000000.0;
+
+	return sum;
+}
+
+static std::string G_EscapeJSON(const std::string& str)
+{
+	std::string out;
+	for (size_t i = 0; i < str.length(); i++)
+	{
+		if (str[i] == '\\' || str[i] == '"')
+			out += '\\';
+		out += str[i];
+	}
+	return out;
+}
+
+static bool G_CompareScopePaths(const FProfileStat *a, const FProfileStat *b)
+{
+	return a->getpath() < b->getpath();
+}
+
+//
+// G_WriteTimeDemoJSON
+//
+static bool G_WriteTimeDemoJSON(const char *filename, const std::string& demoname,
+								const std::vector<const FProfileStat*> &scopes, double seconds)
+{
+	FILE *f = fopen(filename, "w");
+	if (!f)
+		return false;
+
+	const IWindowSurface* surface = I_GetPrimarySurface();
+	timedemosummary_t frames = G_SummarizeTimes(timedemo_frames);
+
+	fprintf(f, "{\n");
+	fprintf(f, "\t\"demo\": \"%s\",\n", G_EscapeJSON(demoname).c_str());
+	fprintf(f, "\t\"width\": %d,\n", surface ? surface->getWidth() : 0);
+	fprintf(f, "\t\"height\": %d,\n", surface ? surface->getHeight() : 0);
+	fprintf(f, "\t\"bpp\": %d,\n", surface ? surface->getBitsPerPixel() : 0);
+	fprintf(f, "\t\"r_optimize\": \"%s\",\n", r_optimize.cstring());
+	fprintf(f, "\t\"r_threads\": %d,\n", r_threads.asInt());
+	fprintf(f, "\t\"frames\": %u,\n", (unsigned int)timedemo_frames.size());
+	fprintf(f, "\t\"seconds\": %.3f,\n", seconds);
+	fprintf(f, "\t\"fps\": %.2f,\n", seconds > 0.0 ? timedemo_frames.size() / seconds : 0.0);
+	fprintf(f, "\t\"frame\": {\"mean_ms\": %.3f, \"p50_ms\": %.3f, \"p90_ms\": %.3f, "
+			"\"p99_ms\": %.3f, \"max_ms\": %.3f},\n",
+			frames.mean, frames.p50, frames.p90, frames.p99, frames.max);
+	fprintf(f, "\t\"scopes\": [");
+
+	for (size_t i = 0; i < scopes.size(); i++)
+	{
+		timedemosummary_t sum = G_SummarizeTimes(timedemo_scopes[scopes[i]]);
+
+		fprintf(f, "%s\n\t\t{\"name\": \"%s\", \"path\": \"%s\", \"depth\": %d, "
+				"\"total_ms\": %.3f, \"mean_ms\": %.3f, \"p50_ms\": %.3f, \"p90_ms\": %.3f, "
+				"\"p99_ms\": %.3f, \"max_ms\": %.3f}",
+				i ? "," : "", scopes[i]->getname(), scopes[i]->getpath().c_str(), scopes[i]->depth,
+				sum.total, sum.mean, sum.p50, sum.p90, sum.p99, sum.max);
+	}
+
+	fprintf(f, "\n\t]\n}\n");
+	fclose(f);
+
+	return true;
+}
+
+//
+// G_FinishTimeDemo
+//
+// Prints the report for the frames that were measured and exits the
+// application.
+//
+void G_FinishTimeDemo(const std::string& demoname)
+{
+	timingdemo = false;
+
+	const double seconds = (timedemo_end - timedemo_start) / 1000000000.0;
+
+	std::vector<const FProfileStat*> scopes;
+	for (std::map<const FProfileStat*, std::vector<dtime_t> >::iterator it = timedemo_scopes.begin();
+		 it != timedemo_scopes.end(); ++it)
+	{
+		it->second.resize(timedemo_frames.size(), 0);
+		scopes.push_back(it->first);
+	}
+
+	// a scope is listed right after the one it is inside of
+	std::sort(scopes.begin(), scopes.end(), G_CompareScopePaths);
+
+	Printf(PRINT_HIGH, "timedemo: %u frames in %.3f seconds (%.1f fps) with r_optimize %s, r_threads %d\n",
+			(unsigned int)timedemo_frames.size(), seconds,
+			seconds > 0.0 ? timedemo_frames.size() / seconds : 0.0,
+			r_optimize.cstring(), r_threads.asInt());
+
+	if (!timedemo_frames.empty())
+	{
+		timedemosummary_t frames = G_SummarizeTimes(timedemo_frames);
+
+		Printf(PRINT_HIGH, "%-32s %9s %9s %9s %9s %9s\n", "ms per frame", "mean", "p50", "p90", "p99", "max");
+		Printf(PRINT_HIGH, "%-32s %9.3f %9.3f %9.3f %9.3f %9.3f\n", "frame",
+				frames.mean, frames.p50, frames.p90, frames.p99, frames.max);
+
+		for (size_t i = 0; i < scopes.size(); i++)
+		{
+			timedemosummary_t sum = G_SummarizeTimes(timedemo_scopes[scopes[i]]);
+			std::string label = std::string(2 * (scopes[i]->depth + 1), ' ') + scopes[i]->getname();
+
+			Printf(PRINT_HIGH, "%-32s %9.3f %9.3f %9.3f %9.3f %9.3f\n", label.c_str(),
+					sum.mean, sum.p50, sum.p90, sum.p99, sum.max);
+		}
+	}
+
+	const char* filename = Args.CheckValue("-timedemojson");
+	if (filename)
+	{
+		if (G_WriteTimeDemoJSON(filename, demoname, scopes, seconds))
+			Printf(PRINT_HIGH, "Wrote the timedemo report to %s\n", filename);
+		else
+			Printf(PRINT_HIGH, "Could not write %s\n", filename);
+	}
+
+	// exit the application
+	CL_QuitCommand();
+}
+
+VERSION_CONTROL (g_timedemo_cpp, "$Id$")
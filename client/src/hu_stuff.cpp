@@ -49,6 +49,7 @@
 
 #include "hu_drawers.h"
 #include "hu_elements.h"
+#include "stats.h"
 
 #include "v_video.h"
 
@@ -473,6 +474,8 @@ static void HU_DrawChatPrompt()
 //
 void HU_Drawer()
 {
+	PROFILE_SCOPE(HU_Drawer);
+
 	if (noisedebug)
 		S_NoiseDebug();
 
@@ -40,46 +40,50 @@
 
 EXTERN_CVAR (r_particles)
 
-seg_t*			curline;
-side_t* 		sidedef;
-line_t* 		linedef;
-sector_t*		frontsector;
-sector_t*		backsector;
+THREAD_LOCAL seg_t*		curline;
+THREAD_LOCAL side_t*		sidedef;
+THREAD_LOCAL line_t*		linedef;
+THREAD_LOCAL sector_t*	frontsector;
+THREAD_LOCAL sector_t*	backsector;
 
 // killough 4/7/98: indicates doors closed wrt automap bugfix:
-bool			doorclosed;
+THREAD_LOCAL bool	doorclosed;
 
-bool			r_fakingunderwater;
+THREAD_LOCAL bool	r_fakingunderwater;
 bool			r_underwater;
 
 // Floor and ceiling heights at the end points of a seg_t
-fixed_t			rw_backcz1, rw_backcz2;
-fixed_t			rw_backfz1, rw_backfz2;
-fixed_t			rw_frontcz1, rw_frontcz2;
-fixed_t			rw_frontfz1, rw_frontfz2;
+THREAD_LOCAL fixed_t	rw_backcz1, rw_backcz2;
+THREAD_LOCAL fixed_t	rw_backfz1, rw_backfz2;
+THREAD_LOCAL fixed_t	rw_frontcz1, rw_frontcz2;
+THREAD_LOCAL fixed_t	rw_frontfz1, rw_frontfz2;
 
-int rw_start, rw_stop;
+THREAD_LOCAL int rw_start, rw_stop;
 
-static BYTE		FakeSide;
+static THREAD_LOCAL BYTE	FakeSide;
 
 const fixed_t NEARCLIP = 2*FRACUNIT;
 
-drawseg_t*		ds_p;
-drawseg_t*		drawsegs;
-unsigned		maxdrawsegs;
+THREAD_LOCAL drawseg_t*	ds_p;
+THREAD_LOCAL drawseg_t*	drawsegs;
+THREAD_LOCAL unsigned	maxdrawsegs;
 
 // CPhipps -
 // Instead of clipsegs, let's try using an array with one entry for each column,
 // indicating whether it's blocked by a solid wall yet or not.
 // e6y: resolution limitation is removed
-byte			solidcol[MAXWIDTH];
+THREAD_LOCAL byte		solidcol[MAXWIDTH];
 
 //
 // R_ClearClipSegs
 //
+// Columns outside of the slice of the view that this thread draws start out
+// solid so that nothing is clipped or drawn to them.
+//
 void R_ClearClipSegs (void)
 {
-	memset(solidcol, 0, viewwidth);
+	memset(solidcol, 1, viewwidth);
+	memset(solidcol + viewslicestart, 0, viewslicestop - viewslicestart + 1);
 }
 
 //
@@ -95,7 +99,8 @@ void R_ReallocDrawSegs(void)
 		drawsegs = (drawseg_t*)realloc(drawsegs, newmax*sizeof(*drawsegs));
 		ds_p = drawsegs + pos;				// jff 8/9/98 fix from ZDOOM1.14a
 		maxdrawsegs = newmax;
-		DPrintf("MaxDrawSegs increased to %d\n", maxdrawsegs);
+		if (!I_InParallel())
+			DPrintf("MaxDrawSegs increased to %d\n", maxdrawsegs);
 	}
 }
 
@@ -476,7 +481,7 @@ void R_AddLine (seg_t *line)
 	R_ClipLine(line->v1, line->v2, lclip, rclip, &w1, &w2);
 
 	// killough 3/8/98, 4/4/98: hack for invisible ceilings / deep water
-	static sector_t tempsec;
+	static THREAD_LOCAL sector_t tempsec;
 	backsector = line->backsector ? R_FakeFlat(line->backsector, &tempsec, NULL, NULL, true) : NULL;
 
 	R_PrepWall(w1.x, w1.y, w2.x, w2.y, t1.y, t2.y, x1, x2);
@@ -46,6 +46,7 @@
 
 #include "gi.h"
 #include "v_text.h"
+#include "c_dispatch.h"
 
 #undef RANGECHECK
 
@@ -62,9 +63,13 @@ extern	int		ST_Y;
 //	and the total size == width*height*depth/8.,
 //
 
+// the main thread's column and span state
+static drawcolumn_t maindcol;
+static drawspan_t maindspan;
+
 extern "C" {
-drawcolumn_t dcol;
-drawspan_t dspan;
+THREAD_LOCAL drawcolumn_t* r_dcol = &maindcol;
+THREAD_LOCAL drawspan_t* r_dspan = &maindspan;
 }
 
 byte*			viewimage;
@@ -92,6 +97,9 @@ void (*R_FillSpan)(void);
 void (*R_FillTranslucentSpan)(void);
 
 // Possibly vectorized functions:
+void (*R_DrawColumnD)(void);
+void (*R_DrawTranslucentColumnD)(void);
+void (*R_DrawTranslatedColumnD)(void);
 void (*R_DrawSpanD)(void);
 void (*R_DrawSlopeSpanD)(void);
 void (*r_dimpatchD)(IWindowSurface* surface, argb_t color, int alpha, int x1, int y1, int w, int h);
@@ -110,8 +118,6 @@ void (*r_dimpatchD)(IWindowSurface* surface, argb_t color, int alpha, int x1, in
 class FuzzTable
 {
 public:
-	FuzzTable() : pos(0) { }
-
 	forceinline void incrementRow()
 	{
 		pos = (pos + 1) % FuzzTable::size;
@@ -147,7 +153,8 @@ const int FuzzTable::table[FuzzTable::size] = {
 	   -1, 1, 1,-1, 1, 1,-1, 1 };
 
 
-static FuzzTable fuzztable;
+// one for each thread drawing the view, starting at the beginning of the table
+static THREAD_LOCAL FuzzTable fuzztable;
 
 
 // ============================================================================
@@ -1254,7 +1261,7 @@ void R_FillColumnD()
 // Renders a column to the 32bpp ARGB8888 screen buffer from the source buffer
 // dcol.source and scaled by dcol.iscale. Shading is performed using dcol.colormap.
 //
-void R_DrawColumnD()
+void R_DrawColumnD_c()
 {
 	R_DrawColumnGeneric<argb_t, DirectColormapFunc>(FB_COLDEST_D, dcol);
 }
@@ -1286,7 +1293,7 @@ void R_DrawFuzzColumnD()
 // translucency is controlled by dcol.translevel. Shading is performed using
 // dcol.colormap.
 //
-void R_DrawTranslucentColumnD()
+void R_DrawTranslucentColumnD_c()
 {
 	R_DrawColumnGeneric<argb_t, DirectTranslucentColormapFunc>(FB_COLDEST_D, dcol);
 }
@@ -1298,7 +1305,7 @@ void R_DrawTranslucentColumnD()
 // from the source buffer dcol.source and scaled by dcol.iscale. The translation
 // table is supplied by dcol.translation. Shading is performed using dcol.colormap.
 //
-void R_DrawTranslatedColumnD()
+void R_DrawTranslatedColumnD_c()
 {
 	R_DrawColumnGeneric<argb_t, DirectTranslatedColormapFunc>(FB_COLDEST_D, dcol);
 }
@@ -1451,7 +1458,8 @@ enum r_optimize_kind {
 	OPTIMIZE_NONE,
 	OPTIMIZE_SSE2,
 	OPTIMIZE_MMX,
-	OPTIMIZE_ALTIVEC
+	OPTIMIZE_ALTIVEC,
+	OPTIMIZE_AVX2
 };
 
 static r_optimize_kind optimize_kind = OPTIMIZE_NONE;
@@ -1464,6 +1472,7 @@ static const char *get_optimization_name(r_optimize_kind kind)
 		case OPTIMIZE_SSE2:    return "sse2";
 		case OPTIMIZE_MMX:     return "mmx";
 		case OPTIMIZE_ALTIVEC: return "altivec";
+		case OPTIMIZE_AVX2:    return "avx2";
 		case OPTIMIZE_NONE:
 		default:
 			return "none";
@@ -1516,6 +1525,10 @@ static bool detect_optimizations()
 	if (SDL_HasAltiVec())
 		optimizations_available.push_back(OPTIMIZE_ALTIVEC);
 	#endif
+	#ifdef __AVX2_DRAWERS__
+	if (R_HasAVX2())
+		optimizations_available.push_back(OPTIMIZE_AVX2);
+	#endif
 
 	return true;
 }
@@ -1550,6 +1563,8 @@ CVAR_FUNC_IMPL(r_optimize)
 		optimize_kind = OPTIMIZE_MMX;
 	else if (stricmp(val, "altivec") == 0 && R_IsOptimizationAvailable(OPTIMIZE_ALTIVEC))
 		optimize_kind = OPTIMIZE_ALTIVEC;
+	else if (stricmp(val, "avx2") == 0 && R_IsOptimizationAvailable(OPTIMIZE_AVX2))
+		optimize_kind = OPTIMIZE_AVX2;
 	else if (stricmp(val, "detect") == 0)
 		// Default to the most preferred:
 		optimize_kind = optimizations_available.back();
@@ -1587,6 +1602,11 @@ CVAR_FUNC_IMPL(r_optimize)
 //
 void R_InitVectorizedDrawers()
 {
+	// Only some of the backends have column drawers
+	R_DrawColumnD				= R_DrawColumnD_c;
+	R_DrawTranslucentColumnD	= R_DrawTranslucentColumnD_c;
+	R_DrawTranslatedColumnD		= R_DrawTranslatedColumnD_c;
+
 	if (optimize_kind == OPTIMIZE_NONE)
 	{
 		// [SL] set defaults to non-vectorized drawers
@@ -1618,8 +1638,26 @@ void R_InitVectorizedDrawers()
 		r_dimpatchD             = r_dimpatchD_ALTIVEC;
 	}
 	#endif
+	#ifdef __AVX2_DRAWERS__
+	else if (optimize_kind == OPTIMIZE_AVX2)
+	{
+		R_DrawColumnD				= R_DrawColumnD_AVX2;
+		R_DrawTranslucentColumnD	= R_DrawTranslucentColumnD_AVX2;
+		R_DrawTranslatedColumnD		= R_DrawTranslatedColumnD_AVX2;
+		R_DrawSpanD				= R_DrawSpanD_AVX2;
+		R_DrawSlopeSpanD		= R_DrawSlopeSpanD_AVX2;
+		#ifdef __SSE2__
+		r_dimpatchD             = r_dimpatchD_SSE2;
+		#else
+		r_dimpatchD             = r_dimpatchD_c;
+		#endif
+	}
+	#endif
 
 	// Check that all pointers are definitely assigned!
+	assert(R_DrawColumnD != NULL);
+	assert(R_DrawTranslucentColumnD != NULL);
+	assert(R_DrawTranslatedColumnD != NULL);
 	assert(R_DrawSpanD != NULL);
 	assert(R_DrawSlopeSpanD != NULL);
 	assert(r_dimpatchD != NULL);
@@ -1658,5 +1696,160 @@ void R_InitColumnDrawers ()
 	}
 }
 
+
+//
+// R_TimeDrawer
+//
+// Returns the average number of nanoseconds the drawer takes per pixel when
+// it fills the whole of the benchmark buffer, one column or span at a time.
+//
+static double R_TimeDrawer(void (*drawer)(void), bool span, int width, int height, int passes)
+{
+	const dtime_t start = I_GetTime();
+
+	for (int pass = 0; pass < passes; pass++)
+	{
+		if (span)
+		{
+			for (int y = 0; y < height; y++)
+			{
+				dspan.y = y;
+				drawer();
+			}
+		}
+		else
+		{
+			for (int x = 0; x < width; x++)
+			{
+				dcol.x = x;
+				drawer();
+			}
+		}
+	}
+
+	return double(I_GetTime() - start) / (double(width) * height * passes);
+}
+
+//
+// r_benchdrawers
+//
+// Times each of the 32-bit column and span drawers of every optimization the
+// processor supports against the generic versions.  The drawers write into
+// a buffer the size of the view, so nothing is drawn to the screen.
+//
+BEGIN_COMMAND(r_benchdrawers)
+{
+	const int width = viewwidth, height = viewheight;
+	if (width <= 0 || height <= 0 || translationtables == NULL)
+	{
+		Printf(PRINT_HIGH, "r_benchdrawers: the renderer has not been initialized\n");
+		return;
+	}
+
+	const int passes = argc > 1 ? MAX(atoi(argv[1]), 1) : 20;
+
+	detect_optimizations();
+
+	std::vector<argb_t> buffer(width * height);
+	palindex_t column[128];
+	palindex_t flat[64 * 64];
+
+	for (size_t i = 0; i < sizeof(column); i++)
+		column[i] = (palindex_t)(i * 7);
+	for (size_t i = 0; i < sizeof(flat); i++)
+		flat[i] = (palindex_t)(i * 13 + (i >> 6));
+
+	const shaderef_t colormap(&V_GetDefaultPalette()->maps, 0);
+
+	drawcolumn_t* const olddcol = r_dcol;
+	drawspan_t* const olddspan = r_dspan;
+
+	drawcolumn_t benchdcol;
+	drawspan_t* benchdspan = new drawspan_t;
+
+	r_dcol = &benchdcol;
+	r_dspan = benchdspan;
+
+	dcol.source = column;
+	dcol.destination = (byte*)&buffer[0];
+	dcol.pitch_in_pixels = width;
+	dcol.post = NULL;
+	dcol.colormap = colormap;
+	dcol.yl = 0;
+	dcol.yh = height - 1;
+	dcol.iscale = FRACUNIT * 3 / 4;
+	dcol.texturemid = 0;
+	dcol.texturefrac = 0;
+	dcol.textureheight = 128 << FRACBITS;
+	dcol.translevel = FRACUNIT / 2;
+	dcol.translation = translationref_t(translationtables);
+
+	dspan.source = flat;
+	dspan.destination = (byte*)&buffer[0];
+	dspan.pitch_in_pixels = width;
+	dspan.colormap = colormap;
+	dspan.x1 = 0;
+	dspan.x2 = width - 1;
+	dspan.xfrac = dspan.yfrac = 0;
+	dspan.xstep = 0x01234567;
+	dspan.ystep = 0x00765432;
+	dspan.iu = dspan.iv = 0.0f;
+	dspan.iustep = 0.25f;
+	dspan.ivstep = 0.125f;
+	dspan.id = 1.0f;
+	dspan.idstep = 0.001f;
+	for (int x = 0; x < width; x++)
+		dspan.slopelighting[x] = colormap;
+
+	struct
+	{
+		const char*		name;
+		void			(**drawer)(void);
+		bool			span;
+		double			basetime;
+	} drawers[] = {
+		{ "column",			&R_DrawColumnD,				false,	0.0 },
+		{ "translucent",	&R_DrawTranslucentColumnD,	false,	0.0 },
+		{ "translated",		&R_DrawTranslatedColumnD,	false,	0.0 },
+		{ "span",			&R_DrawSpanD,				true,	0.0 },
+		{ "slopespan",		&R_DrawSlopeSpanD,			true,	0.0 }
+	};
+
+	Printf(PRINT_HIGH, "r_benchdrawers: %dx%d, %d passes, ns per pixel\n", width, height, passes);
+
+	const r_optimize_kind oldkind = optimize_kind;
+
+	for (size_t i = 0; i < optimizations_available.size(); i++)
+	{
+		optimize_kind = optimizations_available[i];
+		R_InitVectorizedDrawers();
+
+		Printf(PRINT_HIGH, "%-8s", get_optimization_name(optimize_kind));
+
+		for (size_t j = 0; j < sizeof(drawers) / sizeof(drawers[0]); j++)
+		{
+			const double time = R_TimeDrawer(*drawers[j].drawer, drawers[j].span, width, height, passes);
+
+			// the generic drawers are always timed first
+			if (i == 0)
+				drawers[j].basetime = time;
+
+			Printf(PRINT_HIGH, "  %s %.2f (%.2fx)", drawers[j].name, time,
+					time > 0.0 ? drawers[j].basetime / time : 0.0);
+		}
+
+		Printf(PRINT_HIGH, "\n");
+	}
+
+	optimize_kind = oldkind;
+	R_InitVectorizedDrawers();
+	R_InitColumnDrawers();
+
+	r_dcol = olddcol;
+	r_dspan = olddspan;
+	delete benchdspan;
+}
+END_COMMAND(r_benchdrawers)
+
 VERSION_CONTROL (r_draw_cpp, "$Id$")
 
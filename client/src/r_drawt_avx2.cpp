@@ -0,0 +1,588 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	AVX2 versions of the 32-bit column and span drawers
+//
+//	Each function is built for AVX2 with R_AVX2_TARGET, so these are only
+//	used when R_HasAVX2 says the processor can run them.  Eight pixels are
+//	done at a time: the texture coordinates are stepped in one register and
+//	the shading is a gather from the shademap.  Cases the vector code does
+//	not cover (textures with heights that are not a power of 2, player color
+//	translations) are passed on to the generic drawers.
+//
+//-----------------------------------------------------------------------------
+
+#include "r_intrin.h"
+
+#ifdef __AVX2_DRAWERS__
+
+#include <assert.h>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define AVX2_ALIGNED(x) _CRT_ALIGN(32) x
+#else
+#define AVX2_ALIGNED(x) x __attribute__((aligned(32)))
+#endif
+
+#include "doomtype.h"
+#include "doomdef.h"
+#include "i_system.h"
+#include "r_defs.h"
+#include "r_draw.h"
+#include "r_main.h"
+#include "i_video.h"
+
+//
+// R_HasAVX2
+//
+// Returns true if the processor supports AVX2 and the operating system saves
+// the YMM registers.
+//
+bool R_HasAVX2()
+{
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	__cpuid(info, 1);
+	const int osxsave = 1 << 27;
+	if (!(info[2] & osxsave) || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+//
+// R_GetBytesUntilAligned
+//
+static inline uintptr_t R_GetBytesUntilAligned(void* data, uintptr_t alignment)
+{
+	uintptr_t mask = alignment - 1;
+	return (alignment - ((uintptr_t)data & mask)) & mask;
+}
+
+//
+// R_FetchTexels
+//
+// Reads the texels at the eight offsets in spots.  The texels are read one
+// at a time, as a gather of 32-bit values could read past the end of the
+// texture.
+//
+R_AVX2_TARGET static forceinline __m256i R_FetchTexels(const palindex_t* source, __m256i spots)
+{
+	AVX2_ALIGNED(int offsets[8]);
+	_mm256_store_si256((__m256i*)offsets, spots);
+
+	return _mm256_setr_epi32(
+			source[offsets[0]], source[offsets[1]], source[offsets[2]], source[offsets[3]],
+			source[offsets[4]], source[offsets[5]], source[offsets[6]], source[offsets[7]]);
+}
+
+//
+// R_ShadeTexels
+//
+R_AVX2_TARGET static forceinline __m256i R_ShadeTexels(const argb_t* shademap, __m256i texels)
+{
+	return _mm256_i32gather_epi32((const int*)shademap, texels, 4);
+}
+
+//
+// R_StoreColumnPixels
+//
+// Writes eight pixels down a column of the screen.
+//
+R_AVX2_TARGET static forceinline void R_StoreColumnPixels(argb_t* dest, int pitch, __m256i colors)
+{
+	AVX2_ALIGNED(argb_t pixels[8]);
+	_mm256_store_si256((__m256i*)pixels, colors);
+
+	for (int i = 0; i < 8; i++, dest += pitch)
+		*dest = pixels[i];
+}
+
+//
+// R_BlendPixels
+//
+// The vector version of alphablend2a(bg, bga, fg, fga). Each color channel
+// is widened to 16 bits for the multiplies and the alpha channel is set.
+//
+R_AVX2_TARGET static forceinline __m256i R_BlendPixels(__m256i bg, __m256i fg,
+		__m256i bga, __m256i fga, __m256i alphamask)
+{
+	const __m256i zero = _mm256_setzero_si256();
+
+	__m256i lo = _mm256_add_epi16(
+			_mm256_mullo_epi16(_mm256_unpacklo_epi8(bg, zero), bga),
+			_mm256_mullo_epi16(_mm256_unpacklo_epi8(fg, zero), fga));
+	__m256i hi = _mm256_add_epi16(
+			_mm256_mullo_epi16(_mm256_unpackhi_epi8(bg, zero), bga),
+			_mm256_mullo_epi16(_mm256_unpackhi_epi8(fg, zero), fga));
+
+	lo = _mm256_srli_epi16(lo, 8);
+	hi = _mm256_srli_epi16(hi, 8);
+
+	return _mm256_or_si256(_mm256_packus_epi16(lo, hi), alphamask);
+}
+
+
+// ----------------------------------------------------------------------------
+//
+// Column drawers
+//
+// ----------------------------------------------------------------------------
+
+#define FB_COLDEST_D ((argb_t*)dcol.destination + dcol.yl * dcol.pitch_in_pixels + dcol.x)
+
+//
+// R_ColumnFracs
+//
+// Returns the texture fractions of the first eight pixels of a column.
+//
+R_AVX2_TARGET static forceinline __m256i R_ColumnFracs(fixed_t frac, fixed_t fracstep)
+{
+	return _mm256_add_epi32(_mm256_set1_epi32(frac),
+			_mm256_mullo_epi32(_mm256_set1_epi32(fracstep), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+}
+
+//
+// R_DrawColumnD_AVX2
+//
+R_AVX2_TARGET void R_DrawColumnD_AVX2()
+{
+	const int texheight = dcol.textureheight;
+	if (texheight & (texheight - 1))
+	{
+		R_DrawColumnD_c();
+		return;
+	}
+
+#ifdef RANGECHECK
+	if (dcol.x < 0 || dcol.x >= viewwidth || dcol.yl < 0 || dcol.yh >= viewheight)
+	{
+		Printf (PRINT_HIGH, "R_DrawColumn: %i to %i at %i\n", dcol.yl, dcol.yh, dcol.x);
+		return;
+	}
+#endif
+
+	int count = dcol.yh - dcol.yl + 1;
+	if (count <= 0)
+		return;
+
+	const palindex_t* source = dcol.source;
+	const int pitch = dcol.pitch_in_pixels;
+	argb_t* dest = FB_COLDEST_D;
+
+	const fixed_t fracstep = dcol.iscale;
+	fixed_t frac = dcol.texturefrac;
+	const int mask = (texheight >> FRACBITS) - 1;
+
+	const argb_t* shademap = dcol.colormap.m_shademap;
+
+	const __m256i mmask = _mm256_set1_epi32(mask);
+	const __m256i mfracinc = _mm256_set1_epi32(fracstep * 8);
+	__m256i mfrac = R_ColumnFracs(frac, fracstep);
+
+	for (; count >= 8; count -= 8)
+	{
+		const __m256i spots = _mm256_and_si256(_mm256_srai_epi32(mfrac, FRACBITS), mmask);
+		const __m256i colors = R_ShadeTexels(shademap, R_FetchTexels(source, spots));
+
+		R_StoreColumnPixels(dest, pitch, colors);
+
+		dest += pitch * 8;
+		mfrac = _mm256_add_epi32(mfrac, mfracinc);
+	}
+
+	frac = _mm256_cvtsi256_si32(mfrac);
+
+	while (count--)
+	{
+		*dest = shademap[source[(frac >> FRACBITS) & mask]];
+		dest += pitch;
+		frac += fracstep;
+	}
+}
+
+//
+// R_DrawTranslucentColumnD_AVX2
+//
+R_AVX2_TARGET void R_DrawTranslucentColumnD_AVX2()
+{
+	const int texheight = dcol.textureheight;
+	const int fga = (dcol.translevel & ~0x03FF) >> 8;
+	const int bga = 255 - fga;
+
+	// the channels would not fit in 16 bits at full opacity
+	if ((texheight & (texheight - 1)) || fga > 255)
+	{
+		R_DrawTranslucentColumnD_c();
+		return;
+	}
+
+#ifdef RANGECHECK
+	if (dcol.x < 0 || dcol.x >= viewwidth || dcol.yl < 0 || dcol.yh >= viewheight)
+	{
+		Printf (PRINT_HIGH, "R_DrawColumn: %i to %i at %i\n", dcol.yl, dcol.yh, dcol.x);
+		return;
+	}
+#endif
+
+	int count = dcol.yh - dcol.yl + 1;
+	if (count <= 0)
+		return;
+
+	const palindex_t* source = dcol.source;
+	const int pitch = dcol.pitch_in_pixels;
+	argb_t* dest = FB_COLDEST_D;
+
+	const fixed_t fracstep = dcol.iscale;
+	fixed_t frac = dcol.texturefrac;
+	const int mask = (texheight >> FRACBITS) - 1;
+
+	const argb_t* shademap = dcol.colormap.m_shademap;
+
+	const __m256i mmask = _mm256_set1_epi32(mask);
+	const __m256i mfracinc = _mm256_set1_epi32(fracstep * 8);
+	__m256i mfrac = R_ColumnFracs(frac, fracstep);
+
+	const __m256i mrows = _mm256_mullo_epi32(_mm256_set1_epi32(pitch), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	const __m256i mfga = _mm256_set1_epi16(fga);
+	const __m256i mbga = _mm256_set1_epi16(bga);
+	const __m256i malpha = _mm256_set1_epi32(argb_t(255, 0, 0, 0));
+
+	for (; count >= 8; count -= 8)
+	{
+		const __m256i spots = _mm256_and_si256(_mm256_srai_epi32(mfrac, FRACBITS), mmask);
+		const __m256i fg = R_ShadeTexels(shademap, R_FetchTexels(source, spots));
+		const __m256i bg = _mm256_i32gather_epi32((const int*)dest, mrows, 4);
+
+		R_StoreColumnPixels(dest, pitch, R_BlendPixels(bg, fg, mbga, mfga, malpha));
+
+		dest += pitch * 8;
+		mfrac = _mm256_add_epi32(mfrac, mfracinc);
+	}
+
+	frac = _mm256_cvtsi256_si32(mfrac);
+
+	while (count--)
+	{
+		*dest = alphablend2a(*dest, bga, shademap[source[(frac >> FRACBITS) & mask]], fga);
+		dest += pitch;
+		frac += fracstep;
+	}
+}
+
+//
+// R_DrawTranslatedColumnD_AVX2
+//
+R_AVX2_TARGET void R_DrawTranslatedColumnD_AVX2()
+{
+	const int texheight = dcol.textureheight;
+
+	// player colors are shaded with their own color rather than the shademap
+	if ((texheight & (texheight - 1)) ||
+		(dcol.translation.getPlayerID() != -1 && dcol.colormap.mapnum() < NUMCOLORMAPS))
+	{
+		R_DrawTranslatedColumnD_c();
+		return;
+	}
+
+#ifdef RANGECHECK
+	if (dcol.x < 0 || dcol.x >= viewwidth || dcol.yl < 0 || dcol.yh >= viewheight)
+	{
+		Printf (PRINT_HIGH, "R_DrawColumn: %i to %i at %i\n", dcol.yl, dcol.yh, dcol.x);
+		return;
+	}
+#endif
+
+	int count = dcol.yh - dcol.yl + 1;
+	if (count <= 0)
+		return;
+
+	const palindex_t* source = dcol.source;
+	const int pitch = dcol.pitch_in_pixels;
+	argb_t* dest = FB_COLDEST_D;
+
+	const fixed_t fracstep = dcol.iscale;
+	fixed_t frac = dcol.texturefrac;
+	const int mask = (texheight >> FRACBITS) - 1;
+
+	const argb_t* shademap = dcol.colormap.m_shademap;
+	const palindex_t* translation = dcol.translation.getTable();
+
+	const __m256i mmask = _mm256_set1_epi32(mask);
+	const __m256i mfracinc = _mm256_set1_epi32(fracstep * 8);
+	__m256i mfrac = R_ColumnFracs(frac, fracstep);
+
+	for (; count >= 8; count -= 8)
+	{
+		const __m256i spots = _mm256_and_si256(_mm256_srai_epi32(mfrac, FRACBITS), mmask);
+		const __m256i texels = R_FetchTexels(source, spots);
+		const __m256i colors = R_ShadeTexels(shademap, R_FetchTexels(translation, texels));
+
+		R_StoreColumnPixels(dest, pitch, colors);
+
+		dest += pitch * 8;
+		mfrac = _mm256_add_epi32(mfrac, mfracinc);
+	}
+
+	frac = _mm256_cvtsi256_si32(mfrac);
+
+	while (count--)
+	{
+		*dest = shademap[translation[source[(frac >> FRACBITS) & mask]]];
+		dest += pitch;
+		frac += fracstep;
+	}
+}
+
+
+// ----------------------------------------------------------------------------
+//
+// Span drawers
+//
+// ----------------------------------------------------------------------------
+
+//
+// R_DrawSpanD_AVX2
+//
+R_AVX2_TARGET void R_DrawSpanD_AVX2()
+{
+#ifdef RANGECHECK
+	if (dspan.x2 < dspan.x1 || dspan.x1 < 0 || dspan.x2 >= viewwidth ||
+		dspan.y >= viewheight || dspan.y < 0)
+	{
+		Printf(PRINT_HIGH, "R_DrawLevelSpan: %i to %i at %i", dspan.x1, dspan.x2, dspan.y);
+		return;
+	}
+#endif
+
+	const int width = dspan.x2 - dspan.x1 + 1;
+
+	// flats are stored row-major, so u runs along y
+	dsfixed_t ufrac = dspan.yfrac;
+	dsfixed_t vfrac = dspan.xfrac;
+	dsfixed_t ustep = dspan.ystep;
+	dsfixed_t vstep = dspan.xstep;
+
+	const byte* source = dspan.source;
+	argb_t* dest = (argb_t*)dspan.destination + dspan.y * dspan.pitch_in_pixels + dspan.x1;
+
+	const argb_t* shademap = dspan.colormap.m_shademap;
+
+	const int texture_width_bits = 6, texture_height_bits = 6;
+
+	const unsigned int umask = ((1 << texture_width_bits) - 1) << texture_height_bits;
+	const unsigned int vmask = (1 << texture_height_bits) - 1;
+	// the fractions carry 10 extra bits from R_MapLevelPlane
+	const int ushift = FRACBITS - texture_height_bits + 10;
+	const int vshift = FRACBITS + 10;
+
+	int align = R_GetBytesUntilAligned(dest, 32) / sizeof(argb_t);
+	if (align > width)
+		align = width;
+
+	int batches = (width - align) / 8;
+	int remainder = (width - align) & 7;
+
+	// Blit until we align ourselves with a 32-byte offset for AVX2:
+	while (align--)
+	{
+		const unsigned int spot = ((ufrac >> ushift) & umask) | ((vfrac >> vshift) & vmask);
+		*dest++ = shademap[source[spot]];
+
+		ufrac += ustep;
+		vfrac += vstep;
+	}
+
+	const __m256i steps = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i mumask = _mm256_set1_epi32(umask);
+	const __m256i mvmask = _mm256_set1_epi32(vmask);
+
+	__m256i mufrac = _mm256_add_epi32(_mm256_set1_epi32(ufrac), _mm256_mullo_epi32(_mm256_set1_epi32(ustep), steps));
+	const __m256i mufracinc = _mm256_set1_epi32(ustep * 8);
+	__m256i mvfrac = _mm256_add_epi32(_mm256_set1_epi32(vfrac), _mm256_mullo_epi32(_mm256_set1_epi32(vstep), steps));
+	const __m256i mvfracinc = _mm256_set1_epi32(vstep * 8);
+
+	while (batches--)
+	{
+		const __m256i u = _mm256_and_si256(_mm256_srli_epi32(mufrac, ushift), mumask);
+		const __m256i v = _mm256_and_si256(_mm256_srli_epi32(mvfrac, vshift), mvmask);
+		const __m256i colors = R_ShadeTexels(shademap, R_FetchTexels(source, _mm256_or_si256(u, v)));
+
+		_mm256_store_si256((__m256i*)dest, colors);
+		dest += 8;
+
+		mufrac = _mm256_add_epi32(mufrac, mufracinc);
+		mvfrac = _mm256_add_epi32(mvfrac, mvfracinc);
+	}
+
+	ufrac = (dsfixed_t)_mm256_cvtsi256_si32(mufrac);
+	vfrac = (dsfixed_t)_mm256_cvtsi256_si32(mvfrac);
+
+	// blit the remaining 0 - 7 pixels
+	while (remainder--)
+	{
+		const unsigned int spot = ((ufrac >> ushift) & umask) | ((vfrac >> vshift) & vmask);
+		*dest++ = shademap[source[spot]];
+
+		ufrac += ustep;
+		vfrac += vstep;
+	}
+}
+
+//
+// R_DrawSlopeSpanD_AVX2
+//
+// Each pixel of a sloped span has its own light level, so only the texture
+// coordinates and the writes are done eight at a time.
+//
+R_AVX2_TARGET void R_DrawSlopeSpanD_AVX2()
+{
+	int count = dspan.x2 - dspan.x1 + 1;
+	if (count <= 0)
+		return;
+
+#ifdef RANGECHECK
+	if (dspan.x2 < dspan.x1
+		|| dspan.x1 < 0
+		|| dspan.x2 >= I_GetSurfaceWidth()
+		|| dspan.y >= I_GetSurfaceHeight())
+	{
+		I_Error ("R_DrawSlopeSpan: %i to %i at %i",
+				 dspan.x1, dspan.x2, dspan.y);
+	}
+#endif
+
+	float iu = dspan.iu, iv = dspan.iv;
+	float ius = dspan.iustep, ivs = dspan.ivstep;
+	float id = dspan.id, ids = dspan.idstep;
+
+	// framebuffer
+	argb_t* dest = (argb_t*)dspan.destination + dspan.y * dspan.pitch_in_pixels + dspan.x1;
+
+	// texture data
+	byte *src = (byte *)dspan.source;
+
+	const shaderef_t* lighting = dspan.slopelighting;
+
+	const __m256i steps = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i mumask = _mm256_set1_epi32(63);
+	const __m256i mvmask = _mm256_set1_epi32(0xFC0);
+
+	while (count > 0)
+	{
+		// Blit in batches of SPANJUMP columns, interpolating the texture
+		// coordinates linearly in between
+		const int incount = MIN(count, SPANJUMP);
+
+		const float mulstart = 65536.0f / id;
+		id += ids * incount;
+		const float mulend = 65536.0f / id;
+
+		const float ustart = iu * mulstart;
+		const float vstart = iv * mulstart;
+
+		fixed_t ufrac = (fixed_t)ustart;
+		fixed_t vfrac = (fixed_t)vstart;
+
+		iu += ius * incount;
+		iv += ivs * incount;
+
+		const float uend = iu * mulend;
+		const float vend = iv * mulend;
+
+		fixed_t ustep, vstep;
+		if (incount == SPANJUMP)
+		{
+			ustep = (fixed_t)((uend - ustart) * INTERPSTEP);
+			vstep = (fixed_t)((vend - vstart) * INTERPSTEP);
+		}
+		else
+		{
+			ustep = (fixed_t)((uend - ustart) / incount);
+			vstep = (fixed_t)((vend - vstart) / incount);
+		}
+
+		int i = 0;
+
+		// Blit up to the first 32-byte aligned position:
+		for (; i < incount && (((size_t)dest) & 31); i++)
+		{
+			*dest++ = lighting->shade(src[((vfrac >> 10) & 0xFC0) | ((ufrac >> 16) & 63)]);
+			lighting++;
+			ufrac += ustep;
+			vfrac += vstep;
+		}
+
+		if (incount - i >= 8)
+		{
+			__m256i mufrac = _mm256_add_epi32(_mm256_set1_epi32(ufrac), _mm256_mullo_epi32(_mm256_set1_epi32(ustep), steps));
+			const __m256i mufracinc = _mm256_set1_epi32(ustep * 8);
+			__m256i mvfrac = _mm256_add_epi32(_mm256_set1_epi32(vfrac), _mm256_mullo_epi32(_mm256_set1_epi32(vstep), steps));
+			const __m256i mvfracinc = _mm256_set1_epi32(vstep * 8);
+
+			for (; incount - i >= 8; i += 8)
+			{
+				const __m256i u = _mm256_and_si256(_mm256_srai_epi32(mufrac, 16), mumask);
+				const __m256i v = _mm256_and_si256(_mm256_srai_epi32(mvfrac, 10), mvmask);
+
+				AVX2_ALIGNED(int spots[8]);
+				_mm256_store_si256((__m256i*)spots, _mm256_or_si256(u, v));
+
+				const __m256i colors = _mm256_setr_epi32(
+						lighting[0].shade(src[spots[0]]), lighting[1].shade(src[spots[1]]),
+						lighting[2].shade(src[spots[2]]), lighting[3].shade(src[spots[3]]),
+						lighting[4].shade(src[spots[4]]), lighting[5].shade(src[spots[5]]),
+						lighting[6].shade(src[spots[6]]), lighting[7].shade(src[spots[7]]));
+
+				_mm256_store_si256((__m256i*)dest, colors);
+
+				dest += 8;
+				lighting += 8;
+				mufrac = _mm256_add_epi32(mufrac, mufracinc);
+				mvfrac = _mm256_add_epi32(mvfrac, mvfracinc);
+			}
+
+			ufrac = _mm256_cvtsi256_si32(mufrac);
+			vfrac = _mm256_cvtsi256_si32(mvfrac);
+		}
+
+		for (; i < incount; i++)
+		{
+			*dest++ = lighting->shade(src[((vfrac >> 10) & 0xFC0) | ((ufrac >> 16) & 63)]);
+			lighting++;
+			ufrac += ustep;
+			vfrac += vstep;
+		}
+
+		count -= incount;
+	}
+}
+
+VERSION_CONTROL (r_drawt_avx2_cpp, "$Id$")
+
+#endif
@@ -56,13 +56,13 @@ int viewheightarray[MAXWIDTH];
 
 void R_SpanInitData ();
 
-extern int *walllights;
+extern THREAD_LOCAL int *walllights;
 
 // [RH] Defined in d_main.cpp
 extern dyncolormap_t NormalLight;
-extern bool r_fakingunderwater;
 
 EXTERN_CVAR (r_flashhom)
+EXTERN_CVAR (r_threads)
 EXTERN_CVAR (r_viewsize)
 EXTERN_CVAR (sv_allowwidescreen)
 EXTERN_CVAR (vid_320x200)
@@ -81,7 +81,11 @@ int 			viewangleoffset = 0;
 int 			validcount = 1;
 
 // [RH] colormap currently drawing with
-shaderef_t		basecolormap;
+static shaderef_t	mainbasecolormap;
+
+// R_RenderViewSliceJob points this at a copy of basecolormap for each slice
+// drawn in parallel.  Everything else draws with the one above.
+THREAD_LOCAL shaderef_t* r_basecolormap = &mainbasecolormap;
 int				fixedlightlev;
 shaderef_t		fixedcolormap;
 
@@ -126,7 +130,10 @@ int				lightscaleymul;
 int 			extralight;
 
 // [RH] ignore extralight and fullbright
-BOOL			foggy;
+THREAD_LOCAL BOOL	foggy;
+
+THREAD_LOCAL int	viewslicestart;
+THREAD_LOCAL int	viewslicestop;
 
 static bool		setsizeneeded = true;
 int				setblocks;
@@ -139,9 +146,9 @@ static argb_t sector_blend_color(0, 255, 255, 255);
 // [SL] Current color blending values (including palette effects)
 fargb_t blend_color(0.0f, 255.0f, 255.0f, 255.0f);
 
-void (*colfunc) (void);
-void (*spanfunc) (void);
-void (*spanslopefunc) (void);
+THREAD_LOCAL void (*colfunc) (void);
+THREAD_LOCAL void (*spanfunc) (void);
+THREAD_LOCAL void (*spanslopefunc) (void);
 
 // [AM] Number of fineangles in a default 90 degree FOV at a 4:3 resolution.
 int FieldOfView = 2048;
@@ -618,6 +625,19 @@ CVAR_FUNC_IMPL(screenblocks)
 }
 
 
+//
+// CVAR r_threads
+//
+// Sets the number of threads that draw the view, each in its own vertical
+// slice of the screen.  The main thread draws a slice too.
+//
+CVAR_FUNC_IMPL(r_threads)
+{
+	size_t threads = var > 0 ? (size_t)var : I_GetProcessorCount();
+	I_SetWorkerThreads(threads - 1);
+}
+
+
 //
 // R_Init
 //
@@ -872,9 +892,6 @@ void R_SetupFrame (player_t *player)
 	fixed_t pitch = camera->prevpitch + FixedMul(render_lerp_amount, camera->pitch - camera->prevpitch);
 	R_ViewShear(pitch); 
 
-	// [RH] Hack to make windows into underwater areas possible
-	r_fakingunderwater = false;
-
 	framecount++;
 	validcount++;
 }
@@ -992,11 +1009,100 @@ void R_SetTranslatedLucentDrawFuncs()
 }
 
 
+//
+// R_RenderViewSlice
+//
+// Draws the columns from start to stop of the view. The columns outside of
+// them start out solid, so the BSP walk only clips, stores and draws the
+// walls, planes and sprites that can be seen through the slice.
+//
+static void R_RenderViewSlice(int start, int stop)
+{
+	viewslicestart = start;
+	viewslicestop = stop;
+
+	// [RH] Hack to make windows into underwater areas possible
+	r_fakingunderwater = false;
+
+	// Clear buffers.
+	R_ClearClipSegs();
+	R_ClearDrawSegs();
+	R_ClearOpenings();
+	R_ClearPlanes();
+	R_ClearSprites();
+
+	R_ResetDrawFuncs();
+
+	{
+		PROFILE_SCOPE(R_RenderBSPNode);
+		R_RenderBSPNode(numnodes - 1);	// The head node is the last node output.
+	}
+
+	R_DrawPlanes();
+
+	R_DrawMasked();
+}
+
+// The main thread's drawing state that every slice of the view starts from
+struct viewslices_t
+{
+	const drawcolumn_t	*basedcol;
+	const drawspan_t	*basedspan;
+	int					*walllights;
+	size_t				count;
+};
+
+//
+// R_RenderViewSliceJob
+//
+// Draws one of the slices of the view with its own copy of the column and
+// span state. The slices are aligned to 16 columns so that no two threads
+// write to the same cache line.
+//
+static void R_RenderViewSliceJob(void *data, size_t index)
+{
+	const viewslices_t *slices = (const viewslices_t *)data;
+
+	drawcolumn_t *olddcol = r_dcol;
+	drawspan_t *olddspan = r_dspan;
+	shaderef_t *oldbasecolormap = r_basecolormap;
+
+	drawcolumn_t slicedcol = *slices->basedcol;
+	drawspan_t slicedspan = *slices->basedspan;
+	shaderef_t slicebasecolormap = basecolormap;
+
+	r_dcol = &slicedcol;
+	r_dspan = &slicedspan;
+	r_basecolormap = &slicebasecolormap;
+	walllights = slices->walllights;
+
+	int start = (viewwidth * index / slices->count) & ~15;
+	int stop = index + 1 == slices->count ? viewwidth - 1 :
+			((viewwidth * (index + 1) / slices->count) & ~15) - 1;
+
+	R_RenderViewSlice(start, stop);
+
+	r_dcol = olddcol;
+	r_dspan = olddspan;
+	r_basecolormap = oldbasecolormap;
+}
+
+// Z_Malloc doesn't purge cached blocks while the view is drawn in parallel,
+// and takes blocks from the system heap when the zone is full.  If that
+// happens during a frame, the view is drawn on one thread until the next
+// level, so that the cache can make room the usual way.
+static bool r_zonefull = false;
+
 //
 // R_RenderPlayerView
 //
+// With r_threads set, the view is split into one vertical slice for each
+// thread and each slice is drawn on its own.
+//
 void R_RenderPlayerView(player_t* player)
 {
+	PROFILE_SCOPE(R_RenderPlayerView);
+
 	// Recalculate the viewing window dimensions, if needed.
 	if (setsizeneeded)
 	{
@@ -1010,15 +1116,6 @@ void R_RenderPlayerView(player_t* player)
 
 	R_SetupFrame(player);
 
-	// Clear buffers.
-	R_ClearClipSegs();
-	R_ClearDrawSegs();
-	R_ClearOpenings();
-	R_ClearPlanes();
-	R_ClearSprites();
-
-	R_ResetDrawFuncs();
-
 	IWindowSurface* surface = R_GetRenderingSurface();
 
 	// [SL] fill the screen with a blinking solid color to make HOM more visible
@@ -1036,21 +1133,47 @@ void R_RenderPlayerView(player_t* player)
 	// [RH] Setup particles for this frame
 	R_FindParticleSubsectors();
 
-    // [Russell] - From zdoom 1.22 source, added camera pointer check
+	// [Russell] - From zdoom 1.22 source, added camera pointer check
 	// Never draw the player unless in chasecam mode
+	int flags2_backup = camera ? camera->flags2 : 0;
 	if (camera && camera->player && !(player->cheats & CF_CHASECAM))
-	{
-		int flags2_backup = camera->flags2;
 		camera->flags2 |= MF2_DONTDRAW;
-		R_RenderBSPNode(numnodes - 1);
-		camera->flags2 = flags2_backup; 
+
+	// each slice must be at least 16 columns wide
+	viewslices_t slices;
+	slices.count = MIN(I_GetWorkerThreads() + 1, (size_t)viewwidth / 16);
+
+	if (r_threads != 1 && slices.count > 1 && !r_zonefull)
+	{
+		slices.basedcol = &dcol;
+		slices.basedspan = &dspan;
+		slices.walllights = walllights;
+
+		size_t heapblocks = Z_HeapAllocations();
+
+		I_RunParallel(R_RenderViewSliceJob, &slices, slices.count);
+
+		viewslicestart = 0;
+		viewslicestop = viewwidth - 1;
+
+		if (Z_HeapAllocations() != heapblocks)
+		{
+			DPrintf("The zone is full; drawing the view on one thread until the next level.\n");
+			r_zonefull = true;
+		}
 	}
 	else
-		R_RenderBSPNode(numnodes - 1);	// The head node is the last node output.
+	{
+		R_RenderViewSlice(0, viewwidth - 1);
+	}
 
-	R_DrawPlanes();
+	if (camera)
+		camera->flags2 = flags2_backup;
 
-	R_DrawMasked();
+	// draw the psprites on top of everything
+	//	but does not draw on side views
+	if (!viewangleoffset)
+		R_DrawPlayerSprites();
 
 	// NOTE(jsd): Full-screen status color blending:
 	int blend_alpha = int(blend_color.geta() * 255.0f);
@@ -1301,6 +1424,7 @@ void R_ExitLevel()
 	V_ForceBlend(blend_color);
 
 	r_underwater = false;
+	r_zonefull = false;
 }
 
 VERSION_CONTROL (r_main_cpp, "$Id$")
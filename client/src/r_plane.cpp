@@ -33,6 +33,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <vector>
 
 #include "i_system.h"
 #include "z_zone.h"
@@ -48,6 +50,7 @@
 #include "m_alloc.h"
 #include "i_video.h"
 #include "v_video.h"
+#include "stats.h"
 
 #include "m_vectors.h"
 #include <math.h>
@@ -61,13 +64,38 @@ planefunction_t 		ceilingfunc;
 static const float flatwidth = 64.0f;
 static const float flatheight = 64.0f;
 
-static visplane_t		*visplanes[MAXVISPLANES];	// killough
-static visplane_t		*freetail;					// killough
-static visplane_t		**freehead = &freetail;		// killough
+// Each thread drawing a slice of the view keeps its own visplanes, clipping
+// arrays and spanstart, which R_ClearPlanes sizes for the current surface.
+static THREAD_LOCAL visplane_t	*visplanes[MAXVISPLANES];	// killough
 
-visplane_t 				*floorplane;
-visplane_t 				*ceilingplane;
-visplane_t				*skyplane;
+// The visplanes of a thread are carved out of blocks of PLANEBLOCKSIZE
+// planes, each followed by its top and bottom arrays.  The blocks are kept
+// from frame to frame and R_ClearPlanes simply starts over at the first one.
+#define PLANEBLOCKSIZE 64
+
+static size_t					visplanesize;				// with its arrays
+static THREAD_LOCAL std::vector<byte*>	*planeblocks;
+static THREAD_LOCAL size_t		numvisplanes;				// used this frame
+
+// the visplanes that R_DrawPlanes will draw, in drawing order
+static THREAD_LOCAL std::vector<visplane_t*>	*drawplanes;
+
+// The spans of the plane being drawn are collected by R_MakeSpans into a
+// list for each row, so the mapping of a row is only calculated once.
+typedef struct
+{
+	int		x1, x2;
+	int		next;							// next span in the row or -1
+} planespan_t;
+
+static THREAD_LOCAL std::vector<planespan_t>	*planespans;
+static THREAD_LOCAL int		*planerowfirst;				// -1 for an empty row
+static THREAD_LOCAL int		*planerowlast;
+static THREAD_LOCAL int		planeminrow, planemaxrow;
+
+THREAD_LOCAL visplane_t		*floorplane;
+THREAD_LOCAL visplane_t		*ceilingplane;
+THREAD_LOCAL visplane_t		*skyplane;
 
 // killough -- hash function for visplanes
 // Empirically verified to be fairly uniform:
@@ -80,8 +108,8 @@ visplane_t				*skyplane;
 //	floorclip starts out SCREENHEIGHT-1
 //	ceilingclip starts out 0
 //
-int     				*floorclip;
-int 					*ceilingclip;
+THREAD_LOCAL int		*floorclip;
+THREAD_LOCAL int		*ceilingclip;
 int						*floorclipinitial;
 int						*ceilingclipinitial;
 
@@ -89,7 +117,11 @@ int						*ceilingclipinitial;
 // spanstart holds the start of a plane span
 // initialized to 0 at start
 //
-int 					*spanstart;
+THREAD_LOCAL int		*spanstart;
+
+static int				planesurfacewidth, planesurfaceheight;
+static unsigned int		planedatagen;				// bumped by R_PlaneInitData
+static THREAD_LOCAL unsigned int planethreadgen;
 
 //
 // texture mapping
@@ -98,19 +130,21 @@ extern fixed_t FocalLengthX, FocalLengthY;
 extern float xfoc, yfoc;
 extern float focratio, ifocratio;
 
-int*					planezlight;
-float					plight, shade;
+THREAD_LOCAL int*		planezlight;
+THREAD_LOCAL float		plight, shade;
 
 fixed_t 				*yslope;
-static fixed_t			planeheight;
+static THREAD_LOCAL fixed_t	planeheight;
 
-static fixed_t			pl_xscale, pl_yscale;
-static fixed_t			pl_viewsin, pl_viewcos;
-static fixed_t			pl_viewxtrans, pl_viewytrans;
-static fixed_t			pl_xstepscale, pl_ystepscale;
+static THREAD_LOCAL fixed_t	pl_xscale, pl_yscale;
+static THREAD_LOCAL fixed_t	pl_viewsin, pl_viewcos;
+static THREAD_LOCAL fixed_t	pl_viewxtrans, pl_viewytrans;
+static THREAD_LOCAL fixed_t	pl_xstepscale, pl_ystepscale;
 
-v3float_t				a, b, c;
-float					ixscale, iyscale;
+// vectors a, b & c of the sloped plane being drawn, on the stack of
+// R_DrawSlopedPlane
+static THREAD_LOCAL v3float_t	*pl_slopevecs;
+THREAD_LOCAL float			ixscale, iyscale;
 
 //
 // R_InitPlanes
@@ -136,6 +170,8 @@ void R_MapSlopedPlane(int y, int x1, int x2)
 	if (len <= 0)
 		return;
 
+	const v3float_t &a = pl_slopevecs[0], &b = pl_slopevecs[1], &c = pl_slopevecs[2];
+
 	// center of the view plane
 	v3float_t s;
 	s.x = x1 - centerx;
@@ -214,7 +250,10 @@ void R_MapSlopedPlane(int y, int x1, int x2)
 //
 // Visplanes with the same texture now match up far better than before.
 //
-void R_MapLevelPlane(int y, int x1, int x2)
+// The mapping of row y is calculated once and used for each span in the
+// list of the row that starts at span.
+//
+static void R_MapLevelPlane(int y, int span)
 {
 	fixed_t distance = FixedMul(planeheight, yslope[y]);
 	fixed_t slope = (fixed_t)(focratio * FixedDiv(planeheight, abs(centery - y) << FRACBITS));
@@ -222,12 +261,10 @@ void R_MapLevelPlane(int y, int x1, int x2)
 	dspan.xstep = FixedMul(pl_xstepscale, slope);
 	dspan.ystep = FixedMul(pl_ystepscale, slope);
 
-	dspan.xfrac = pl_viewxtrans +
-				FixedMul(FixedMul(pl_viewcos, distance), pl_xscale) + 
-				(x1 - centerx) * dspan.xstep;
-	dspan.yfrac = pl_viewytrans -
-				FixedMul(FixedMul(pl_viewsin, distance), pl_yscale) +
-				(x1 - centerx) * dspan.ystep;
+	const dsfixed_t xfrac = pl_viewxtrans +
+				FixedMul(FixedMul(pl_viewcos, distance), pl_xscale);
+	const dsfixed_t yfrac = pl_viewytrans -
+				FixedMul(FixedMul(pl_viewsin, distance), pl_yscale);
 
 	if (fixedlightlev)
 		dspan.colormap = basecolormap.with(fixedlightlev);
@@ -245,10 +282,60 @@ void R_MapLevelPlane(int y, int x1, int x2)
 	}
 
 	dspan.y = y;
-	dspan.x1 = x1;
-	dspan.x2 = x2;
 
-	spanfunc();
+	const planespan_t* spans = &(*planespans)[0];
+
+	for (; span != -1; span = spans[span].next)
+	{
+		dspan.x1 = spans[span].x1;
+		dspan.x2 = spans[span].x2;
+		dspan.xfrac = xfrac + (dspan.x1 - centerx) * dspan.xstep;
+		dspan.yfrac = yfrac + (dspan.x1 - centerx) * dspan.ystep;
+
+		spanfunc();
+	}
+}
+
+//
+// R_ThreadPlaneInitData
+//
+// (Re)allocates the arrays of the calling thread after R_PlaneInitData has
+// been called for a new surface.
+//
+static void R_ThreadPlaneInitData()
+{
+	delete[] floorclip;
+	delete[] ceilingclip;
+	delete[] spanstart;
+	delete[] planerowfirst;
+	delete[] planerowlast;
+
+	floorclip = new int[planesurfacewidth];
+	ceilingclip = new int[planesurfacewidth];
+	spanstart = new int[planesurfaceheight];
+	planerowfirst = new int[planesurfaceheight];
+	planerowlast = new int[planesurfaceheight];
+
+	for (int i = 0; i < planesurfaceheight; i++)
+		planerowfirst[i] = -1;
+
+	if (!planeblocks)
+	{
+		planeblocks = new std::vector<byte*>;
+		drawplanes = new std::vector<visplane_t*>;
+		planespans = new std::vector<planespan_t>;
+	}
+
+	// Free all visplanes and let them be re-allocated as needed.
+	for (size_t i = 0; i < planeblocks->size(); i++)
+		M_Free((*planeblocks)[i]);
+	planeblocks->clear();
+
+	for (int i = 0; i < MAXVISPLANES; i++)
+		visplanes[i] = NULL;
+	numvisplanes = 0;
+
+	planethreadgen = planedatagen;
 }
 
 //
@@ -257,13 +344,16 @@ void R_MapLevelPlane(int y, int x1, int x2)
 //
 void R_ClearPlanes (void)
 {
+	if (planethreadgen != planedatagen)
+		R_ThreadPlaneInitData();
+
 	// opening / clipping determination
 	memcpy(floorclip, floorclipinitial, viewwidth * sizeof(*floorclip));
 	memcpy(ceilingclip, ceilingclipinitial, viewwidth * sizeof(*ceilingclip));
 
 	for (int i = 0; i < MAXVISPLANES; i++)	// new code -- killough
-		for (*freehead = visplanes[i], visplanes[i] = NULL; *freehead; )
-			freehead = &(*freehead)->next;
+		visplanes[i] = NULL;
+	numvisplanes = 0;
 }
 
 //
@@ -273,16 +363,16 @@ void R_ClearPlanes (void)
 //
 static visplane_t *new_visplane(unsigned hash)
 {
-	visplane_t *check = freetail;
+	size_t block = numvisplanes / PLANEBLOCKSIZE;
+
+	if (block == planeblocks->size())
+		planeblocks->push_back((byte*)Calloc(PLANEBLOCKSIZE, visplanesize));
+
+	visplane_t *check = (visplane_t*)((*planeblocks)[block] +
+									  (numvisplanes % PLANEBLOCKSIZE) * visplanesize);
+	check->bottom = &check->top[planesurfacewidth + 2];
+	numvisplanes++;
 
-	if (!check)
-	{
-		check = (visplane_t *)Calloc(1, sizeof(*check) + sizeof(*check->top)*2*I_GetSurfaceWidth());
-		check->bottom = &check->top[I_GetSurfaceWidth() + 2];
-	}
-	else
-		if (!(freetail = freetail->next))
-			freehead = &freetail;
 	check->next = visplanes[hash];
 	visplanes[hash] = check;
 	return check;
@@ -334,11 +424,24 @@ visplane_t *R_FindPlane (plane_t secplane, int picnum, int lightlevel,
 	check->minx = viewwidth;			// Was SCREENWIDTH -- killough 11/98
 	check->maxx = -1;
 
-	memcpy(check->top, viewheightarray, viewwidth * sizeof(*check->top));
-
 	return check;
 }
 
+//
+// R_ClearPlaneColumns
+//
+// Marks the columns x1 through x2 of a visplane as empty.  The columns are
+// only cleared as R_CheckPlane adds them to the plane.
+//
+static inline void R_ClearPlaneColumns(visplane_t* pl, int x1, int x2)
+{
+	for (int x = x1; x <= x2; x++)
+	{
+		pl->top[x] = viewheight;
+		pl->bottom[x] = 0;
+	}
+}
+
 //
 // R_CheckPlane
 //
@@ -378,6 +481,16 @@ visplane_t* R_CheckPlane(visplane_t* pl, int start, int stop)
 	if (x > intrh)
 	{
 		// use the same visplane
+		if (pl->minx > pl->maxx)
+		{
+			R_ClearPlaneColumns(pl, unionl, unionh);
+		}
+		else
+		{
+			R_ClearPlaneColumns(pl, unionl, pl->minx - 1);
+			R_ClearPlaneColumns(pl, pl->maxx + 1, unionh);
+		}
+
 		pl->minx = unionl;
 		pl->maxx = unionh;
 	}
@@ -399,16 +512,49 @@ visplane_t* R_CheckPlane(visplane_t* pl, int start, int stop)
 		pl = new_pl;
 		pl->minx = start;
 		pl->maxx = stop;
-		memcpy(pl->top, viewheightarray, viewwidth * sizeof(*pl->top));
+		R_ClearPlaneColumns(pl, start, stop);
 	}
 	return pl;
 }
 
+//
+// R_AddPlaneSpan
+//
+// Appends a span to the list of row y.
+//
+static inline void R_AddPlaneSpan(int y, int x1, int x2)
+{
+	planespan_t span;
+	span.x1 = x1;
+	span.x2 = x2;
+	span.next = -1;
+
+	const int index = planespans->size();
+	planespans->push_back(span);
+
+	if (planerowfirst[y] == -1)
+		planerowfirst[y] = index;
+	else
+		(*planespans)[planerowlast[y]].next = index;
+	planerowlast[y] = index;
+
+	if (y < planeminrow)
+		planeminrow = y;
+	if (y > planemaxrow)
+		planemaxrow = y;
+}
+
 //
 // R_MakeSpans
 //
-void R_MakeSpans(visplane_t *pl, void(*spanfunc)(int, int, int))
+// Collects the spans of the visplane into the row lists, left to right.
+//
+static void R_MakeSpans(visplane_t *pl)
 {
+	planespans->clear();
+	planeminrow = planesurfaceheight;
+	planemaxrow = -1;
+
 	for (int x = pl->minx; x <= pl->maxx + 1; x++)
 	{
 		unsigned int t1 = pl->top[x-1];
@@ -417,9 +563,9 @@ void R_MakeSpans(visplane_t *pl, void(*spanfunc)(int, int, int))
 		unsigned int b2 = pl->bottom[x];
 		
 		for (; t1 < t2 && t1 <= b1; t1++)
-			spanfunc(t1, spanstart[t1], x-1);
+			R_AddPlaneSpan(t1, spanstart[t1], x-1);
 		for (; b1 > b2 && b1 >= t1; b1--)
-			spanfunc(b1, spanstart[b1], x-1);
+			R_AddPlaneSpan(b1, spanstart[b1], x-1);
 		while (t2 < t1 && t2 <= b2)
 			spanstart[t2++] = x;
 		while (b2 > b1 && b2 >= t2)
@@ -503,6 +649,10 @@ void R_DrawSlopedPlane(visplane_t *pl)
 	M_SubVec3f(&t, &t, &p);
 	M_SubVec3f(&s, &s, &p);
 	
+	v3float_t slopevecs[3];
+	v3float_t &a = slopevecs[0], &b = slopevecs[1], &c = slopevecs[2];
+	pl_slopevecs = slopevecs;
+
 	M_CrossProductVec3f(&a, &p, &s);
 	M_CrossProductVec3f(&b, &t, &p);
 	M_CrossProductVec3f(&c, &t, &s);
@@ -531,7 +681,14 @@ void R_DrawSlopedPlane(visplane_t *pl)
 
 	basecolormap = pl->colormap;	// [RH] set basecolormap
    
-	R_MakeSpans(pl, R_MapSlopedPlane);
+	R_MakeSpans(pl);
+
+	for (int y = planeminrow; y <= planemaxrow; y++)
+	{
+		for (int span = planerowfirst[y]; span != -1; span = (*planespans)[span].next)
+			R_MapSlopedPlane(y, (*planespans)[span].x1, (*planespans)[span].x2);
+		planerowfirst[y] = -1;
+	}
 }
 
 void R_DrawLevelPlane(visplane_t *pl)
@@ -581,10 +738,89 @@ void R_DrawLevelPlane(visplane_t *pl)
 	int light = clamp((pl->lightlevel >> LIGHTSEGSHIFT) + (foggy ? 0 : extralight), 0, LIGHTLEVELS - 1);
 	planezlight = zlight[light];
 
-	R_MakeSpans(pl, R_MapLevelPlane);
+	R_MakeSpans(pl);
+
+	for (int y = planeminrow; y <= planemaxrow; y++)
+	{
+		if (planerowfirst[y] != -1)
+		{
+			R_MapLevelPlane(y, planerowfirst[y]);
+			planerowfirst[y] = -1;
+		}
+	}
 }
 
 
+//
+// R_CacheFlat
+//
+// Locks the flat in the cache and returns it, warped if desired.
+//
+static byte* R_CacheFlat(int useflatnum)
+{
+	R_CacheLock lock;
+
+	byte* source = (byte *)W_CacheLumpNum (firstflat + useflatnum, PU_STATIC);
+						   
+	// [RH] warp a flat if desired
+	if (flatwarp[useflatnum])
+	{
+		if (warpedflats[useflatnum] && flatwarpedwhen[useflatnum] == level.time)
+		{
+			Z_ChangeTag(source, PU_CACHE);
+			source = warpedflats[useflatnum];
+			Z_ChangeTag(source, PU_STATIC);
+		}
+		else
+		{
+			if (!warpedflats[useflatnum])
+				warpedflats[useflatnum] = (byte*)Z_Malloc(64*64, PU_STATIC, &warpedflats[useflatnum]);
+
+			static byte buffer[64];
+			int timebase = level.time*23;
+
+			flatwarpedwhen[useflatnum] = level.time;
+			byte *warped = warpedflats[useflatnum];
+
+			for (int x = 63; x >= 0; x--)
+			{
+				int yt, yf = (finesine[(timebase + ((x+17) << 7))&FINEMASK]>>13) & 63;
+				byte *src = source + x;
+				byte *dest = warped + x;
+				for (yt = 64; yt; yt--, yf = (yf+1)&63, dest += 64)
+					*dest = *(src + (yf << 6));
+			}
+			timebase = level.time*32;
+			for (int y = 63; y >= 0; y--)
+			{
+				int xt, xf = (finesine[(timebase + (y << 7))&FINEMASK]>>13) & 63;
+				byte *src = warped + (y << 6);
+				byte *dest = buffer;
+				for (xt = 64; xt; xt--, xf = (xf+1) & 63)
+					*dest++ = *(src+xf);
+				memcpy (warped + (y << 6), buffer, 64);
+			}
+			Z_ChangeTag (source, PU_CACHE);
+			source = warped;
+		}
+	}
+
+	return source;
+}
+
+//
+// R_ComparePlanes
+//
+// Orders visplanes by flat and then by light level, so that R_DrawPlanes
+// caches each flat once and the planes sharing it are drawn together.
+//
+static bool R_ComparePlanes(const visplane_t* a, const visplane_t* b)
+{
+	if (a->picnum != b->picnum)
+		return a->picnum < b->picnum;
+	return a->lightlevel < b->lightlevel;
+}
+
 //
 // R_DrawPlanes
 //
@@ -592,88 +828,71 @@ void R_DrawLevelPlane(visplane_t *pl)
 //
 void R_DrawPlanes (void)
 {
+	PROFILE_SCOPE(R_DrawPlanes);
+
 	visplane_t *pl;
 	int i;
 
 	R_ResetDrawFuncs();
 
 	dspan.color = 3;
-	
+
+	drawplanes->clear();
 	for (i = 0; i < MAXVISPLANES; i++)
-	{
 		for (pl = visplanes[i]; pl; pl = pl->next)
+			if (pl->minx <= pl->maxx)
+				drawplanes->push_back(pl);
+
+	std::sort(drawplanes->begin(), drawplanes->end(), R_ComparePlanes);
+
+	int cachedflatnum = -1;
+	dspan.source = NULL;
+
+	for (size_t n = 0; n < drawplanes->size(); n++)
+	{
+		pl = (*drawplanes)[n];
+
+		// sky flat
+		if (pl->picnum == skyflatnum || pl->picnum & PL_SKYFLAT)
 		{
-			if (pl->minx > pl->maxx)
-				continue;
+			R_RenderSkyRange(pl);
+		}
+		else
+		{
+			// regular flat
+			int useflatnum = flattranslation[pl->picnum < numflats ? pl->picnum : 0];
 
-			// sky flat
-			if (pl->picnum == skyflatnum || pl->picnum & PL_SKYFLAT)
-			{
-				R_RenderSkyRange(pl);
-			}
-			else
+			dspan.color += 4;	// [RH] color if r_drawflat is 1
+
+			if (useflatnum != cachedflatnum)
 			{
-				// regular flat
-				int useflatnum = flattranslation[pl->picnum < numflats ? pl->picnum : 0];
-
-				dspan.color += 4;	// [RH] color if r_drawflat is 1
-				dspan.source = (byte *)W_CacheLumpNum (firstflat + useflatnum, PU_STATIC);
-										   
-				// [RH] warp a flat if desired
-				if (flatwarp[useflatnum])
+				if (dspan.source)
 				{
-					if (warpedflats[useflatnum] && flatwarpedwhen[useflatnum] == level.time)
-					{
-						Z_ChangeTag(dspan.source, PU_CACHE);
-						dspan.source = warpedflats[useflatnum];
-						Z_ChangeTag(dspan.source, PU_STATIC);
-					}
-					else
-					{
-						if (!warpedflats[useflatnum])
-							warpedflats[useflatnum] = (byte*)Z_Malloc(64*64, PU_STATIC, &warpedflats[useflatnum]);
-
-						static byte buffer[64];
-						int timebase = level.time*23;
-
-						flatwarpedwhen[useflatnum] = level.time;
-						byte *warped = warpedflats[useflatnum];
-
-						for (int x = 63; x >= 0; x--)
-						{
-							int yt, yf = (finesine[(timebase + ((x+17) << 7))&FINEMASK]>>13) & 63;
-							byte *source = dspan.source + x;
-							byte *dest = warped + x;
-							for (yt = 64; yt; yt--, yf = (yf+1)&63, dest += 64)
-								*dest = *(source + (yf << 6));
-						}
-						timebase = level.time*32;
-						for (int y = 63; y >= 0; y--)
-						{
-							int xt, xf = (finesine[(timebase + (y << 7))&FINEMASK]>>13) & 63;
-							byte *source = warped + (y << 6);
-							byte *dest = buffer;
-							for (xt = 64; xt; xt--, xf = (xf+1) & 63)
-								*dest++ = *(source+xf);
-							memcpy (warped + (y << 6), buffer, 64);
-						}
-						Z_ChangeTag (dspan.source, PU_CACHE);
-						dspan.source = warped;
-					}
+					R_CacheLock lock;
+					Z_ChangeTag (dspan.source, PU_CACHE);
 				}
-				
-				pl->top[pl->maxx+1] = viewheight;
-				pl->top[pl->minx-1] = viewheight;
-
-				if (P_IsPlaneLevel(&pl->secplane))
-					R_DrawLevelPlane(pl);
-				else
-					R_DrawSlopedPlane(pl);
-					
-				Z_ChangeTag (dspan.source, PU_CACHE);
+
+				dspan.source = R_CacheFlat(useflatnum);
+				cachedflatnum = useflatnum;
 			}
+
+			pl->top[pl->maxx+1] = viewheight;
+			pl->top[pl->minx-1] = viewheight;
+			pl->bottom[pl->maxx+1] = 0;
+			pl->bottom[pl->minx-1] = 0;
+
+			if (P_IsPlaneLevel(&pl->secplane))
+				R_DrawLevelPlane(pl);
+			else
+				R_DrawSlopedPlane(pl);
 		}
 	}
+
+	if (dspan.source)
+	{
+		R_CacheLock lock;
+		Z_ChangeTag (dspan.source, PU_CACHE);
+	}
 }
 
 //
@@ -684,15 +903,10 @@ bool R_PlaneInitData(IWindowSurface* surface)
 	int surface_width = surface->getWidth();
 	int surface_height = surface->getHeight();
 
-	delete[] floorclip;
-	delete[] ceilingclip;
 	delete[] floorclipinitial;
 	delete[] ceilingclipinitial;
-	delete[] spanstart;
 	delete[] yslope;
 
-	floorclip = new int[surface_width];
-	ceilingclip = new int[surface_width];
 	floorclipinitial = new int[surface_width];
 	ceilingclipinitial = new int[surface_width];
 
@@ -702,32 +916,18 @@ bool R_PlaneInitData(IWindowSurface* surface)
 		floorclipinitial[i] = viewheight;
 	}
 
-	spanstart = new int[surface_height];
 	yslope = new fixed_t[surface_height];
 
-	// Free all visplanes and let them be re-allocated as needed.
-	visplane_t* pl = freetail;
+	// The arrays of each thread are made again by its next R_ClearPlanes.
+	planesurfacewidth = surface_width;
+	planesurfaceheight = surface_height;
 
-	while (pl)
-	{
-		visplane_t *next = pl->next;
-		M_Free(pl);
-		pl = next;
-	}
-	freetail = NULL;
-	freehead = &freetail;
+	// keep each visplane of a block aligned to a cache line
+	visplanesize = sizeof(visplane_t) + sizeof(unsigned int) * 2 * surface_width;
+	visplanesize = (visplanesize + 63) & ~(size_t)63;
+	planedatagen++;
 
-	for (int i = 0; i < MAXVISPLANES; i++)
-	{
-		pl = visplanes[i];
-		visplanes[i] = NULL;
-		while (pl)
-		{
-			visplane_t *next = pl->next;
-			M_Free(pl);
-			pl = next;
-		}
-	}
+	R_ThreadPlaneInitData();
 
 	return true;
 }
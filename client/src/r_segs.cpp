@@ -37,6 +37,7 @@
 #include "r_local.h"
 #include "r_sky.h"
 #include "v_video.h"
+#include "stats.h"
 
 #include "m_vectors.h"
 #include <math.h>
@@ -44,58 +45,59 @@
 #include "p_lnspec.h"
 
 // a pool of bytes allocated for sprite clipping arrays
-Pool<tallpost_t*> masked_midposts_pool(4096);
-Pool<int> sprclip_pool(4096);
+// (one for each thread drawing a slice of the view, made by R_ClearOpenings)
+static THREAD_LOCAL Pool<tallpost_t*>* masked_midposts_pool;
+static THREAD_LOCAL Pool<int>* sprclip_pool;
 
 // OPTIMIZE: closed two sided lines as single sided
 
 // killough 1/6/98: replaced globals with statics where appropriate
 
-static BOOL		segtextured;	// True if any of the segs textures might be visible.
-static BOOL		markfloor;		// False if the back side is the same plane.
-static BOOL		markceiling;
-static BOOL		maskedtexture;
-static bool		didsolidcol;
-static int		toptexture;
-static int		bottomtexture;
-static int		midtexture;
+static THREAD_LOCAL BOOL		segtextured;	// True if any of the segs textures might be visible.
+static THREAD_LOCAL BOOL		markfloor;		// False if the back side is the same plane.
+static THREAD_LOCAL BOOL		markceiling;
+static THREAD_LOCAL BOOL		maskedtexture;
+static THREAD_LOCAL bool		didsolidcol;
+static THREAD_LOCAL int		toptexture;
+static THREAD_LOCAL int		bottomtexture;
+static THREAD_LOCAL int		midtexture;
 
-int*			walllights;
+THREAD_LOCAL int*	walllights;
 
 //
 // regular wall
 //
-fixed_t			rw_light;		// [RH] Use different scaling for lights
-fixed_t			rw_lightstep;
+THREAD_LOCAL fixed_t	rw_light;		// [RH] Use different scaling for lights
+THREAD_LOCAL fixed_t	rw_lightstep;
 
-static fixed_t	rw_scale;
-static fixed_t	rw_scalestep;
-static fixed_t	rw_midtexturemid;
-static fixed_t	rw_toptexturemid;
-static fixed_t	rw_bottomtexturemid;
+static THREAD_LOCAL fixed_t	rw_scale;
+static THREAD_LOCAL fixed_t	rw_scalestep;
+static THREAD_LOCAL fixed_t	rw_midtexturemid;
+static THREAD_LOCAL fixed_t	rw_toptexturemid;
+static THREAD_LOCAL fixed_t	rw_bottomtexturemid;
 
-extern fixed_t	rw_frontcz1, rw_frontcz2;
-extern fixed_t	rw_frontfz1, rw_frontfz2;
-extern fixed_t	rw_backcz1, rw_backcz2;
-extern fixed_t	rw_backfz1, rw_backfz2;
-static bool		rw_hashigh, rw_haslow;
+extern THREAD_LOCAL fixed_t	rw_frontcz1, rw_frontcz2;
+extern THREAD_LOCAL fixed_t	rw_frontfz1, rw_frontfz2;
+extern THREAD_LOCAL fixed_t	rw_backcz1, rw_backcz2;
+extern THREAD_LOCAL fixed_t	rw_backfz1, rw_backfz2;
+static THREAD_LOCAL bool		rw_hashigh, rw_haslow;
 
-static int walltopf[MAXWIDTH];
-static int walltopb[MAXWIDTH];
-static int wallbottomf[MAXWIDTH];
-static int wallbottomb[MAXWIDTH];
+static THREAD_LOCAL int walltopf[MAXWIDTH];
+static THREAD_LOCAL int walltopb[MAXWIDTH];
+static THREAD_LOCAL int wallbottomf[MAXWIDTH];
+static THREAD_LOCAL int wallbottomb[MAXWIDTH];
 
-static tallpost_t* topposts[MAXWIDTH];
-static tallpost_t* midposts[MAXWIDTH];
-static tallpost_t* bottomposts[MAXWIDTH];
+static THREAD_LOCAL tallpost_t* topposts[MAXWIDTH];
+static THREAD_LOCAL tallpost_t* midposts[MAXWIDTH];
+static THREAD_LOCAL tallpost_t* bottomposts[MAXWIDTH];
 
-static fixed_t wallscalex[MAXWIDTH];
-static int texoffs[MAXWIDTH];
+static THREAD_LOCAL fixed_t wallscalex[MAXWIDTH];
+static THREAD_LOCAL int texoffs[MAXWIDTH];
 
 extern fixed_t FocalLengthY;
 extern float yfoc;
 
-static tallpost_t** masked_midposts;
+static THREAD_LOCAL tallpost_t** masked_midposts;
 
 
 //
@@ -357,7 +359,7 @@ void R_RenderColumnRange(int start, int stop, int* top, int* bottom,
 		#define BLOCKMASK (BLOCKSIZE - 1)
 
 		// pre-calculate the color map number for lighting for each screen column 
-		static int light_lookup[MAXWIDTH];
+		static THREAD_LOCAL int light_lookup[MAXWIDTH];
 		if (calc_light)
 		{
 			for (int x = start; x <= stop; x++)
@@ -412,7 +414,7 @@ void R_RenderColumnRange(int start, int stop, int* top, int* bottom,
 //
 void R_RenderSolidSegRange(int start, int stop)
 {
-	static int lower[MAXWIDTH];
+	static THREAD_LOCAL int lower[MAXWIDTH];
 	int count = stop - start + 1;
 	int initial_light = rw_light;
 
@@ -788,6 +790,8 @@ void R_PrepWall(fixed_t px1, fixed_t py1, fixed_t px2, fixed_t py2, fixed_t dist
 //
 void R_StoreWallRange(int start, int stop)
 {
+	PROFILE_SCOPE(R_StoreWallRange);
+
 #ifdef RANGECHECK
 	if (start >= viewwidth || start > stop)
 		I_FatalError ("Bad R_StoreWallRange: %i to %i", start , stop);
@@ -855,7 +859,7 @@ void R_StoreWallRange(int start, int stop)
 		ds_p->sprtopclip = ds_p->sprbottomclip = NULL;
 		ds_p->silhouette = 0;
 
-		extern bool doorclosed;	
+		extern THREAD_LOCAL bool doorclosed;	
 		if (doorclosed)
 		{
 			// clip all sprites behind this closed door (or otherwise solid line)
@@ -992,7 +996,7 @@ void R_StoreWallRange(int start, int stop)
 		{
 			// masked midtexture
 			maskedtexture = texturetranslation[sidedef->midtexture];
-			ds_p->midposts = masked_midposts = masked_midposts_pool.alloc(count) - start;
+			ds_p->midposts = masked_midposts = masked_midposts_pool->alloc(count) - start;
 		}
 
 		// [SL] additional fix for sky hack
@@ -1071,13 +1075,13 @@ void R_StoreWallRange(int start, int stop)
     // save sprite clipping info
 	if ((ds_p->silhouette & SIL_TOP) && ds_p->sprtopclip == NULL)
 	{
-		ds_p->sprtopclip = sprclip_pool.alloc(count) - start;
+		ds_p->sprtopclip = sprclip_pool->alloc(count) - start;
 		memcpy(ds_p->sprtopclip + start, ceilingclip + start, count * sizeof(*ds_p->sprtopclip));
 	}
 
 	if ((ds_p->silhouette & SIL_BOTTOM) && ds_p->sprbottomclip == NULL)
 	{
-		ds_p->sprbottomclip = sprclip_pool.alloc(count) - start;
+		ds_p->sprbottomclip = sprclip_pool->alloc(count) - start;
 		memcpy(ds_p->sprbottomclip + start, floorclip + start, count * sizeof(*ds_p->sprbottomclip));
 	}
 
@@ -1087,8 +1091,14 @@ void R_StoreWallRange(int start, int stop)
 
 void R_ClearOpenings()
 {
-	masked_midposts_pool.clear();
-	sprclip_pool.clear();
+	if (!masked_midposts_pool)
+	{
+		masked_midposts_pool = new Pool<tallpost_t*>(4096);
+		sprclip_pool = new Pool<int>(4096);
+	}
+
+	masked_midposts_pool->clear();
+	sprclip_pool->clear();
 }
 
 VERSION_CONTROL (r_segs_cpp, "$Id$")
@@ -76,7 +76,7 @@ CVAR_FUNC_IMPL(r_stretchsky)
 char SKYFLATNAME[8] = "F_SKY1";
 
 
-static tallpost_t* skyposts[MAXWIDTH];
+static THREAD_LOCAL tallpost_t* skyposts[MAXWIDTH];
 
 
 //
@@ -218,6 +218,7 @@ void R_RenderSkyRange(visplane_t* pl)
 	int columnmethod = 2;
 	int skytex;
 	fixed_t front_offset = 0;
+	fixed_t texturemid = skytexturemid;
 	angle_t skyflip = 0;
 
 	if (pl->picnum == skyflatnum)
@@ -249,7 +250,7 @@ void R_RenderSkyRange(visplane_t* pl)
 		front_offset = (-side->textureoffset) >> 6;
 
 		// Vertical offset allows careful sky positioning.
-		skytexturemid = side->rowoffset - 28*FRACUNIT;
+		texturemid = side->rowoffset - 28*FRACUNIT;
 
 		// We sometimes flip the picture horizontally.
 		//
@@ -264,7 +265,7 @@ void R_RenderSkyRange(visplane_t* pl)
 	const palette_t* pal = V_GetDefaultPalette();
 
 	dcol.iscale = skyiscale >> skystretch;
-	dcol.texturemid = skytexturemid;
+	dcol.texturemid = texturemid;
 	dcol.textureheight = textureheight[skytex];
 	skyplane = pl;
 
@@ -41,6 +41,7 @@
 #include "doomstat.h"
 
 #include "v_video.h"
+#include "stats.h"
 
 #include "cmdlib.h"
 #include "s_sound.h"
@@ -67,7 +68,7 @@ fixed_t			pspriteyscale;
 fixed_t 		pspritexiscale;
 //fixed_t		sky1scale;			// [RH] Sky 1 scale factor
 									// [ML] 5/11/06 - Removed sky2
-int*			spritelights;
+THREAD_LOCAL int*	spritelights;
 
 #define MAX_SPRITE_FRAMES 29		// [RH] Macro-ized as in BOOM.
 #define SPRITE_NEEDS_INFO	MAXINT
@@ -88,7 +89,7 @@ spriteframe_t	sprtemp[MAX_SPRITE_FRAMES];
 int 			maxframe;
 static const char*		spritename;
 
-static tallpost_t* spriteposts[MAXWIDTH];
+static THREAD_LOCAL tallpost_t* spriteposts[MAXWIDTH];
 
 // [RH] particle globals
 extern int				NumParticles;
@@ -102,8 +103,9 @@ void R_CacheSprite (spritedef_t *sprite)
 	int i, r;
 	patch_t *patch;
 
-	DPrintf ("cache sprite %s\n",
-		sprite - sprites < NUMSPRITES ? sprnames[sprite - sprites] : "");
+	if (!I_InParallel())
+		DPrintf ("cache sprite %s\n",
+			sprite - sprites < NUMSPRITES ? sprnames[sprite - sprites] : "");
 	for (i = 0; i < sprite->numframes; i++)
 	{
 		for (r = 0; r < 8; r++)
@@ -113,9 +115,10 @@ void R_CacheSprite (spritedef_t *sprite)
 				if (sprite->spriteframes[i].lump[r] == -1)
 					I_Error ("Sprite %d, rotation %d has no lump", i, r);
 				patch = W_CachePatch (sprite->spriteframes[i].lump[r]);
-				sprite->spriteframes[i].width[r] = patch->width()<<FRACBITS;
 				sprite->spriteframes[i].offset[r] = patch->leftoffset()<<FRACBITS;
 				sprite->spriteframes[i].topoffset[r] = patch->topoffset()<<FRACBITS;
+				// last, as R_ProjectSprite checks it without the cache lock
+				sprite->spriteframes[i].width[r] = patch->width()<<FRACBITS;
 			}
 		}
 	}
@@ -279,11 +282,11 @@ void R_InitSpriteDefs (const char **namelist)
 //
 // GAME FUNCTIONS
 //
-int				MaxVisSprites;
-vissprite_t 	*vissprites;
-vissprite_t		*vissprite_p;
-vissprite_t		*lastvissprite;
-int 			newvissprite;
+THREAD_LOCAL int			MaxVisSprites;
+THREAD_LOCAL vissprite_t	*vissprites;
+THREAD_LOCAL vissprite_t	*vissprite_p;
+THREAD_LOCAL vissprite_t	*lastvissprite;
+THREAD_LOCAL int			newvissprite;
 
 //
 // R_InitSprites
@@ -307,8 +310,18 @@ void R_InitSprites (const char **namelist)
 // R_ClearSprites
 // Called at frame start.
 //
+// The threads drawing slices of the view other than the main thread get
+// their vissprites here the first time.
+//
 void R_ClearSprites (void)
 {
+	if (!vissprites)
+	{
+		MaxVisSprites = 128;
+		vissprites = (vissprite_t *)Malloc (MaxVisSprites * sizeof(vissprite_t));
+		lastvissprite = &vissprites[MaxVisSprites];
+	}
+
 	vissprite_p = vissprites;
 }
 
@@ -325,7 +338,8 @@ vissprite_t *R_NewVisSprite (void)
 		vissprites = (vissprite_t *)Realloc (vissprites, MaxVisSprites * sizeof(vissprite_t));
 		lastvissprite = &vissprites[MaxVisSprites];
 		vissprite_p = &vissprites[prevvisspritenum];
-		DPrintf ("MaxVisSprites increased to %d\n", MaxVisSprites);
+		if (!I_InParallel())
+			DPrintf ("MaxVisSprites increased to %d\n", MaxVisSprites);
 	}
 
 	vissprite_p++;
@@ -339,11 +353,11 @@ vissprite_t *R_NewVisSprite (void)
 // Masked means: partly transparent, i.e. stored
 //	in posts/runs of opaque pixels.
 //
-int*			mfloorclip;
-int*			mceilingclip;
+THREAD_LOCAL int*		mfloorclip;
+THREAD_LOCAL int*		mceilingclip;
 
-fixed_t 		spryscale;
-fixed_t 		sprtopscreen;
+THREAD_LOCAL fixed_t	spryscale;
+THREAD_LOCAL fixed_t	sprtopscreen;
 
 void R_BlastSpriteColumn(void (*drawfunc)())
 {
@@ -521,6 +535,12 @@ static vissprite_t* R_GenerateVisSprite(const sector_t* sector, int fakeside,
 	if (!R_CheckProjectionX(x1, x2))
 		return NULL;
 
+	// clip to the slice of the view being drawn by this thread
+	int slicex1 = MAX(x1, viewslicestart);
+	x2 = MIN(x2, viewslicestop);
+	if (slicex1 > x2)
+		return NULL;
+
 	// Entirely above the top of the screen or below the bottom?
 	int y1 = R_ProjectPointY(gzt - viewz, ty);
 	int y2 = R_ProjectPointY(gzb - viewz, ty) - 1;
@@ -569,7 +589,7 @@ static vissprite_t* R_GenerateVisSprite(const sector_t* sector, int fakeside,
 	vis->gzb = gzb;
 	vis->gzt = gzt;
 	vis->texturemid = gzt - viewz;
-	vis->x1 = x1;
+	vis->x1 = slicex1;
 	vis->x2 = x2;
 	vis->y1 = y1;
 	vis->y2 = y2;
@@ -589,6 +609,9 @@ static vissprite_t* R_GenerateVisSprite(const sector_t* sector, int fakeside,
 		vis->xiscale = iscale;
 	}
 
+	if (slicex1 > x1)
+		vis->startfrac += vis->xiscale * (slicex1 - x1);
+
 	return vis;
 }
 
@@ -733,13 +756,17 @@ void R_ProjectSprite(AActor *thing, int fakeside)
 	}
 
 	if (sprframe->width[rot] == SPRITE_NEEDS_INFO)
-		R_CacheSprite (sprdef);	// [RH] speeds up game startup time
+	{
+		R_CacheLock lock;
+		if (sprframe->width[rot] == SPRITE_NEEDS_INFO)
+			R_CacheSprite (sprdef);	// [RH] speeds up game startup time
+	}
 
 	sector_t* sector = thing->subsector->sector;
 	fixed_t topoffs = sprframe->topoffset[rot];
 	fixed_t sideoffs = sprframe->offset[rot];
 
-	patch_t* patch = W_CachePatch(lump);
+	patch_t* patch = R_CachePatch(lump);
 	fixed_t height = patch->height() << FRACBITS;
 	fixed_t width = patch->width() << FRACBITS;
 
@@ -794,11 +821,23 @@ void R_AddSprites (sector_t *sec, int lightlevel, int fakeside)
 	// A sector might have been split into several
 	//	subsectors during BSP building.
 	// Thus we check whether it was already added.
-	if (sec->validcount == validcount)
+	// Each thread drawing a slice of the view keeps its own marks, since
+	// they all add the sprites of the sectors that they see.
+	static THREAD_LOCAL int *spritesectors;
+	static THREAD_LOCAL int numspritesectors;
+
+	if (numspritesectors != numsectors)
+	{
+		spritesectors = (int *)Realloc (spritesectors, numsectors * sizeof(*spritesectors));
+		memset (spritesectors, 0, numsectors * sizeof(*spritesectors));
+		numspritesectors = numsectors;
+	}
+
+	if (spritesectors[sec - sectors] == validcount)
 		return;
 
 	// Well, now it will be done.
-	sec->validcount = validcount;
+	spritesectors[sec - sectors] = validcount;
 
 	lightnum = (lightlevel >> LIGHTSEGSHIFT) + (foggy ? 0 : extralight);
 
@@ -1032,9 +1071,9 @@ void R_DrawPlayerSprites (void)
 //		gain compared to the old function.
 //
 
-static int				vsprcount;
-static vissprite_t**	spritesorter;
-static int				spritesorter_size = 0;
+static THREAD_LOCAL int				vsprcount;
+static THREAD_LOCAL vissprite_t**	spritesorter;
+static THREAD_LOCAL int				spritesorter_size = 0;
 
 static int STACK_ARGS sv_compare(const void *arg1, const void *arg2)
 {
@@ -1070,8 +1109,8 @@ void R_SortVisSprites (void)
 //
 void R_DrawSprite (vissprite_t *spr)
 {
-	static int			cliptop[MAXWIDTH];
-	static int			clipbot[MAXWIDTH];
+	static THREAD_LOCAL int	cliptop[MAXWIDTH];
+	static THREAD_LOCAL int	clipbot[MAXWIDTH];
 
 	drawseg_t*			ds;
 	int 				x;
@@ -1202,6 +1241,8 @@ void R_DrawSprite (vissprite_t *spr)
 //
 void R_DrawMasked (void)
 {
+	PROFILE_SCOPE(R_DrawMasked);
+
 	drawseg_t		 *ds;
 
 	R_SortVisSprites ();
@@ -1220,13 +1261,6 @@ void R_DrawMasked (void)
 	for (ds=ds_p ; ds-- > drawsegs ; )	// new -- killough
 		if (ds->midposts)
 			R_RenderMaskedSegRange(ds, ds->x1, ds->x2);
-
-	// draw the psprites on top of everything
-	//	but does not draw on side views
-	if (!viewangleoffset)
-	{
-		R_DrawPlayerSprites ();
-	}
 }
 
 void R_InitParticles (void)
@@ -49,6 +49,7 @@
 #include "cl_main.h"
 #include "gi.h"
 #include "cl_demo.h"
+#include "stats.h"
 
 #include "p_ctf.h"
 
@@ -1352,6 +1353,8 @@ static void ST_refreshBackground()
 //
 void ST_Drawer()
 {
+	PROFILE_SCOPE(ST_Drawer);
+
 	if (st_needrefresh)
 		st_statusbaron = R_StatusBarVisible();
 
@@ -336,11 +336,86 @@ public:
 
 	virtual void RunThink ();
 
+	//
+	// ActorBlockMapListNode
+	//
+	// Keeps track of the mapblocks an actor is linked into.
+	//
+	// [SL] Vanilla Doom only considered an actor to be in the mapblock where
+	// its center was located, even if it was overlapping other blocks.
+	//
+	// The actor is appended to the blockthings array of each of those
+	// mapblocks when it is linked.  Unlink and Next search the array from
+	// the end and Unlink erases in place, rather than keeping the actor's
+	// index and swapping the last actor into its place, because the arrays
+	// must stay in the order of vanilla's blocklinks lists: which actor a
+	// check meets first decides what blocks a move or gets picked up, and
+	// demos depend on it.  The search is short since an actor that moves is
+	// unlinked and appended again, so the actors that move most stay near
+	// the end.  Next is only needed when a player can step onto an actor.
+	//
+	class ActorBlockMapListNode
+	{
+	public:
+		ActorBlockMapListNode(AActor *mo);
+		void Link();
+		void Unlink();
+		AActor* Next(int bmx, int bmy);
+
+	private:
+		void clear();
+
+		// the top-left blockmap the actor is in
+		int			originx;
+		int			originy;
+		// the number of blocks the actor occupies
+		int			blockcntx;
+		int			blockcnty;
+
+		AActor		*actor;
+	};
+
+	// The state that movement and collision read from every actor they
+	// come across (P_XYMovement, P_ZMovement, PIT_CheckThing and the
+	// blockmap iterators) is kept together at the start of the object, so
+	// that it takes up a cache line or two instead of being spread over it.
+
     // Info for drawing: position.
     fixed_t		x;
     fixed_t		y;
     fixed_t		z;
 
+    // Momentums, used to update position.
+    fixed_t		momx;
+    fixed_t		momy;
+    fixed_t		momz;
+
+    // For movement checking.
+    fixed_t		radius;
+    fixed_t		height;
+	int				flags;
+	int				flags2;	// Heretic flags
+
+    // The closest interval over all contacted Sectors.
+    fixed_t		floorz;
+    fixed_t		ceilingz;
+
+    // Interaction info, by BLOCKMAP.
+    // Links in blocks (if needed).
+	struct subsector_s		*subsector;
+
+    // If == validcount, already checked.
+    int			validcount;
+
+	mobjtype_t		type;
+
+	ActorBlockMapListNode bmapnode;
+
+	// Everything below is used less often
+
+	fixed_t		dropoffz;
+	struct sector_s		*floorsector;
+
 	fixed_t		prevx;
 	fixed_t		prevy;
 	fixed_t		prevz;
@@ -357,35 +432,10 @@ public:
 
 	DWORD			effects;			// [RH] see p_effect.h
 
-    // Interaction info, by BLOCKMAP.
-    // Links in blocks (if needed).
-	struct subsector_s		*subsector;
-
-    // The closest interval over all contacted Sectors.
-    fixed_t		floorz;
-    fixed_t		ceilingz;
-	fixed_t		dropoffz;
-	struct sector_s		*floorsector;
-
-    // For movement checking.
-    fixed_t		radius;
-    fixed_t		height;
-
-    // Momentums, used to update position.
-    fixed_t		momx;
-    fixed_t		momy;
-    fixed_t		momz;
-
-    // If == validcount, already checked.
-    int			validcount;
-
-	mobjtype_t		type;
     mobjinfo_t*		info;	// &mobjinfo[mobj->type]
     int				tics;	// state tic counter
 	state_t			*state;
 	int				damage;			// For missiles	
-	int				flags;
-	int				flags2;	// Heretic flags
 	int				special1;		// Special info
 	int				special2;		// Special info
 	int 			health;
@@ -473,45 +523,6 @@ public:
 
 	AActorPtr ptr(){ return AActorPtr(self); }
 	
-	//
-	// ActorBlockMapListNode
-	//
-	// [SL] A container for the linked list nodes for all of the mapblocks that
-	// an actor can be standing in.  Vanilla Doom only considered an actor to
-	// be in the mapblock where its center was located, even if it was
-	// overlapping other blocks.
-	//
-	class ActorBlockMapListNode
-	{
-	public:
-		ActorBlockMapListNode(AActor *mo);
-		void Link();
-		void Unlink();
-		AActor* Next(int bmx, int bmy);
-
-	private:
-		void clear();
-		size_t getIndex(int bmx, int bmy);
-		
-		static const size_t BLOCKSX = 3;
-		static const size_t BLOCKSY = 3;
-
-		AActor		*actor;
-			
-		// the top-left blockmap the actor is in
-		int			originx;
-		int			originy;
-		// the number of blocks the actor occupies
-		int			blockcntx;
-		int			blockcnty;
-
-		// the next and previous actors in each of the possible blockmaps
-		// this actor can inhabit
-		AActor		*next[BLOCKSX * BLOCKSY];
-		AActor		**prev[BLOCKSX * BLOCKSY];
-	};
-	
-	ActorBlockMapListNode bmapnode;
 };
 
 
@@ -77,6 +77,10 @@ CVAR_RANGE(			sv_fraglimit,     "0", "Sets the amount of frags a player can accu
 CVAR(				sv_fastmonsters, "0", "Monsters are at nightmare speed",
 					CVARTYPE_BOOL, CVAR_SERVERARCHIVE | CVAR_SERVERINFO)
 
+CVAR(				sv_parallelai, "0", "Check the sight of monsters about to act on the worker " \
+					"threads set by sv_netthreads",
+					CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
+
 CVAR_RANGE(			sv_monsterdamage, "1.0", "Amount to multiply monster weapon damage by",
 					CVARTYPE_FLOAT, CVAR_SERVERARCHIVE | CVAR_SERVERINFO | CVAR_LATCH | CVAR_NOENABLEDISABLE,
 					0.0f, 100.0f)
@@ -0,0 +1,411 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Delta compression of player and actor movement against the last
+//	state acknowledged by the client
+//
+//-----------------------------------------------------------------------------
+
+#include "d_netdelta.h"
+
+//
+// Variable-length integers
+//
+// Seven bits per byte, least significant first, with the high bit set on
+// every byte but the last.  Signed values are zigzag-encoded first so that
+// small negative deltas stay small.
+//
+static void WriteVarint(buf_t *buf, unsigned int value)
+{
+	while (value >= 0x80)
+	{
+		buf->WriteByte((value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+	buf->WriteByte(value);
+}
+
+static unsigned int ReadVarint(buf_t *buf)
+{
+	unsigned int value = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		int b = buf->ReadByte();
+		if (b == -1)
+			break;
+
+		value |= (unsigned int)(b & 0x7F) << shift;
+		if (!(b & 0x80))
+			break;
+	}
+	return value;
+}
+
+static void WriteDelta(buf_t *buf, int value, int base)
+{
+	int delta = (int)((unsigned int)value - (unsigned int)base);
+	WriteVarint(buf, ((unsigned int)delta << 1) ^ (unsigned int)(delta >> 31));
+}
+
+static int ReadDelta(buf_t *buf, int base)
+{
+	unsigned int zigzag = ReadVarint(buf);
+	int delta = (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+	return (int)((unsigned int)base + (unsigned int)delta);
+}
+
+NetEntityState::NetEntityState()
+{
+	clear();
+}
+
+void NetEntityState::clear()
+{
+	x = y = z = 0;
+	momx = momy = momz = 0;
+	angle = pitch = 0;
+	frame = extra = 0;
+}
+
+void NetEntityState::write(buf_t *buf, const NetEntityState &base) const
+{
+	int fields = 0;
+
+	if (x != base.x)
+		fields |= DELTA_X;
+	if (y != base.y)
+		fields |= DELTA_Y;
+	if (z != base.z)
+		fields |= DELTA_Z;
+	if (momx != base.momx)
+		fields |= DELTA_MOMX;
+	if (momy != base.momy)
+		fields |= DELTA_MOMY;
+	if (momz != base.momz)
+		fields |= DELTA_MOMZ;
+	if (angle != base.angle)
+		fields |= DELTA_ANGLE;
+	if (pitch != base.pitch)
+		fields |= DELTA_PITCH;
+	if (frame != base.frame)
+		fields |= DELTA_FRAME;
+	if (extra != base.extra)
+		fields |= DELTA_EXTRA;
+
+	// The rarely changing fields are in the high bits so the mask usually
+	// fits in a single byte
+	WriteVarint(buf, fields);
+
+	if (fields & DELTA_X)
+		WriteDelta(buf, x, base.x);
+	if (fields & DELTA_Y)
+		WriteDelta(buf, y, base.y);
+	if (fields & DELTA_Z)
+		WriteDelta(buf, z, base.z);
+	if (fields & DELTA_MOMX)
+		WriteDelta(buf, momx, base.momx);
+	if (fields & DELTA_MOMY)
+		WriteDelta(buf, momy, base.momy);
+	if (fields & DELTA_MOMZ)
+		WriteDelta(buf, momz, base.momz);
+	if (fields & DELTA_ANGLE)
+		WriteDelta(buf, angle, base.angle);
+	if (fields & DELTA_PITCH)
+		WriteDelta(buf, pitch, base.pitch);
+	if (fields & DELTA_FRAME)
+		WriteDelta(buf, frame, base.frame);
+	if (fields & DELTA_EXTRA)
+		WriteDelta(buf, extra, base.extra);
+}
+
+void NetEntityState::read(buf_t *buf, const NetEntityState &base)
+{
+	*this = base;
+
+	int fields = ReadVarint(buf);
+
+	if (fields & DELTA_X)
+		x = ReadDelta(buf, base.x);
+	if (fields & DELTA_Y)
+		y = ReadDelta(buf, base.y);
+	if (fields & DELTA_Z)
+		z = ReadDelta(buf, base.z);
+	if (fields & DELTA_MOMX)
+		momx = ReadDelta(buf, base.momx);
+	if (fields & DELTA_MOMY)
+		momy = ReadDelta(buf, base.momy);
+	if (fields & DELTA_MOMZ)
+		momz = ReadDelta(buf, base.momz);
+	if (fields & DELTA_ANGLE)
+		angle = ReadDelta(buf, base.angle);
+	if (fields & DELTA_PITCH)
+		pitch = ReadDelta(buf, base.pitch);
+	if (fields & DELTA_FRAME)
+		frame = ReadDelta(buf, base.frame);
+	if (fields & DELTA_EXTRA)
+		extra = ReadDelta(buf, base.extra);
+}
+
+
+NetDeltaEncoder::NetDeltaEncoder() : epoch(0)
+{
+	clear();
+}
+
+//
+// NetDeltaEncoder::clear
+//
+// Forgets everything sent to the client, such as when a new map is loaded.
+//
+void NetDeltaEncoder::clear()
+{
+	entities.clear();
+	pending.clear();
+
+	for (int i = 0; i < NET_DELTA_PACKETS; i++)
+	{
+		packets[i].sequence = -1;
+		packets[i].sent.clear();
+	}
+}
+
+//
+// NetDeltaEncoder::reset
+//
+// Forgets the states sent for an entity that no longer exists.  Any stamps
+// for it that are still waiting for an acknowledgement are ignored since the
+// next entity to use the key gets a new epoch.
+//
+void NetDeltaEncoder::reset(unsigned int key)
+{
+	entities.erase(key);
+}
+
+//
+// NetDeltaEncoder::write
+//
+// Writes the stamp of the new state, the stamp of its baseline and the delta
+// between them.  The state is sent in full (the baseline stamp matches the
+// new stamp) if the client has not acknowledged a usable baseline or if the
+// entity is due for a keyframe.
+//
+void NetDeltaEncoder::write(buf_t *buf, unsigned int key, const NetEntityState &state, int tic)
+{
+	EntityMap::iterator it = entities.find(key);
+	if (it == entities.end())
+	{
+		entity_t &entity = entities[key];
+		entity.epoch = epoch++;
+		entity.next_stamp = 0;
+		entity.base_stamp = -1;
+		entity.keyframe_tic = tic;
+		for (int i = 0; i < NET_DELTA_WINDOW; i++)
+			entity.stamps[i] = -1;
+
+		it = entities.find(key);
+	}
+
+	entity_t &entity = it->second;
+
+	byte stamp = entity.next_stamp++;
+	short base = entity.base_stamp;
+
+	bool absolute = base == -1 ||
+					(byte)(stamp - base) >= NET_DELTA_WINDOW ||
+					entity.stamps[base % NET_DELTA_WINDOW] != base ||
+					tic - entity.keyframe_tic >= NET_DELTA_KEYFRAME;
+
+	buf->WriteByte(stamp);
+
+	if (absolute)
+	{
+		buf->WriteByte(stamp);
+		state.write(buf, NetEntityState());
+		entity.keyframe_tic = tic;
+	}
+	else
+	{
+		buf->WriteByte((byte)base);
+		state.write(buf, entity.states[base % NET_DELTA_WINDOW]);
+	}
+
+	entity.stamps[stamp % NET_DELTA_WINDOW] = stamp;
+	entity.states[stamp % NET_DELTA_WINDOW] = state;
+
+	sent_t sent;
+	sent.key = key;
+	sent.epoch = entity.epoch;
+	sent.stamp = stamp;
+	pending.push_back(sent);
+}
+
+//
+// NetDeltaEncoder::packetSent
+//
+// Associates the states written since the last packet with the packet's
+// sequence number.  If the unreliable part of the packet was dropped, the
+// states never reach the client and must not become baselines.
+//
+void NetDeltaEncoder::packetSent(int sequence, bool delivered)
+{
+	if (!delivered)
+	{
+		for (size_t i = 0; i < pending.size(); i++)
+			forget(pending[i]);
+
+		pending.clear();
+		return;
+	}
+
+	packet_t &packet = packets[sequence % NET_DELTA_PACKETS];
+	packet.sequence = sequence;
+	packet.sent.swap(pending);
+	pending.clear();
+}
+
+//
+// NetDeltaEncoder::discard
+//
+// Leaves one of the states written since the last packet out of it, such as
+// when the rate limit holds its message back.  index counts the calls to
+// write since the last packet.
+//
+void NetDeltaEncoder::discard(size_t index)
+{
+	if (index >= pending.size())
+		return;
+
+	forget(pending[index]);
+	pending[index].epoch = -1;
+}
+
+//
+// NetDeltaEncoder::forget
+//
+// Makes sure a state the client never received is not used as a baseline.
+//
+void NetDeltaEncoder::forget(const sent_t &sent)
+{
+	EntityMap::iterator it = entities.find(sent.key);
+	if (it == entities.end() || it->second.epoch != sent.epoch)
+		return;
+
+	short &stamp = it->second.stamps[sent.stamp % NET_DELTA_WINDOW];
+	if (stamp == sent.stamp)
+		stamp = -1;
+}
+
+//
+// NetDeltaEncoder::packetAcked
+//
+// The client received the packet, so the states it carried can be used as
+// baselines for future deltas.
+//
+void NetDeltaEncoder::packetAcked(int sequence)
+{
+	if (sequence < 0)
+		return;
+
+	packet_t &packet = packets[sequence % NET_DELTA_PACKETS];
+	if (packet.sequence != sequence)
+		return;
+
+	for (size_t i = 0; i < packet.sent.size(); i++)
+	{
+		const sent_t &sent = packet.sent[i];
+
+		EntityMap::iterator it = entities.find(sent.key);
+		if (it == entities.end() || it->second.epoch != sent.epoch)
+			continue;
+
+		entity_t &entity = it->second;
+
+		// the state may have been overwritten by a newer one
+		if (entity.stamps[sent.stamp % NET_DELTA_WINDOW] != sent.stamp)
+			continue;
+
+		// only move the baseline forward
+		if (entity.base_stamp == -1 || (byte)(sent.stamp - entity.base_stamp) < 128)
+			entity.base_stamp = sent.stamp;
+	}
+
+	packet.sequence = -1;
+	packet.sent.clear();
+}
+
+
+NetDeltaHistory::entity_t::entity_t()
+{
+	for (int i = 0; i < NET_DELTA_WINDOW; i++)
+		stamps[i] = -1;
+}
+
+void NetDeltaHistory::clear()
+{
+	entities.clear();
+}
+
+void NetDeltaHistory::clear(unsigned int key)
+{
+	entities.erase(key);
+}
+
+//
+// NetDeltaHistory::read
+//
+// Reads a state written by NetDeltaEncoder::write.  Returns false if the
+// baseline it was encoded against is not known, in which case the message is
+// still consumed but the state must be ignored.  After a clear, that holds
+// for every delta until the entity has been sent in full.
+//
+bool NetDeltaHistory::read(buf_t *buf, unsigned int key, NetEntityState &state)
+{
+	byte stamp = buf->ReadByte();
+	byte base = buf->ReadByte();
+
+	entity_t &entity = entities[key];
+
+	bool known = true;
+
+	if (base == stamp)
+	{
+		state.read(buf, NetEntityState());
+	}
+	else if (entity.stamps[base % NET_DELTA_WINDOW] == base)
+	{
+		state.read(buf, entity.states[base % NET_DELTA_WINDOW]);
+	}
+	else
+	{
+		state.read(buf, NetEntityState());
+		known = false;
+	}
+
+	if (buf->overflowed)
+		return false;
+
+	if (known)
+	{
+		entity.stamps[stamp % NET_DELTA_WINDOW] = stamp;
+		entity.states[stamp % NET_DELTA_WINDOW] = state;
+	}
+
+	return known;
+}
+
+VERSION_CONTROL (d_netdelta_cpp, "$Id$")
@@ -0,0 +1,180 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Delta compression of player and actor movement against the last
+//	state acknowledged by the client
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __D_NETDELTA__
+#define __D_NETDELTA__
+
+#include <map>
+#include <vector>
+
+#include "doomtype.h"
+#include "doomdef.h"
+#include "i_net.h"
+#include "m_fixed.h"
+#include "tables.h"
+
+// Number of states remembered per entity on each end of the connection.
+// A baseline that falls out of this window can not be used and the entity
+// is sent in full instead.
+static const int NET_DELTA_WINDOW = 16;
+
+// Number of sent packets whose delta contents are remembered by the server
+// while waiting for the client to acknowledge them.
+static const int NET_DELTA_PACKETS = 64;
+
+// An absolute state is sent at least this often for each entity so that a
+// client (or a netdemo being seeked) can always recover.
+static const int NET_DELTA_KEYFRAME = TICRATE;
+
+// Keys identifying the stream an entity state belongs to.  Actors use their
+// netid directly.
+static const unsigned int NET_DELTA_PLAYERKEY		= 0x10000;
+static const unsigned int NET_DELTA_LOCALPLAYERKEY	= 0x20000;
+
+//
+// NetEntityState
+//
+// The movement state of an entity as sent to a client.  Each message type
+// decides what the fields hold (eg, svc_moveplayer_delta sends short angles
+// while svc_movemobj_delta sends full ones); the delta encoding only cares
+// that the same fields mean the same thing on both ends.
+//
+// On the wire, a state is a field mask followed by the zigzag-encoded
+// difference of each changed field from the baseline state.
+//
+class NetEntityState
+{
+public:
+	NetEntityState();
+
+	fixed_t		x, y, z;
+	fixed_t		momx, momy, momz;
+	angle_t		angle, pitch;
+	int			frame;
+	int			extra;
+
+	void clear();
+	void write(buf_t *buf, const NetEntityState &base) const;
+	void read(buf_t *buf, const NetEntityState &base);
+
+private:
+	static const int DELTA_X		= 0x0001;
+	static const int DELTA_Y		= 0x0002;
+	static const int DELTA_Z		= 0x0004;
+	static const int DELTA_MOMX		= 0x0008;
+	static const int DELTA_MOMY		= 0x0010;
+	static const int DELTA_MOMZ		= 0x0020;
+	static const int DELTA_ANGLE	= 0x0040;
+	static const int DELTA_PITCH	= 0x0080;
+	static const int DELTA_FRAME	= 0x0100;
+	static const int DELTA_EXTRA	= 0x0200;
+};
+
+//
+// NetDeltaEncoder
+//
+// Server-side, per-client record of the states sent to a client.  Every
+// state sent is stamped with an 8-bit per-entity counter and written as a
+// delta against the newest state the client has acknowledged receiving.
+// The stamps sent in each packet are remembered until that packet is
+// acknowledged so the acknowledgement can advance the baselines.
+//
+class NetDeltaEncoder
+{
+public:
+	NetDeltaEncoder();
+
+	void clear();
+	void reset(unsigned int key);
+
+	void write(buf_t *buf, unsigned int key, const NetEntityState &state, int tic);
+
+	void packetSent(int sequence, bool delivered);
+	void packetAcked(int sequence);
+
+	size_t pendingStates() const { return pending.size(); }
+	void discard(size_t index);
+
+private:
+	struct entity_t
+	{
+		int				epoch;
+		byte			next_stamp;
+		short			base_stamp;
+		int				keyframe_tic;
+		short			stamps[NET_DELTA_WINDOW];
+		NetEntityState	states[NET_DELTA_WINDOW];
+	};
+
+	struct sent_t
+	{
+		unsigned int	key;
+		int				epoch;
+		byte			stamp;
+	};
+
+	struct packet_t
+	{
+		int					sequence;
+		std::vector<sent_t>	sent;
+	};
+
+	void forget(const sent_t &sent);
+
+	typedef std::map<unsigned int, entity_t> EntityMap;
+
+	EntityMap			entities;
+	std::vector<sent_t>	pending;
+	packet_t			packets[NET_DELTA_PACKETS];
+	int					epoch;
+};
+
+//
+// NetDeltaHistory
+//
+// Client-side record of the states received from the server, used to
+// rebuild full states from the deltas.
+//
+class NetDeltaHistory
+{
+public:
+	void clear();
+	void clear(unsigned int key);
+
+	bool read(buf_t *buf, unsigned int key, NetEntityState &state);
+
+private:
+	struct entity_t
+	{
+		entity_t();
+
+		short			stamps[NET_DELTA_WINDOW];
+		NetEntityState	states[NET_DELTA_WINDOW];
+	};
+
+	typedef std::map<unsigned int, entity_t> EntityMap;
+
+	EntityMap	entities;
+};
+
+#endif	// __D_NETDELTA__
@@ -0,0 +1,412 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Sequenced reliable channel from the server to a client
+//
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+
+#include "d_netreliable.h"
+
+// svc_reliable, sequence, flags and length
+static const size_t FRAGMENT_HEADER_SIZE = 6;
+
+//
+// ExpandSequence
+//
+// Only the low 16 bits of a sequence are sent.  The full sequence is the one
+// nearest to a reference sequence known to both ends.
+//
+static unsigned int ExpandSequence(unsigned int reference, unsigned int wire)
+{
+	return reference + (short)(wire - (reference & 0xFFFF));
+}
+
+
+NetReliableSender::NetReliableSender()
+{
+	clear();
+}
+
+//
+// NetReliableSender::clear
+//
+// Forgets every queued message, such as when a new client takes the slot.
+//
+void NetReliableSender::clear()
+{
+	fragments.clear();
+	sequence = 0;
+	queuedbytes = 0;
+
+	measured = false;
+	srtt = 0;
+	rttvar = 0;
+	rto = NET_RELIABLE_INITRTO;
+}
+
+//
+// NetReliableSender::queue
+//
+// Adds a message to the end of the queue.  The message is appended to the
+// newest fragment if that has not been sent yet, so a backlog of small
+// messages does not cost a record header each.
+//
+void NetReliableSender::queue(const byte *data, size_t len)
+{
+	size_t offset = 0;
+
+	if (!fragments.empty() && !fragments.back().sends &&
+		fragments.back().data.size() < NET_RELIABLE_FRAGMENT)
+	{
+		fragment_t &back = fragments.back();
+
+		offset = std::min(len, NET_RELIABLE_FRAGMENT - back.data.size());
+		back.data.insert(back.data.end(), data, data + offset);
+
+		// the message continues in the fragments that follow
+		if (offset < len)
+			back.flags &= ~FRAGMENT_LAST;
+	}
+
+	while (offset < len)
+	{
+		size_t size = std::min(len - offset, NET_RELIABLE_FRAGMENT);
+
+		fragments.push_back(fragment_t());
+
+		fragment_t &frag = fragments.back();
+		frag.sequence = sequence++;
+		frag.flags = offset ? 0 : FRAGMENT_FIRST;
+		frag.acked = false;
+		frag.sends = 0;
+		frag.senttime = 0;
+		frag.data.assign(data + offset, data + offset + size);
+
+		offset += size;
+
+		if (offset == len)
+			frag.flags |= FRAGMENT_LAST;
+	}
+
+	queuedbytes += len;
+}
+
+//
+// NetReliableSender::due
+//
+// Returns true if a fragment that has been sent should be sent again.
+//
+bool NetReliableSender::due(const fragment_t &frag, dtime_t now) const
+{
+	if (frag.acked)
+		return false;
+
+	unsigned int timeout = rto << std::min<int>(frag.sends - 1, 5);
+	if (timeout > NET_RELIABLE_MAXRTO)
+		timeout = NET_RELIABLE_MAXRTO;
+
+	return now - frag.senttime >= timeout;
+}
+
+//
+// NetReliableSender::ready
+//
+// Returns true if write would send anything.
+//
+bool NetReliableSender::ready(dtime_t now) const
+{
+	size_t window = std::min<size_t>(fragments.size(), NET_RELIABLE_WINDOW);
+
+	for (size_t i = 0; i < window; i++)
+	{
+		const fragment_t &frag = fragments[i];
+
+		if (!frag.sends || due(frag, now))
+			return true;
+	}
+
+	return false;
+}
+
+void NetReliableSender::writeFragment(buf_t *buf, fragment_t &frag, dtime_t now)
+{
+	// not MSG_WriteMarker, which could send the packet being built
+	buf->WriteByte(svc_reliable);
+	buf->WriteShort(frag.sequence & 0xFFFF);
+	buf->WriteByte(frag.flags);
+	buf->WriteShort(frag.data.size());
+	buf->WriteChunk((const char *)&frag.data[0], frag.data.size());
+
+	if (frag.sends < 255)
+		frag.sends++;
+	frag.senttime = now;
+}
+
+//
+// NetReliableSender::write
+//
+// Writes the fragments due to be sent to a packet, retransmissions first,
+// without going over budget bytes.  Only the oldest NET_RELIABLE_WINDOW
+// fragments can be sent, so a client that stops acknowledging is sent no
+// more than a window's worth per timeout.  Returns the number of bytes
+// written.
+//
+size_t NetReliableSender::write(buf_t *buf, size_t budget, dtime_t now)
+{
+	size_t window = std::min<size_t>(fragments.size(), NET_RELIABLE_WINDOW);
+	size_t written = 0;
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (size_t i = 0; i < window; i++)
+		{
+			fragment_t &frag = fragments[i];
+
+			if (pass == 0 ? !frag.sends || !due(frag, now) : frag.sends != 0)
+				continue;
+
+			size_t size = FRAGMENT_HEADER_SIZE + frag.data.size();
+			if (written + size > budget)
+				return written;
+
+			writeFragment(buf, frag, now);
+			written += size;
+		}
+	}
+
+	return written;
+}
+
+//
+// NetReliableSender::sampleRTT
+//
+// Updates the retransmission timeout as in RFC 6298.  Fragments that were
+// sent more than once are not sampled since it is unknown which copy was
+// acknowledged.
+//
+void NetReliableSender::sampleRTT(const fragment_t &frag, dtime_t now)
+{
+	if (frag.sends != 1)
+		return;
+
+	unsigned int rtt = (unsigned int)(now - frag.senttime);
+
+	if (!measured)
+	{
+		srtt = rtt;
+		rttvar = rtt / 2;
+		measured = true;
+	}
+	else
+	{
+		unsigned int err = rtt > srtt ? rtt - srtt : srtt - rtt;
+		rttvar = (3 * rttvar + err) / 4;
+		srtt = (7 * srtt + rtt) / 8;
+	}
+
+	rto = srtt + 4 * rttvar;
+	rto = std::max(rto, NET_RELIABLE_MINRTO);
+	rto = std::min(rto, NET_RELIABLE_MAXRTO);
+}
+
+//
+// NetReliableSender::readAck
+//
+// Reads a clc_reliableack: [short:next expected] [long:mask], where bit n of
+// the mask is set if the client holds fragment next+1+n.
+//
+void NetReliableSender::readAck(buf_t *buf, dtime_t now)
+{
+	unsigned int wire = buf->ReadShort() & 0xFFFF;
+	unsigned int mask = buf->ReadLong();
+
+	if (buf->overflowed || fragments.empty())
+		return;
+
+	unsigned int next = ExpandSequence(fragments.front().sequence, wire);
+
+	for (size_t i = 0; i < fragments.size(); i++)
+	{
+		fragment_t &frag = fragments[i];
+
+		// the client can not have a fragment that was never sent
+		if (!frag.sends)
+			break;
+
+		int offset = (int)(frag.sequence - next);
+
+		if (frag.acked || offset == 0 || offset >= (int)NET_RELIABLE_WINDOW ||
+			(offset > 0 && !(mask & (1u << (offset - 1)))))
+			continue;
+
+		sampleRTT(frag, now);
+		frag.acked = true;
+	}
+
+	while (!fragments.empty() && fragments.front().acked)
+	{
+		queuedbytes -= std::min(queuedbytes, fragments.front().data.size());
+		fragments.pop_front();
+	}
+}
+
+
+NetReliableReceiver::NetReliableReceiver() : complete(MAX_UDP_PACKET)
+{
+	clear();
+}
+
+//
+// NetReliableReceiver::clear
+//
+// Expects the first fragment sent to a newly connected client.
+//
+void NetReliableReceiver::clear()
+{
+	for (unsigned int i = 0; i < NET_RELIABLE_WINDOW; i++)
+	{
+		fragments[i].received = false;
+		fragments[i].data.clear();
+	}
+
+	sequence = 0;
+	synced = true;
+	ackpending = false;
+	partial.clear();
+	complete.clear();
+}
+
+//
+// NetReliableReceiver::resync
+//
+// Picks up the stream at the next message that starts, for netdemos which
+// begin or are seeked to somewhere in the middle of it.
+//
+void NetReliableReceiver::resync()
+{
+	clear();
+	synced = false;
+}
+
+//
+// NetReliableReceiver::read
+//
+// Reads an svc_reliable record and adds every message it finishes to the
+// complete messages.  Returns false, with the buffer marked as overflowed,
+// if the record is malformed.
+//
+bool NetReliableReceiver::read(buf_t *buf)
+{
+	unsigned int wire = buf->ReadShort() & 0xFFFF;
+	byte flags = buf->ReadByte();
+	size_t len = buf->ReadShort() & 0xFFFF;
+	const byte *data = buf->ReadChunk(len);
+
+	if (len > NET_RELIABLE_FRAGMENT)
+		buf->overflowed = true;
+
+	if (buf->overflowed)
+		return false;
+
+	if (!synced)
+	{
+		if (!(flags & NetReliableSender::FRAGMENT_FIRST))
+			return true;
+
+		sequence = wire;
+		synced = true;
+	}
+
+	// duplicates are acknowledged again in case the first ack was lost
+	ackpending = true;
+
+	unsigned int seq = ExpandSequence(sequence, wire);
+	unsigned int offset = seq - sequence;
+
+	if (offset >= NET_RELIABLE_WINDOW)
+		return true;
+
+	fragment_t &frag = fragments[seq % NET_RELIABLE_WINDOW];
+	if (!frag.received)
+	{
+		frag.received = true;
+		frag.flags = flags;
+		frag.data.assign(data, data + len);
+	}
+
+	release();
+	return true;
+}
+
+//
+// NetReliableReceiver::release
+//
+// Moves the fragments that are next in sequence out of the window.
+//
+void NetReliableReceiver::release()
+{
+	while (true)
+	{
+		fragment_t &frag = fragments[sequence % NET_RELIABLE_WINDOW];
+		if (!frag.received)
+			break;
+
+		if (frag.flags & NetReliableSender::FRAGMENT_FIRST)
+			partial.clear();
+
+		partial.insert(partial.end(), frag.data.begin(), frag.data.end());
+
+		if ((frag.flags & NetReliableSender::FRAGMENT_LAST) && !partial.empty())
+		{
+			if (complete.maxsize() - complete.size() <= partial.size())
+				complete.resize(complete.size() + partial.size() + MAX_UDP_PACKET, false);
+
+			complete.WriteChunk((const char *)&partial[0], partial.size());
+			partial.clear();
+		}
+
+		frag.received = false;
+		frag.data.clear();
+		sequence++;
+	}
+}
+
+//
+// NetReliableReceiver::writeAck
+//
+// Writes the body of a clc_reliableack.
+//
+void NetReliableReceiver::writeAck(buf_t *buf)
+{
+	unsigned int mask = 0;
+
+	for (unsigned int i = 0; i < NET_RELIABLE_WINDOW - 1; i++)
+	{
+		if (fragments[(sequence + 1 + i) % NET_RELIABLE_WINDOW].received)
+			mask |= 1u << i;
+	}
+
+	buf->WriteShort(sequence & 0xFFFF);
+	buf->WriteLong(mask);
+
+	ackpending = false;
+}
+
+VERSION_CONTROL (d_netreliable_cpp, "$Id$")
@@ -0,0 +1,148 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Sequenced reliable channel from the server to a client
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __D_NETRELIABLE__
+#define __D_NETRELIABLE__
+
+#include <deque>
+#include <vector>
+
+#include "doomtype.h"
+#include "i_net.h"
+
+// Largest piece of a reliable message sent in one svc_reliable record
+static const size_t NET_RELIABLE_FRAGMENT = 1024;
+
+// Most reliable data (including record headers) put in one packet, so that
+// a burst is spread over several packets instead of filling one datagram
+static const size_t NET_RELIABLE_PACKET = 1200;
+
+// Number of fragments that can be in flight without being acknowledged.
+// This is also the width of the selective acknowledgement mask.
+static const unsigned int NET_RELIABLE_WINDOW = 32;
+
+// A client that lets this much reliable data back up is dropped
+static const size_t NET_RELIABLE_MAXQUEUE = 256 * 1024;
+
+// Bounds of the retransmission timeout, in milliseconds
+static const unsigned int NET_RELIABLE_MINRTO = 50;
+static const unsigned int NET_RELIABLE_MAXRTO = 2000;
+static const unsigned int NET_RELIABLE_INITRTO = 250;
+
+//
+// NetReliableSender
+//
+// Server-side, per-client queue of reliable messages.  Each message is cut
+// into fragments numbered with their own sequence, independent of the packet
+// sequence.  A packet carries retransmissions first and then new fragments,
+// as many as fit in NET_RELIABLE_PACKET and the window allows.
+//
+// The client acknowledges the next fragment it expects plus a mask of the
+// fragments it holds past that one.  An unacknowledged fragment is sent
+// again once the retransmission timeout, estimated from the round trip time
+// of fragments that were only sent once, has passed.  The timeout doubles
+// with every retransmission of the same fragment.
+//
+// On the wire, a fragment is svc_reliable, [short:sequence] [byte:flags]
+// [short:length] and the data.
+//
+class NetReliableSender
+{
+public:
+	NetReliableSender();
+
+	static const byte FRAGMENT_FIRST	= 0x01;	// starts a message
+	static const byte FRAGMENT_LAST		= 0x02;	// ends a message
+
+	void clear();
+
+	void queue(const byte *data, size_t len);
+	bool ready(dtime_t now) const;
+	size_t write(buf_t *buf, size_t budget, dtime_t now);
+	void readAck(buf_t *buf, dtime_t now);
+
+	size_t queued() const { return queuedbytes; }
+	bool overflowed() const { return queuedbytes > NET_RELIABLE_MAXQUEUE; }
+
+private:
+	struct fragment_t
+	{
+		unsigned int		sequence;
+		byte				flags;
+		bool				acked;
+		byte				sends;
+		dtime_t				senttime;
+		std::vector<byte>	data;
+	};
+
+	bool due(const fragment_t &frag, dtime_t now) const;
+	void writeFragment(buf_t *buf, fragment_t &frag, dtime_t now);
+	void sampleRTT(const fragment_t &frag, dtime_t now);
+
+	std::deque<fragment_t>	fragments;	// oldest unacknowledged first
+	unsigned int			sequence;	// of the next new fragment
+	size_t					queuedbytes;
+
+	// round trip time estimate, in milliseconds
+	bool					measured;
+	unsigned int			srtt, rttvar, rto;
+};
+
+//
+// NetReliableReceiver
+//
+// Client-side reassembly of the reliable messages, which are released in
+// the order they were sent no matter how their fragments arrive.
+//
+class NetReliableReceiver
+{
+public:
+	NetReliableReceiver();
+
+	void clear();
+	void resync();
+
+	bool read(buf_t *buf);
+	buf_t &messages() { return complete; }
+
+	bool ackPending() const { return ackpending; }
+	void writeAck(buf_t *buf);
+
+private:
+	struct fragment_t
+	{
+		bool				received;
+		byte				flags;
+		std::vector<byte>	data;
+	};
+
+	void release();
+
+	fragment_t			fragments[NET_RELIABLE_WINDOW];	// by sequence % window
+	unsigned int		sequence;	// of the next fragment to release
+	bool				synced;
+	bool				ackpending;
+	std::vector<byte>	partial;	// released fragments of an unfinished message
+	buf_t				complete;	// finished messages waiting to be parsed
+};
+
+#endif	// __D_NETRELIABLE__
@@ -55,6 +55,8 @@
 
 #include "p_snapshot.h"
 #include "d_netcmd.h"
+#include "d_netdelta.h"
+#include "d_netreliable.h"
 
 //
 // Player states.
@@ -114,6 +116,19 @@ typedef enum
 	CF_REVERTPLEASE		= 128
 } cheat_t;
 
+//
+// Priority classes of the unreliable messages that are held back when a
+// client is over its rate, most important first
+//
+typedef enum
+{
+	NETPRI_PLAYERS,		// other players the client can see
+	NETPRI_ACTORS,		// missiles and monsters
+	NETPRI_COSMETIC,	// sounds
+
+	NUMNETPRIORITIES
+} netpriority_t;
+
 #define MAX_PLAYER_SEE_MOBJ	0x7F
 
 //
@@ -269,7 +284,7 @@ public:
 		short		majorversion;	// GhostlyDeath -- Major
 		short		minorversion;	// GhostlyDeath -- Minor
 
-		// for reliable protocol
+		// for reliable protocol of clients without NETCAP_RELIABLE
 		buf_t       relpackets; // save reliable packets here
 		int         packetbegin[256]; // the beginning of a packet
 		int         packetsize[256]; // the size of a packet
@@ -281,6 +296,30 @@ public:
 		int         rate;
 		int         reliable_bps;	// bytes per second
 		int         unreliable_bps;
+		int			rate_tokens;	// bytes that can be sent without going over rate
+
+		// Unreliable messages that are only sent as rate_tokens allows, one
+		// queue per netpriority_t.  netbuf comes before all of them.
+		struct netmessage_t
+		{
+			size_t	start;		// offset in the queue's buffer
+			int		tic;		// gametic it was written
+			int		delta;		// NetDeltaEncoder state written, or -1
+		};
+
+		struct netqueue_t
+		{
+			netqueue_t() : buf(MAX_UDP_PACKET) {}
+
+			buf_t						buf;
+			std::vector<netmessage_t>	messages;
+
+			void clear()
+			{
+				buf.clear();
+				messages.clear();
+			}
+		} netqueue[NUMNETPRIORITIES];
 
 		int			last_received;	// for timeouts
 
@@ -292,6 +331,17 @@ public:
 
 		huffman_server	compressor;	// denis - adaptive huffman compression
 
+		int				netcaps;	// optional protocol features (netcaps_t)
+		NetDeltaEncoder	delta;		// states sent for delta compression
+		NetReliableSender	reliable;	// reliable messages with NETCAP_RELIABLE
+
+		// the last packet queued by SV_SendPacket, which the network code
+		// reads in place until the send queue is flushed
+		buf_t			sendbuf;	// sequence number and compressed payload
+		buf_t			sendrel;	// reliable segment, swapped with reliablebuf
+		buf_t			sendnet;	// unreliable segment, swapped with netbuf
+		unsigned int	sendflush;	// NET_FlushGeneration when queued, or 0
+
 		class download_t
 		{
 		public:
@@ -321,6 +371,7 @@ public:
 			rate = 0;
 			reliable_bps = 0;
 			unreliable_bps = 0;
+			rate_tokens = 0;
 			last_received = 0;
 			lastcmdtic = 0;
 			lastclientcmdtic = 0;
@@ -333,6 +384,8 @@ public:
 			digest = "";
 			allow_rcon = false;
 			displaydisconnect = true;
+			netcaps = 0;
+			sendflush = 0;
 		/*
 		huffman_server	compressor;	// denis - adaptive huffman compression*/
 		}
@@ -350,6 +403,7 @@ public:
 			rate(other.rate),
 			reliable_bps(other.reliable_bps),
 			unreliable_bps(other.unreliable_bps),
+			rate_tokens(other.rate_tokens),
 			last_received(other.last_received),
 			lastcmdtic(other.lastcmdtic),
 			lastclientcmdtic(other.lastclientcmdtic),
@@ -357,11 +411,33 @@ public:
 			allow_rcon(false),
 			displaydisconnect(true),
 			compressor(other.compressor),
+			netcaps(other.netcaps),
+			delta(other.delta),
+			reliable(other.reliable),
+			sendbuf(other.sendbuf),
+			sendrel(other.sendrel),
+			sendnet(other.sendnet),
+			sendflush(0),
 			download(other.download)
 		{
 				memcpy(packetbegin, other.packetbegin, sizeof(packetbegin));
 				memcpy(packetsize, other.packetsize, sizeof(packetsize));
 				memcpy(packetseq, other.packetseq, sizeof(packetseq));
+
+				for (int i = 0; i < NUMNETPRIORITIES; i++)
+					netqueue[i] = other.netqueue[i];
+		}
+		~client_t()
+		{
+			flushPending();
+		}
+
+		// sends the queued packet now if it still refers to the send buffers
+		void flushPending()
+		{
+			if (sendflush && sendflush == NET_FlushGeneration())
+				NET_FlushPackets();
+			sendflush = 0;
 		}
 	} client;
 
@@ -30,6 +30,7 @@
 #include "doomstat.h"
 #include "dthinker.h"
 #include "z_zone.h"
+#include "z_slab.h"
 #include "stats.h"
 #include "p_local.h"
 
@@ -40,6 +41,61 @@ DThinker *DThinker::LastThinker = NULL;
 
 std::vector<DThinker *> LingerDestroy;
 
+//
+// Thinker class lists
+//
+// One list per class of thinker that has been spawned, each in the order
+// the thinkers were created.  What IndependentThinker needs to know about
+// the class is worked out once when the list is made.
+//
+struct thinkerlist_t
+{
+	thinkerlist_t () : type(NULL), first(NULL), last(NULL), actor(false), mover(false),
+		live(0), peak(0) {}
+
+	TypeInfo	*type;
+	DThinker	*first, *last;
+	bool		actor;	// an AActor
+	bool		mover;	// a sector mover that clients tick in prediction
+
+	size_t		live;	// thinkers in the list
+	size_t		peak;
+};
+
+static std::vector<thinkerlist_t> ThinkerLists;
+static thinkerlist_t PendingThinkers;
+static QWORD NextThinkerSerial = 0;
+
+static thinkerlist_t &GetThinkerList (int index)
+{
+	return index < 0 ? PendingThinkers : ThinkerLists[index];
+}
+
+//
+// FindThinkerList
+//
+// Returns the index of the list of a class, making the list if needed.
+//
+static int FindThinkerList (TypeInfo *type)
+{
+	for (size_t i = 0; i < ThinkerLists.size(); i++)
+		if (ThinkerLists[i].type == type)
+			return i;
+
+	thinkerlist_t list;
+	list.type = type;
+	list.actor = type->IsDescendantOf(RUNTIME_CLASS(AActor));
+	list.mover = type == RUNTIME_CLASS(DPillar) ||
+				 type == RUNTIME_CLASS(DElevator) ||
+				 type == RUNTIME_CLASS(DFloor) ||
+				 type == RUNTIME_CLASS(DCeiling) ||
+				 type == RUNTIME_CLASS(DPlat) ||
+				 type == RUNTIME_CLASS(DDoor);
+
+	ThinkerLists.push_back(list);
+	return ThinkerLists.size() - 1;
+}
+
 void DThinker::Serialize (FArchive &arc)
 {
 	Super::Serialize (arc);
@@ -111,6 +167,20 @@ DThinker::DThinker ()
 	LastThinker = this;
 	refCount = 0;
 	destroyed = false;
+
+	// The class is not known until the constructor is done
+	m_Serial = NextThinkerSerial++;
+	m_ClassList = -1;
+	m_PrevOfClass = PendingThinkers.last;
+	m_NextOfClass = NULL;
+	if (PendingThinkers.last)
+		PendingThinkers.last->m_NextOfClass = this;
+	if (!PendingThinkers.first)
+		PendingThinkers.first = this;
+	PendingThinkers.last = this;
+
+	if (++PendingThinkers.live > PendingThinkers.peak)
+		PendingThinkers.peak = PendingThinkers.live;
 }
 
 DThinker::~DThinker ()
@@ -131,6 +201,7 @@ void DThinker::Destroy ()
 		m_Next->m_Prev = m_Prev;
 	if (m_Prev)
 		m_Prev->m_Next = m_Next;
+	UnlinkFromClass ();
 	
 	destroyed = true;
 		
@@ -160,6 +231,54 @@ bool DThinker::WasDestroyed ()
 	return destroyed;
 }
 
+//
+// DThinker::UnlinkFromClass
+//
+// Takes a thinker out of the list of its class.  Its own links are kept so
+// that an iterator which has just returned it can carry on.
+//
+void DThinker::UnlinkFromClass ()
+{
+	thinkerlist_t &list = GetThinkerList(m_ClassList);
+
+	if (list.first == this)
+		list.first = m_NextOfClass;
+	if (list.last == this)
+		list.last = m_PrevOfClass;
+	if (m_NextOfClass)
+		m_NextOfClass->m_PrevOfClass = m_PrevOfClass;
+	if (m_PrevOfClass)
+		m_PrevOfClass->m_NextOfClass = m_NextOfClass;
+
+	list.live--;
+}
+
+//
+// DThinker::Classify
+//
+// Moves a pending thinker to the end of the list of its class.  Pending
+// thinkers are classified in the order they were created, so every list
+// stays in that order.
+//
+void DThinker::Classify ()
+{
+	UnlinkFromClass ();
+
+	m_ClassList = FindThinkerList(StaticType());
+	thinkerlist_t &list = ThinkerLists[m_ClassList];
+
+	m_PrevOfClass = list.last;
+	m_NextOfClass = NULL;
+	if (list.last)
+		list.last->m_NextOfClass = this;
+	if (!list.first)
+		list.first = this;
+	list.last = this;
+
+	if (++list.live > list.peak)
+		list.peak = list.live;
+}
+
 // Destroy every thinker
 void DThinker::DestroyAllThinkers ()
 {
@@ -210,13 +329,13 @@ void DThinker::DestroyMostThinkers ()
 // Returns true if a DThinker object is ticked independently elsewhere.
 // Returns false if it should be ticked in DThinker::RunThinkers
 //
-bool IndependentThinker(DThinker *thinker)
+static bool IndependentThinker(DThinker *thinker, const thinkerlist_t &list)
 {
 	// Only have independent thinkers in client/server mode
 	if (!multiplayer || demoplayback)
 		return false;
 
-	if (thinker->IsKindOf (RUNTIME_CLASS (AActor)))
+	if (list.actor)
 	{
 		AActor *mobj = static_cast<AActor*>(thinker);
 		if (!mobj->player || mobj->player->spectator)
@@ -231,12 +350,7 @@ bool IndependentThinker(DThinker *thinker)
 			return true;
 	}
 	
-	if (thinker->IsA(RUNTIME_CLASS (DPillar)) ||
-		thinker->IsA(RUNTIME_CLASS (DElevator)) ||
-		thinker->IsA(RUNTIME_CLASS (DFloor)) ||
-		thinker->IsA(RUNTIME_CLASS (DCeiling)) ||
-		thinker->IsA(RUNTIME_CLASS (DPlat)) ||
-		thinker->IsA(RUNTIME_CLASS (DDoor)))
+	if (list.mover)
 	{
 		// Client ticks movable sectors in prediction code
 		if (clientside)
@@ -247,31 +361,175 @@ bool IndependentThinker(DThinker *thinker)
 }
 
 
+//
+// DThinker::PrepareThinkers
+//
+// Hands the actors among the next batch of thinkers to P_PrepareMonsters,
+// which works out what it can for them ahead of time.  Returns the number of
+// thinkers in the batch.
+//
+static const size_t PREPARE_BATCH = 1024;
+
+size_t DThinker::PrepareThinkers(DThinker *first)
+{
+	static std::vector<AActor *> actors;
+	actors.clear();
+
+	size_t count = 0;
+	for (DThinker *thinker = first; thinker && count < PREPARE_BATCH; thinker = thinker->m_Next, count++)
+	{
+		if (thinker->m_ClassList < 0)
+			thinker->Classify ();
+
+		if (ThinkerLists[thinker->m_ClassList].actor && !thinker->destroyed)
+			actors.push_back(static_cast<AActor *>(thinker));
+	}
+
+	P_PrepareMonsters(actors);
+	return count;
+}
+
+//
+// DThinker::RunThinkers
+//
+// Pending thinkers are classified as they are reached.  Their constructors
+// have all finished by then, including those of thinkers spawned by one
+// that ran earlier in the same tic.
+//
 void DThinker::RunThinkers ()
 {
 	DThinker *currentthinker;
+	bool prepare = P_CanPrepareMonsters();
+	size_t unprepared = 0;
 
 	BEGIN_STAT (ThinkCycles);
 	currentthinker = FirstThinker;
 	while (currentthinker)
 	{
-		if (!IndependentThinker(currentthinker))
+		if (prepare && unprepared == 0)
+			unprepared = PrepareThinkers(currentthinker);
+		if (unprepared)
+			unprepared--;
+
+		if (currentthinker->m_ClassList < 0)
+			currentthinker->Classify ();
+
+		if (!IndependentThinker(currentthinker, ThinkerLists[currentthinker->m_ClassList]))
 			currentthinker->RunThink();
 		currentthinker = currentthinker->m_Next;
 	}
 	END_STAT (ThinkCycles);
 }
 
+FThinkerIterator::FThinkerIterator (TypeInfo *type)
+{
+	m_ParentType = type;
+	m_WalkAll = false;
+	m_NumLists = 0;
+
+	for (size_t i = 0; i < ThinkerLists.size(); i++)
+	{
+		if (!ThinkerLists[i].type->IsDescendantOf(type))
+			continue;
+
+		if (m_NumLists == MAX_LISTS)
+		{
+			m_WalkAll = true;
+			break;
+		}
+
+		m_Lists[m_NumLists++] = i;
+	}
+
+	m_Lists[m_NumLists++] = -1;
+
+	Reset ();
+}
+
+void FThinkerIterator::Reset ()
+{
+	m_CurrThinker = DThinker::FirstThinker;
+
+	for (size_t i = 0; i < m_NumLists; i++)
+		m_Curr[i] = GetThinkerList(m_Lists[i]).first;
+}
+
+DThinker *FThinkerIterator::Next ()
+{
+	if (m_WalkAll)
+	{
+		while (m_CurrThinker)
+		{
+			if (m_CurrThinker->IsKindOf (m_ParentType))
+			{
+				DThinker *res = m_CurrThinker;
+				m_CurrThinker = m_CurrThinker->m_Next;
+				return res;
+			}
+			m_CurrThinker = m_CurrThinker->m_Next;
+		}
+		Reset ();
+		return NULL;
+	}
+
+	while (true)
+	{
+		// the list whose next thinker was created first
+		size_t best = m_NumLists;
+		for (size_t i = 0; i < m_NumLists; i++)
+		{
+			if (m_Curr[i] && (best == m_NumLists ||
+				m_Curr[i]->m_Serial < m_Curr[best]->m_Serial))
+				best = i;
+		}
+
+		if (best == m_NumLists)
+		{
+			Reset ();
+			return NULL;
+		}
+
+		DThinker *res = m_Curr[best];
+		m_Curr[best] = res->m_NextOfClass;
+
+		// the pending list holds thinkers of any class
+		if (m_Lists[best] < 0 && !res->IsKindOf (m_ParentType))
+			continue;
+
+		return res;
+	}
+}
+
+//
+// DThinker::DumpClassStats
+//
+// Prints the number of thinkers of each class in the world, for dumpheap.
+//
+void DThinker::DumpClassStats ()
+{
+	for (size_t i = 0; i < ThinkerLists.size(); i++)
+	{
+		const thinkerlist_t &list = ThinkerLists[i];
+		Printf (PRINT_HIGH, "class:%-20s    live:%6u    peak:%6u\n",
+				list.type->Name, (unsigned int)list.live, (unsigned int)list.peak);
+	}
+
+	Printf (PRINT_HIGH, "class:%-20s    live:%6u    peak:%6u\n",
+			"(pending)", (unsigned int)PendingThinkers.live,
+			(unsigned int)PendingThinkers.peak);
+}
+
+// Thinkers come from the slabs, see z_slab.h
 void *DThinker::operator new (size_t size)
 {
-	return Z_Malloc (size, PU_LEVSPEC, 0);
+	return Z_SlabAlloc (size);
 }
 
 // Deallocation is lazy -- it will not actually be freed
 // until its thinking turn comes up.
-void DThinker::operator delete (void *mem)
+void DThinker::operator delete (void *mem, size_t size)
 {
-	Z_Free (mem);
+	Z_SlabFree (mem, size);
 }
 
 VERSION_CONTROL (dthinker_cpp, "$Id$")
@@ -53,6 +53,11 @@ typedef actionf_t  think_t;
 class FThinkerIterator;
 
 // Doubly linked list of thinkers
+//
+// Every thinker is also in a list of the thinkers of its own class, which
+// FThinkerIterator walks instead of the whole thinker list.  A thinker's
+// class is not known until its constructor has finished, so new thinkers
+// wait in a pending list until DThinker::RunThinkers comes across them.
 class DThinker : public DObject
 {
 	DECLARE_SERIAL (DThinker, DObject)
@@ -64,7 +69,7 @@ public:
 	virtual void RunThink () {}
 
 	void *operator new (size_t size);
-	void operator delete (void *block);
+	void operator delete (void *block, size_t size);
 
 	// Both the head and tail of the thinker list.
 	static DThinker *FirstThinker;
@@ -73,45 +78,54 @@ public:
 	static void DestroyAllThinkers ();
 	static void DestroyMostThinkers ();
 	static void SerializeAll (FArchive &arc, bool keepPlayers, bool noStorePlayers);
+	static void DumpClassStats ();
 
 	bool WasDestroyed();
 
 	size_t refCount;
 
 private:
+	void Classify ();
+	void UnlinkFromClass ();
+	static size_t PrepareThinkers (DThinker *first);
+
 	DThinker *m_Next, *m_Prev;
+	DThinker *m_NextOfClass, *m_PrevOfClass;
+	QWORD m_Serial;		// creation order, the same as the thinker list's
+	int m_ClassList;	// index of the list of its class, -1 while pending
 	bool destroyed;
 
 	friend class FThinkerIterator;
 };
 
+//
+// FThinkerIterator
+//
+// Returns the thinkers of a class and its subclasses in the order of the
+// thinker list, by merging the lists of the matching classes.  If too many
+// classes match, such as for DThinker itself, the whole thinker list is
+// walked instead.  Once every thinker has been returned, Next returns NULL
+// and starts over.
+//
 class FThinkerIterator
 {
 private:
+	static const size_t MAX_LISTS = 8;
+
+	void Reset ();
+
 	TypeInfo *m_ParentType;
+	bool m_WalkAll;
 	DThinker *m_CurrThinker;
 
+	// the merged lists, with the pending list last
+	size_t m_NumLists;
+	int m_Lists[MAX_LISTS + 1];
+	DThinker *m_Curr[MAX_LISTS + 1];
+
 public:
-	FThinkerIterator (TypeInfo *type)
-	{
-		m_ParentType = type;
-		m_CurrThinker = DThinker::FirstThinker;
-	}
-	DThinker *Next ()
-	{
-		while (m_CurrThinker)
-		{
-			if (m_CurrThinker->IsKindOf (m_ParentType))
-			{
-				DThinker *res = m_CurrThinker;
-				m_CurrThinker = m_CurrThinker->m_Next;
-				return res;
-			}
-			m_CurrThinker = m_CurrThinker->m_Next;
-		}
-		m_CurrThinker = DThinker::FirstThinker;
-		return NULL;
-	}
+	FThinkerIterator (TypeInfo *type);
+	DThinker *Next ();
 };
 
 template <class T> class TThinkerIterator : public FThinkerIterator
@@ -54,6 +54,10 @@ void G_PlayDemo(char* name);
 void G_DoPlayDemo(bool justStreamInput = false);
 void G_TimeDemo(const char* name);
 void G_TestDemo(const char* name);
+void G_TimeNetDemo(const std::string& filename);
+void G_BeginTimeDemoFrame(void);
+void G_EndTimeDemoFrame(void);
+void G_FinishTimeDemo(const std::string& demoname);
 BOOL G_CheckDemoStatus(void);
 void G_CleanupDemo();
 
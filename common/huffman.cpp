@@ -337,10 +337,9 @@ huffman::huff_encodenode_t *huffman::_Huffman_MakeTree( huff_sym_t *sym, huff_en
 * The function returns the size of the compressed data.
 *************************************************************************/
 
-bool huffman::Huffman_Compress_Using_Histogram( unsigned char *in, size_t insize, unsigned char *out, size_t &outsize, huff_sym_t *sym )
+bool huffman::Huffman_Compress_Using_Histogram( const unsigned char *in, size_t insize, unsigned char *out, size_t &outsize, huff_sym_t *sym )
 {
   huff_sym_t       tmp;
-  huff_bitstream_t stream;
   unsigned int     k, swaps, symbol;
 
   /* Do we have anything to compress? */
@@ -350,9 +349,6 @@ bool huffman::Huffman_Compress_Using_Histogram( unsigned char *in, size_t insize
 	  return true;
   }
 
-  /* Initialize bitstream */
-  _Huffman_InitBitstream( &stream, out );
-
   /* Sort histogram - first symbol first (bubble sort) */
   do
   {
@@ -372,38 +368,51 @@ bool huffman::Huffman_Compress_Using_Histogram( unsigned char *in, size_t insize
 
   // Init useful pointer for bounds check
   unsigned char *out_end = out + outsize;
+  unsigned char *buf = out;
+
+  // Collect the codes in an accumulator and flush whole bytes instead
+  // of going through _Huffman_WriteBits one bit at a time
+  unsigned long long acc = 0;
+  unsigned int       acc_bits = 0;
 
   /* Encode input stream */
   for( k = 0; k < insize; ++ k )
   {
-    if(stream.BytePtr + 17 >= out_end) // denis - todo - security, 17 masks potential terminator overflow, should really be a 1
+    if(buf + 5 >= out_end)
 	    return false;
 
 	symbol = in[k];
-    
-    _Huffman_WriteBits( &stream, sym[symbol].Code, sym[symbol].Bits );
+
+    acc = (acc << sym[symbol].Bits) | sym[symbol].Code;
+    acc_bits += sym[symbol].Bits;
+
+    while( acc_bits >= 8 )
+    {
+      acc_bits -= 8;
+      *buf ++ = (unsigned char)(acc >> acc_bits);
+    }
   }
 
-  /* Calculate size of output data */
-  outsize = (int)(stream.BytePtr - out);
-  
-  if( stream.BitPos > 0 )
+  if( acc_bits > 0 )
   {
-	  unsigned int left = 8 - stream.BitPos;
-	  
-	  // Write a terminator that will throw decompressor off the tree
+	  unsigned int left = 8 - acc_bits;
+
+	  // Pad with the start of a code that is too long to finish within the
+	  // last byte, which will throw the decompressor off the tree
 	  for( k = 0; k < 256; ++ k )
 	  {
 		  if( sym[k].Bits > left )
 		  {
-			  _Huffman_WriteBits( &stream, sym[k].Code, sym[k].Bits );
+			  unsigned int pad = sym[k].Code >> (sym[k].Bits - left);
+			  *buf ++ = (unsigned char)((acc << left) | pad);
 			  break;
 		  }
 	  }
-	  
-	  outsize++;
   }
 
+  /* Calculate size of output data */
+  outsize = (int)(buf - out);
+
   return true;
 }
 
@@ -459,13 +468,13 @@ bool huffman::Huffman_Uncompress_Using_Tree( unsigned char *in, size_t insize, u
 			  node = node->ChildA;
 	  }
 	  
-	  // End of input
-	  if(stream.BytePtr >= in_end && node->Symbol < 0)
-		break;
-
 	  // Prematurely fell off the tree, nein! halt!
 	  if(!node)
 		  return false;
+
+	  // End of input
+	  if(stream.BytePtr >= in_end && node->Symbol < 0)
+		break;
 	  
 	  /* We found the matching leaf node and have the symbol */
 	  *buf ++ = (unsigned char) node->Symbol;
@@ -504,7 +513,7 @@ void huffman::extend( unsigned char *data, size_t insize)
 }
 
 // Compress a chunk of data using only previously generated stats
-bool huffman::compress( unsigned char *in_data, size_t in_len, unsigned char *out_data, size_t &out_len)
+bool huffman::compress( const unsigned char *in_data, size_t in_len, unsigned char *out_data, size_t &out_len)
 {
 	if(fresh_histogram)
 	{
@@ -81,7 +81,7 @@ class huffman
 	huff_encodenode_t *_Huffman_MakeTree( huff_sym_t *sym, huff_encodenode_t *nodes);
 	void _Huffman_StoreTree( huff_encodenode_t *node, huff_sym_t *sym, unsigned int code, unsigned int bits );
 
-	bool Huffman_Compress_Using_Histogram( unsigned char *in, size_t insize, unsigned char *out, size_t &outsize, huff_sym_t *sym );
+	bool Huffman_Compress_Using_Histogram( const unsigned char *in, size_t insize, unsigned char *out, size_t &outsize, huff_sym_t *sym );
 	bool Huffman_Uncompress_Using_Tree( unsigned char *in, size_t insize, unsigned char *out, size_t &outsize, huff_encodenode_t *tree_root );
 
 public:
@@ -93,7 +93,7 @@ public:
 	void extend( unsigned char *data, size_t len);
 
 	// Compress a chunk of data using only previously generated stats
-	bool compress( unsigned char *in_data, size_t in_len, unsigned char *out_data, size_t &out_len);
+	bool compress( const unsigned char *in_data, size_t in_len, unsigned char *out_data, size_t &out_len);
 
 	// Decompress a chunk of data using only previously generated stats
 	bool decompress( unsigned char *in_data, size_t in_len, unsigned char *out_data, size_t &out_len);
@@ -34,6 +34,7 @@
 #include <stdarg.h>
 
 #include <sstream>
+#include <algorithm>
 
 /* [Petteri] Use Winsock for Win32: */
 #include "win32inc.h"
@@ -58,6 +59,12 @@
 #	include <sys/time.h>
 #endif // WIN32
 
+// recvmmsg/sendmmsg let the server move a whole tic's worth of
+// datagrams through the kernel with a single syscall
+#if defined(__linux__) && !defined(GEKKO)
+#define ODA_HAVE_MMSG
+#endif
+
 #ifndef _WIN32
 typedef int SOCKET;
 #ifndef GEKKO
@@ -82,6 +89,8 @@ typedef int SOCKET;
 #include "d_player.h"
 #include "g_game.h"
 #include "i_net.h"
+#include "i_thread.h"
+#include "stats.h"
 
 #ifdef _XBOX
 #include "i_xbox.h"
@@ -109,11 +118,81 @@ netadr_t    	net_from;   // address of who sent the packet
 buf_t       net_message(MAX_UDP_PACKET);
 extern bool	simulated_connection;
 
-// buffer for compression/decompression
+net_syscall_stats_t net_syscalls;
+
+// batched datagram I/O, see NET_SetBatchIO
+static bool		net_batchio = false;
+
+// buffer for decompression
 // can't be static to a function because some
 // of the functions
-buf_t compressed, decompressed;
-lzo_byte wrkmem[LZO1X_1_MEM_COMPRESS];
+buf_t decompressed;
+
+// minilzo compression dictionary, one per thread that compresses packets
+// since the packets may be built in parallel (see I_RunParallel).  A worker
+// thread's dictionary is not freed when the thread is stopped.
+static THREAD_LOCAL lzo_byte *wrkmem = NULL;
+
+// serializes the send queue while packets are built in parallel
+static I_Mutex net_sendmutex;
+
+class net_sendlock_t
+{
+public:
+	net_sendlock_t() : locked(I_InParallel())
+	{
+		if (locked)
+			net_sendmutex.lock();
+	}
+	~net_sendlock_t()
+	{
+		if (locked)
+			net_sendmutex.unlock();
+	}
+
+private:
+	bool	locked;
+};
+
+// Printf is not safe to call from a worker thread, so send errors on one are
+// kept here and reported by NET_FlushPackets on the main thread
+static I_Mutex net_errormutex;
+static int net_senderror;					// errno of the first error kept
+static unsigned int net_senderrors;			// errors kept since the report
+
+//
+// NET_SendError
+//
+static void NET_SendError (int err)
+{
+	if (I_InParallel())
+	{
+		I_MutexLock lock(net_errormutex);
+
+		if (net_senderrors++ == 0)
+			net_senderror = err;
+		return;
+	}
+
+	Printf (PRINT_HIGH, "NET_SendPacket: %s\n", strerror(err));
+}
+
+//
+// NET_ReportSendErrors
+//
+static void NET_ReportSendErrors (void)
+{
+	if (net_senderrors == 0 || I_InParallel())
+		return;
+
+	if (net_senderrors == 1)
+		Printf (PRINT_HIGH, "NET_SendPacket: %s\n", strerror(net_senderror));
+	else
+		Printf (PRINT_HIGH, "NET_SendPacket: %s (and %u more errors)\n",
+				strerror(net_senderror), net_senderrors - 1);
+
+	net_senderrors = 0;
+}
 
 EXTERN_CVAR(port)
 
@@ -351,6 +430,8 @@ void BindToLocalPort (SOCKET s, u_short wanted)
 
 void CloseNetwork (void)
 {
+	NET_FlushPackets();
+
 #ifdef ODA_HAVE_MINIUPNP
     upnp_rem_redir (port);
 #endif
@@ -434,7 +515,7 @@ bool NET_CompareAdr (netadr_t a, netadr_t b)
 typedef int socklen_t;
 #endif
 
-int NET_GetPacket (void)
+static int NET_GetSinglePacket (void)
 {
     int                  ret;
     struct sockaddr_in   from;
@@ -442,6 +523,7 @@ int NET_GetPacket (void)
 
     fromlen = sizeof(from);
 	net_message.clear();
+	net_syscalls.recv_calls++;
     ret = recvfrom (inet_socket, (char *)net_message.ptr(), net_message.maxsize(), 0, (struct sockaddr *)&from, &fromlen);
 
     if (ret == -1)
@@ -476,10 +558,420 @@ int NET_GetPacket (void)
     }
     net_message.setcursize(ret);
     SockadrToNetadr (&from, &net_from);
+	net_syscalls.recv_packets++;
 
     return ret;
 }
 
+#ifdef ODA_HAVE_MMSG
+//
+// Batched datagram I/O
+//
+// Incoming datagrams are drained from the socket into a ring of buf_t
+// slots with a single recvmmsg call and then handed out one at a time by
+// NET_GetPacket.  Outgoing packets queued with NET_QueuePacket are held until
+// NET_FlushPackets pushes them all to the kernel with a single sendmmsg.
+// Packets queued with NET_QueuePacketv are not copied into the ring at all;
+// their segments are handed to the kernel straight from the caller's memory.
+//
+#define NET_BATCH_SIZE 64
+
+struct net_batch_t
+{
+	buf_t				slots[NET_BATCH_SIZE];
+	netadr_t			addrs[NET_BATCH_SIZE];
+	struct sockaddr_in	sockaddrs[NET_BATCH_SIZE];
+	struct iovec		iovecs[NET_BATCH_SIZE * NET_MAX_IOVECS];
+	struct mmsghdr		headers[NET_BATCH_SIZE];
+	size_t				head, count;
+
+	net_batch_t() : head(0), count(0)
+	{
+		for (size_t i = 0; i < NET_BATCH_SIZE; i++)
+			slots[i].resize(MAX_UDP_PACKET);
+	}
+};
+
+static net_batch_t *recv_batch = NULL;
+static net_batch_t *send_batch = NULL;
+
+//
+// NET_FillRecvBatch
+//
+// Reads as many pending datagrams as will fit in the receive ring.
+// Returns the number of datagrams read.
+//
+static size_t NET_FillRecvBatch (void)
+{
+	net_batch_t *b = recv_batch;
+	b->head = b->count = 0;
+
+	memset(b->headers, 0, sizeof(b->headers));
+	for (size_t i = 0; i < NET_BATCH_SIZE; i++)
+	{
+		b->iovecs[i].iov_base = b->slots[i].ptr();
+		b->iovecs[i].iov_len = b->slots[i].maxsize();
+		b->headers[i].msg_hdr.msg_name = &b->sockaddrs[i];
+		b->headers[i].msg_hdr.msg_namelen = sizeof(b->sockaddrs[i]);
+		b->headers[i].msg_hdr.msg_iov = &b->iovecs[i];
+		b->headers[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	net_syscalls.recv_calls++;
+	int ret = recvmmsg(inet_socket, b->headers, NET_BATCH_SIZE, 0, NULL);
+
+	if (ret == -1)
+	{
+		if (errno != EWOULDBLOCK && errno != ECONNREFUSED)
+			Printf (PRINT_HIGH, "NET_GetPacket: %s\n", strerror(errno));
+		return 0;
+	}
+
+	for (int i = 0; i < ret; i++)
+	{
+		b->slots[i].clear();
+		b->slots[i].setcursize(b->headers[i].msg_len);
+		SockadrToNetadr(&b->sockaddrs[i], &b->addrs[i]);
+	}
+
+	b->count = ret;
+	return b->count;
+}
+
+//
+// NET_GetBatchedPacket
+//
+// Hands the next datagram in the receive ring to net_message, refilling
+// the ring from the socket when it runs dry.  The slot's storage is
+// swapped with net_message rather than copied.
+//
+static int NET_GetBatchedPacket (void)
+{
+	net_batch_t *b = recv_batch;
+
+	while (true)
+	{
+		if (b->head >= b->count)
+		{
+			// batching was switched off with datagrams still in the ring
+			if (!net_batchio)
+				return NET_GetSinglePacket();
+
+			if (NET_FillRecvBatch() == 0)
+				return 0;
+		}
+
+		buf_t &slot = b->slots[b->head];
+		net_from = b->addrs[b->head];
+		b->head++;
+
+		// skip empty datagrams instead of ending the read loop early
+		if (slot.size() == 0)
+			continue;
+
+		net_message.clear();
+		std::swap(net_message.data, slot.data);
+		std::swap(net_message.allocsize, slot.allocsize);
+		net_message.setcursize(slot.size());
+		slot.clear();
+
+		net_syscalls.recv_packets++;
+		return net_message.size();
+	}
+}
+#endif	// ODA_HAVE_MMSG
+
+//
+// NET_SetBatchIO
+//
+// Switches between the batched recvmmsg/sendmmsg path and the per-packet
+// recvfrom/sendto path.  Batching is silently unavailable on platforms that
+// lack the syscalls.
+//
+void NET_SetBatchIO (bool enable)
+{
+#ifdef ODA_HAVE_MMSG
+	if (!enable && send_batch)
+		NET_FlushPackets();
+
+	if (enable && !recv_batch)
+	{
+		recv_batch = new net_batch_t;
+		send_batch = new net_batch_t;
+	}
+
+	net_batchio = enable;
+#else
+	net_batchio = false;
+#endif
+}
+
+bool NET_BatchIOEnabled (void)
+{
+	return net_batchio;
+}
+
+// counts NET_FlushPackets calls, see NET_QueuePacketv
+static unsigned int net_flushgen = 1;
+
+//
+// NET_FlushSendQueue
+//
+// NET_FlushPackets without taking the send lock, for callers holding it.
+//
+static void NET_FlushSendQueue (void)
+{
+	// segments queued before this point are free to be reused
+	if (++net_flushgen == 0)
+		net_flushgen = 1;
+
+#ifdef ODA_HAVE_MMSG
+	net_batch_t *b = send_batch;
+	if (!b || b->count == 0)
+		return;
+
+	// sendmmsg may stop short of the full batch, so keep going until every
+	// packet has been handed to the kernel or dropped
+	size_t sent = 0;
+	while (sent < b->count)
+	{
+		net_syscalls.send_calls++;
+		int ret = sendmmsg(inet_socket, b->headers + sent, b->count - sent, 0);
+
+		if (ret == -1)
+		{
+			// wouldblock is silent, and the remaining packets are dropped
+			// just as sendto would have dropped them
+			if (errno == EWOULDBLOCK)
+				break;
+
+			if (errno != ECONNREFUSED)
+				NET_SendError(errno);
+
+			// skip the packet that failed
+			sent++;
+			continue;
+		}
+
+		net_syscalls.send_packets += ret;
+		sent += ret;
+	}
+
+	b->count = 0;
+#endif
+}
+
+#ifdef ODA_HAVE_MMSG
+//
+// NET_BeginBatchedPacket
+//
+// Claims the next message header in the send ring, flushing the ring first
+// if it is full.  Returns the index of the claimed entry.
+//
+static size_t NET_BeginBatchedPacket (netadr_t &to)
+{
+	if (send_batch->count >= NET_BATCH_SIZE)
+		NET_FlushSendQueue();
+
+	size_t n = send_batch->count++;
+	struct msghdr &hdr = send_batch->headers[n].msg_hdr;
+
+	memset(&send_batch->headers[n], 0, sizeof(struct mmsghdr));
+	NetadrToSockadr(&to, &send_batch->sockaddrs[n]);
+	hdr.msg_name = &send_batch->sockaddrs[n];
+	hdr.msg_namelen = sizeof(send_batch->sockaddrs[n]);
+	hdr.msg_iov = &send_batch->iovecs[n * NET_MAX_IOVECS];
+	hdr.msg_iovlen = 0;
+
+	return n;
+}
+#endif
+
+//
+// NET_QueuePacket
+//
+// Queues a packet to be sent by the next NET_FlushPackets call, or sends it
+// immediately if batched I/O is disabled.  Clears buf like NET_SendPacket.
+//
+void NET_QueuePacket (buf_t &buf, netadr_t &to)
+{
+	net_sendlock_t lock;
+
+#ifdef ODA_HAVE_MMSG
+	if (net_batchio && !simulated_connection && buf.size() <= MAX_UDP_PACKET)
+	{
+		size_t n = NET_BeginBatchedPacket(to);
+		buf_t &slot = send_batch->slots[n];
+
+		slot.clear();
+		memcpy(slot.ptr(), buf.ptr(), buf.size());
+		slot.setcursize(buf.size());
+
+		send_batch->iovecs[n * NET_MAX_IOVECS].iov_base = slot.ptr();
+		send_batch->iovecs[n * NET_MAX_IOVECS].iov_len = slot.size();
+		send_batch->headers[n].msg_hdr.msg_iovlen = 1;
+
+		buf.clear();
+		return;
+	}
+#endif
+
+	NET_SendPacket(buf, to);
+}
+
+//
+// NET_SendPacketv
+//
+// Sends a datagram gathered from several segments immediately.
+//
+static void NET_SendPacketv (const net_iovec_t *iov, size_t count, netadr_t &to)
+{
+	struct sockaddr_in addr;
+	int ret;
+
+	NetadrToSockadr (&to, &addr);
+
+	net_syscalls.send_calls++;
+	net_syscalls.send_packets++;
+
+#if defined(_WIN32)
+	WSABUF wsabufs[NET_MAX_IOVECS];
+	for (size_t i = 0; i < count; i++)
+	{
+		wsabufs[i].buf = (char *)iov[i].data;
+		wsabufs[i].len = (u_long)iov[i].len;
+	}
+
+	DWORD bytes;
+	ret = WSASendTo(inet_socket, wsabufs, (DWORD)count, &bytes, 0,
+					(struct sockaddr *)&addr, sizeof(addr), NULL, NULL);
+#elif !defined(GEKKO)
+	struct iovec iovecs[NET_MAX_IOVECS];
+	for (size_t i = 0; i < count; i++)
+	{
+		iovecs[i].iov_base = (void *)iov[i].data;
+		iovecs[i].iov_len = iov[i].len;
+	}
+
+	struct msghdr hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.msg_name = &addr;
+	hdr.msg_namelen = sizeof(addr);
+	hdr.msg_iov = iovecs;
+	hdr.msg_iovlen = count;
+
+	ret = sendmsg(inet_socket, &hdr, 0);
+#else
+	// no gathering send, so assemble the datagram on the stack
+	byte packet[MAX_UDP_PACKET];
+	size_t len = 0;
+	for (size_t i = 0; i < count && len + iov[i].len <= sizeof(packet); i++)
+	{
+		memcpy(packet + len, iov[i].data, iov[i].len);
+		len += iov[i].len;
+	}
+
+	ret = sendto(inet_socket, (const char *)packet, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+#endif
+
+	if (ret == -1)
+	{
+#ifdef _WIN32
+		int err = WSAGetLastError();
+		if (err == WSAEWOULDBLOCK || err == WSAECONNRESET)
+			return;
+		NET_SendError(err);
+#else
+		if (errno == EWOULDBLOCK || errno == ECONNREFUSED)
+			return;
+		NET_SendError(errno);
+#endif
+	}
+}
+
+//
+// NET_QueuePacketv
+//
+// Queues a datagram made up of up to NET_MAX_IOVECS segments, or sends it
+// immediately if batched I/O is disabled.  The segments are not copied, so
+// their memory must be left alone until NET_FlushGeneration no longer
+// returns the value it returned when the packet was queued.
+//
+void NET_QueuePacketv (const net_iovec_t *iov, size_t count, netadr_t &to)
+{
+	// nothing is really connected while a netdemo is being played back
+	if (simulated_connection || count == 0)
+		return;
+
+	if (count > NET_MAX_IOVECS)
+		count = NET_MAX_IOVECS;
+
+	net_sendlock_t lock;
+
+#ifdef ODA_HAVE_MMSG
+	if (net_batchio)
+	{
+		size_t n = NET_BeginBatchedPacket(to);
+		struct iovec *iovecs = &send_batch->iovecs[n * NET_MAX_IOVECS];
+		size_t used = 0;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			if (iov[i].len == 0)
+				continue;
+
+			iovecs[used].iov_base = (void *)iov[i].data;
+			iovecs[used].iov_len = iov[i].len;
+			used++;
+		}
+
+		send_batch->headers[n].msg_hdr.msg_iovlen = used;
+		return;
+	}
+#endif
+
+	NET_SendPacketv(iov, count, to);
+}
+
+//
+// NET_FlushPackets
+//
+// Sends every packet queued by NET_QueuePacket and NET_QueuePacketv, and
+// prints the send errors that happened on worker threads.
+//
+void NET_FlushPackets (void)
+{
+	PROFILE_SCOPE(NET_FlushPackets);
+
+	net_sendlock_t lock;
+	NET_FlushSendQueue();
+	NET_ReportSendErrors();
+}
+
+//
+// NET_FlushGeneration
+//
+// Changes every time NET_FlushPackets is called.  Callers of
+// NET_QueuePacketv compare it against the value saved when they queued a
+// packet to find out whether that packet's memory is still in use.
+//
+unsigned int NET_FlushGeneration (void)
+{
+	net_sendlock_t lock;
+	return net_flushgen;
+}
+
+int NET_GetPacket (void)
+{
+#ifdef ODA_HAVE_MMSG
+	// don't lose datagrams already read into the receive ring
+	if (net_batchio || (recv_batch && recv_batch->head < recv_batch->count))
+		return NET_GetBatchedPacket();
+#endif
+
+	return NET_GetSinglePacket();
+}
+
 void NET_SendPacket (buf_t &buf, netadr_t &to)
 {
     int                   ret;
@@ -495,6 +987,8 @@ void NET_SendPacket (buf_t &buf, netadr_t &to)
 
     NetadrToSockadr (&to, &addr);
 
+	net_syscalls.send_calls++;
+	net_syscalls.send_packets++;
 	ret = sendto (inet_socket, (const char *)buf.ptr(), buf.size(), 0, (struct sockaddr *)&addr, sizeof(addr));
 
 	buf.clear();
@@ -507,12 +1001,15 @@ void NET_SendPacket (buf_t &buf, netadr_t &to)
           // wouldblock is silent
           if (err == WSAEWOULDBLOCK)
               return;
+          if (err == WSAECONNRESET)
+              return;
+          NET_SendError(err);
 #else
           if (errno == EWOULDBLOCK)
               return;
           if (errno == ECONNREFUSED)
               return;
-          Printf (PRINT_HIGH, "NET_SendPacket: %s\n", strerror(errno));
+          NET_SendError(errno);
 #endif
     }
 }
@@ -740,9 +1237,6 @@ size_t MSG_SetOffset (const size_t &offset, const buf_t::seek_loc_t &loc)
 // Output buffer size for LZO compression, extra space in case uncompressable
 #define OUT_LEN(a)      ((a) + (a) / 16 + 64 + 3)
 
-// size above which packets get compressed (empirical), does not apply to adaptive compression
-#define MINILZO_COMPRESS_MINPACKETSIZE	0xFF
-
 //
 // MSG_DecompressMinilzo
 //
@@ -772,42 +1266,49 @@ bool MSG_DecompressMinilzo ()
 	return true;
 }
 
+//
+// MSG_EnsureSpace
+//
+// Grows out, keeping its contents, so that len more bytes fit after them.
+//
+static void MSG_EnsureSpace (buf_t &out, size_t len)
+{
+	if (out.maxsize() - out.size() < len)
+		out.resize(out.size() + len, false);
+}
+
 //
 // MSG_CompressMinilzo
 //
-bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap)
+// Appends the compressed form of data to out.  Returns false, leaving out
+// as it was, if the data is too small to bother or would not shrink.
+//
+bool MSG_CompressMinilzo (const byte *data, size_t len, buf_t &out)
 {
-	if(buf.size() < MINILZO_COMPRESS_MINPACKETSIZE)
+	if(len < MINILZO_COMPRESS_MINPACKETSIZE)
 		return false;
 
-	lzo_uint outlen = OUT_LEN(buf.maxsize() - start_offset - write_gap);
-	size_t total_len = outlen + start_offset + write_gap;
+	lzo_uint outlen = OUT_LEN(len);
+	MSG_EnsureSpace(out, outlen);
 
-	if(compressed.maxsize() < total_len)
-		compressed.resize(total_len);
+	if (!wrkmem)
+		wrkmem = new lzo_byte[LZO1X_1_MEM_COMPRESS];
 
-	int r = lzo1x_1_compress (buf.ptr() + start_offset,
-							  buf.size() - start_offset,
-							  compressed.ptr() + start_offset + write_gap,
-							  &outlen,
-							  wrkmem);
+	int r = lzo1x_1_compress (data, len, out.ptr() + out.size(), &outlen, wrkmem);
 
 	// worth the effort?
-	if(r != LZO_E_OK || outlen >= (buf.size() - start_offset - write_gap))
+	if(r != LZO_E_OK || outlen >= len)
 		return false;
 
-	memcpy(compressed.ptr(), buf.ptr(), start_offset);
-
-	SZ_Clear(&buf);
-	MSG_WriteChunk(&buf, compressed.ptr(), outlen + start_offset + write_gap);
+	out.setcursize(out.size() + outlen);
 
 	return true;
 }
 
 //
-// MSG_DecompressAdaptive
+// MSG_DecompressHuffman
 //
-bool MSG_DecompressAdaptive (huffman &huff)
+bool MSG_DecompressHuffman (huffman &huff)
 {
 	// decompress back onto the receive buffer
 	size_t left = MSG_BytesLeft();
@@ -831,29 +1332,23 @@ bool MSG_DecompressAdaptive (huffman &huff)
 }
 
 //
-// MSG_CompressAdaptive
+// MSG_CompressHuffman
 //
-bool MSG_CompressAdaptive (huffman &huff, buf_t &buf, size_t start_offset, size_t write_gap)
+// Appends the compressed form of data to out.  Returns false, leaving out
+// as it was, if the data would not shrink.
+//
+bool MSG_CompressHuffman (huffman &huff, const byte *data, size_t len, buf_t &out)
 {
-	size_t outlen = OUT_LEN(buf.maxsize() - start_offset - write_gap);
-	size_t total_len = outlen + start_offset + write_gap;
-
-	if(compressed.maxsize() < total_len)
-		compressed.resize(total_len);
+	size_t outlen = OUT_LEN(len);
+	MSG_EnsureSpace(out, outlen);
 
-	bool r = huff.compress (buf.ptr() + start_offset,
-							  buf.size() - start_offset,
-							  compressed.ptr() + start_offset + write_gap,
-							  outlen);
+	bool r = huff.compress (data, len, out.ptr() + out.size(), outlen);
 
 	// worth the effort?
-	if(!r || outlen >= (buf.size() - start_offset - write_gap))
+	if(!r || outlen >= len)
 		return false;
 
-	memcpy(compressed.ptr(), buf.ptr(), start_offset);
-
-	SZ_Clear(&buf);
-	MSG_WriteChunk(&buf, compressed.ptr(), outlen + start_offset + write_gap);
+	out.setcursize(out.size() + outlen);
 
 	return true;
 }
@@ -943,7 +1438,8 @@ void InitNetMessageFormats()
       MSG(clc_launcher_challenge, "x"),
       MSG(clc_challenge,          "x"),
       MSG(clc_spy,                "x"),
-      MSG(clc_privmsg,            "x")
+      MSG(clc_privmsg,            "x"),
+      MSG(clc_reliableack,        "x")
    };
 
    msg_info_t svc_messages[] = {
@@ -1007,6 +1503,10 @@ void InitNetMessageFormats()
 	MSG(svc_damagemobj,         "x"),
 	MSG(svc_wadinfo,            "x"),
 	MSG(svc_wadchunk,           "x"),
+	MSG(svc_moveplayer_delta,   "x"),
+	MSG(svc_updatelocalplayer_delta, "x"),
+	MSG(svc_movemobj_delta,     "x"),
+	MSG(svc_reliable,           "x"),
 	MSG(svc_compressed,         "x"),
 	MSG(svc_launcher_challenge, "x"),
 	MSG(svc_challenge,          "x"),
@@ -29,6 +29,7 @@
 #include "huffman.h"
 
 #include <string>
+#include <algorithm>
 
 // Max packet size to send and receive, in bytes
 #define	MAX_UDP_PACKET 8192
@@ -134,6 +135,14 @@ enum svc_t
 	// for downloading
 	svc_wadinfo,			// denis - [ulong:filesize]
 	svc_wadchunk,			// denis - [ulong:offset], [ushort:len], [byte[]:data]
+
+	// delta-compressed movement, see d_netdelta.h
+	svc_moveplayer_delta = 77,	// [byte:player] [long:tic] [delta]
+	svc_updatelocalplayer_delta,	// [long:tic] [delta]
+	svc_movemobj_delta,			// [short:netid] [delta]
+
+	// sequenced reliable channel, see d_netreliable.h
+	svc_reliable = 80,			// [short:seq] [byte:flags] [short:len] [data]
 		
 	// netdemos - NullPoint
 	svc_netdemocap = 100,
@@ -183,6 +192,7 @@ enum clc_t
 	clc_ready,				// [AM] Toggle ready state.
 	clc_spy,				// [SL] Tell server to send info about this player
 	clc_privmsg,			// [AM] Targeted chat to a specific player.
+	clc_reliableack,		// [short:next seq] [long:mask] - see d_netreliable.h
 
 	// for when launcher packets go astray
 	clc_launcher_challenge = 212,
@@ -193,6 +203,14 @@ enum clc_t
 extern msg_info_t clc_info[clc_max];
 extern msg_info_t svc_info[svc_max];
 
+// Optional protocol features a client asks for by appending a capability
+// mask to the end of its connect packet
+enum netcaps_t
+{
+	NETCAP_DELTASTATE = 0x0001,		// delta-compressed movement messages
+	NETCAP_RELIABLE = 0x0002		// reliable messages sent with NetReliableSender
+};
+
 enum svc_compressed_masks
 {
 	adaptive_mask = 1,
@@ -201,6 +219,9 @@ enum svc_compressed_masks
 	minilzo_mask = 8
 };
 
+// size above which packets get compressed (empirical), does not apply to adaptive compression
+#define MINILZO_COMPRESS_MINPACKETSIZE	0xFF
+
 typedef struct
 {
    byte    ip[4];
@@ -441,6 +462,16 @@ public:
 		overflowed = false;
 	}
 
+	// exchanges storage and contents with another buffer without copying
+	void swap(buf_t &other)
+	{
+		std::swap(data, other.data);
+		std::swap(allocsize, other.allocsize);
+		std::swap(cursize, other.cursize);
+		std::swap(readpos, other.readpos);
+		std::swap(overflowed, other.overflowed);
+	}
+
 	void resize(size_t len, bool clearbuf = true)
 	{
 		byte *olddata = data;
@@ -529,6 +560,20 @@ public:
 
 extern buf_t net_message;
 
+// Datagram syscall accounting
+struct net_syscall_stats_t
+{
+	unsigned int recv_calls, recv_packets;
+	unsigned int send_calls, send_packets;
+
+	net_syscall_stats_t()
+		: recv_calls(0), recv_packets(0), send_calls(0), send_packets(0)
+	{
+	}
+};
+
+extern net_syscall_stats_t net_syscalls;
+
 void CloseNetwork (void);
 void InitNetCommon(void);
 void I_SetPort(netadr_t &addr, int port);
@@ -539,6 +584,22 @@ bool NET_StringToAdr (const char *s, netadr_t *a);
 bool NET_CompareAdr (netadr_t a, netadr_t b);
 int  NET_GetPacket (void);
 void NET_SendPacket (buf_t &buf, netadr_t &to);
+void NET_QueuePacket (buf_t &buf, netadr_t &to);
+
+// One segment of a datagram sent with NET_QueuePacketv
+struct net_iovec_t
+{
+	const void	*data;
+	size_t		len;
+};
+
+#define NET_MAX_IOVECS 4
+
+void NET_QueuePacketv (const net_iovec_t *iov, size_t count, netadr_t &to);
+void NET_FlushPackets (void);
+unsigned int NET_FlushGeneration (void);
+void NET_SetBatchIO (bool enable);
+bool NET_BatchIOEnabled (void);
 std::string NET_GetLocalAddress (void);
 
 void SZ_Clear (buf_t *buf);
@@ -570,10 +631,10 @@ const char *MSG_ReadString (void);
 size_t MSG_SetOffset (const size_t &offset, const buf_t::seek_loc_t &loc);
 
 bool MSG_DecompressMinilzo ();
-bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap);
+bool MSG_CompressMinilzo (const byte *data, size_t len, buf_t &out);
 
-bool MSG_DecompressAdaptive (huffman &huff);
-bool MSG_CompressAdaptive (huffman &huff, buf_t &buf, size_t start_offset, size_t write_gap);
+bool MSG_DecompressHuffman (huffman &huff);
+bool MSG_CompressHuffman (huffman &huff, const byte *data, size_t len, buf_t &out);
 
 #endif
 
@@ -0,0 +1,355 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Worker thread pool and mutexes
+//
+//	I_RunParallel hands out the indices of a job one at a time to the worker
+//	threads and to the calling thread, and returns once every index has been
+//	processed.  Only one job runs at a time and jobs can not be nested; a job
+//	started from inside another one simply runs on the calling thread.
+//
+//-----------------------------------------------------------------------------
+
+#include <vector>
+
+#include "win32inc.h"
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "doomtype.h"
+#include "i_thread.h"
+
+//
+// I_Mutex
+//
+#ifdef _WIN32
+
+I_Mutex::I_Mutex()
+{
+	CRITICAL_SECTION *cs = new CRITICAL_SECTION;
+	InitializeCriticalSection(cs);
+	handle = cs;
+}
+
+I_Mutex::~I_Mutex()
+{
+	CRITICAL_SECTION *cs = (CRITICAL_SECTION *)handle;
+	DeleteCriticalSection(cs);
+	delete cs;
+}
+
+void I_Mutex::lock()
+{
+	EnterCriticalSection((CRITICAL_SECTION *)handle);
+}
+
+void I_Mutex::unlock()
+{
+	LeaveCriticalSection((CRITICAL_SECTION *)handle);
+}
+
+#else
+
+I_Mutex::I_Mutex()
+{
+	pthread_mutex_t *mutex = new pthread_mutex_t;
+	pthread_mutex_init(mutex, NULL);
+	handle = mutex;
+}
+
+I_Mutex::~I_Mutex()
+{
+	pthread_mutex_t *mutex = (pthread_mutex_t *)handle;
+	pthread_mutex_destroy(mutex);
+	delete mutex;
+}
+
+void I_Mutex::lock()
+{
+	pthread_mutex_lock((pthread_mutex_t *)handle);
+}
+
+void I_Mutex::unlock()
+{
+	pthread_mutex_unlock((pthread_mutex_t *)handle);
+}
+
+#endif	// _WIN32
+
+//
+// Worker pool
+//
+// pool_mutex guards everything below.  Workers sleep until the job
+// generation changes, then take indices until the job runs out.
+//
+struct parallel_job_t
+{
+	parallel_func_t	func;
+	void			*data;
+	size_t			count, next, done;
+	unsigned int	generation;
+};
+
+static parallel_job_t job;
+static bool pool_quit = false;
+static THREAD_LOCAL bool in_parallel = false;
+
+#ifdef _WIN32
+static CRITICAL_SECTION pool_mutex;
+static HANDLE pool_start = NULL;	// semaphore, released once per worker per job
+static HANDLE pool_done = NULL;		// auto-reset event, set when a job finishes
+static std::vector<HANDLE> workers;
+
+static void I_LockPool()	{ EnterCriticalSection(&pool_mutex); }
+static void I_UnlockPool()	{ LeaveCriticalSection(&pool_mutex); }
+#else
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static std::vector<pthread_t> workers;
+
+static void I_LockPool()	{ pthread_mutex_lock(&pool_mutex); }
+static void I_UnlockPool()	{ pthread_mutex_unlock(&pool_mutex); }
+#endif
+
+//
+// I_WorkOnJob
+//
+// Processes indices of the current job until there are none left.  Called
+// with pool_mutex held, which is released while the job function runs.
+//
+static void I_WorkOnJob()
+{
+	while (job.next < job.count)
+	{
+		size_t index = job.next++;
+
+		I_UnlockPool();
+
+		in_parallel = true;
+		job.func(job.data, index);
+		in_parallel = false;
+
+		I_LockPool();
+
+		if (++job.done == job.count)
+		{
+#ifdef _WIN32
+			SetEvent(pool_done);
+#else
+			pthread_cond_signal(&pool_done);
+#endif
+		}
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI I_WorkerThread(LPVOID)
+{
+	while (true)
+	{
+		WaitForSingleObject(pool_start, INFINITE);
+
+		I_LockPool();
+		if (pool_quit)
+		{
+			I_UnlockPool();
+			break;
+		}
+		I_WorkOnJob();
+		I_UnlockPool();
+	}
+
+	return 0;
+}
+#else
+static void *I_WorkerThread(void *)
+{
+	I_LockPool();
+
+	unsigned int seen = job.generation;
+
+	while (true)
+	{
+		while (!pool_quit && job.generation == seen)
+			pthread_cond_wait(&pool_start, &pool_mutex);
+
+		if (pool_quit)
+			break;
+
+		seen = job.generation;
+		I_WorkOnJob();
+	}
+
+	I_UnlockPool();
+	return NULL;
+}
+#endif
+
+//
+// I_StopWorkerThreads
+//
+static void I_StopWorkerThreads()
+{
+	if (workers.empty())
+		return;
+
+	I_LockPool();
+	pool_quit = true;
+	I_UnlockPool();
+
+#ifdef _WIN32
+	ReleaseSemaphore(pool_start, (LONG)workers.size(), NULL);
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		WaitForSingleObject(workers[i], INFINITE);
+		CloseHandle(workers[i]);
+	}
+#else
+	pthread_cond_broadcast(&pool_start);
+	for (size_t i = 0; i < workers.size(); i++)
+		pthread_join(workers[i], NULL);
+#endif
+
+	workers.clear();
+	pool_quit = false;
+}
+
+//
+// I_SetWorkerThreads
+//
+// Starts count worker threads in addition to the calling thread, replacing
+// any that were running.  With no workers, I_RunParallel runs every job on
+// the calling thread.
+//
+void I_SetWorkerThreads (size_t count)
+{
+	if (in_parallel || count == workers.size())
+		return;
+
+	I_StopWorkerThreads();
+
+#ifdef _WIN32
+	if (!pool_start)
+	{
+		InitializeCriticalSection(&pool_mutex);
+		pool_start = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+		pool_done = CreateEvent(NULL, FALSE, FALSE, NULL);
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		HANDLE thread = CreateThread(NULL, 0, I_WorkerThread, NULL, 0, NULL);
+		if (thread)
+			workers.push_back(thread);
+	}
+#else
+	for (size_t i = 0; i < count; i++)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, I_WorkerThread, NULL) == 0)
+			workers.push_back(thread);
+	}
+#endif
+}
+
+size_t I_GetWorkerThreads (void)
+{
+	return workers.size();
+}
+
+//
+// I_GetProcessorCount
+//
+// Returns the number of processor cores the threads can run on.
+//
+size_t I_GetProcessorCount (void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors ? (size_t)info.dwNumberOfProcessors : 1;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (size_t)count : 1;
+#endif
+}
+
+//
+// I_RunParallel
+//
+// Calls func(data, i) for every i below count, spread over the worker
+// threads and the calling thread, in no particular order.
+//
+void I_RunParallel (parallel_func_t func, void *data, size_t count)
+{
+	if (workers.empty() || in_parallel || count <= 1)
+	{
+		for (size_t i = 0; i < count; i++)
+			func(data, i);
+		return;
+	}
+
+	I_LockPool();
+
+	job.func = func;
+	job.data = data;
+	job.count = count;
+	job.next = 0;
+	job.done = 0;
+	job.generation++;
+
+#ifdef _WIN32
+	ReleaseSemaphore(pool_start, (LONG)workers.size(), NULL);
+#else
+	pthread_cond_broadcast(&pool_start);
+#endif
+
+	I_WorkOnJob();
+
+	while (job.done < job.count)
+	{
+#ifdef _WIN32
+		I_UnlockPool();
+		WaitForSingleObject(pool_done, INFINITE);
+		I_LockPool();
+#else
+		pthread_cond_wait(&pool_done, &pool_mutex);
+#endif
+	}
+
+	job.func = NULL;
+	job.data = NULL;
+
+	I_UnlockPool();
+}
+
+//
+// I_InParallel
+//
+// Returns true when called from a job function run by I_RunParallel on more
+// than one thread.
+//
+bool I_InParallel (void)
+{
+	return in_parallel;
+}
+
+VERSION_CONTROL (i_thread_cpp, "$Id$")
@@ -0,0 +1,85 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Worker thread pool and mutexes
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __I_THREAD_H__
+#define __I_THREAD_H__
+
+#include <stddef.h>
+
+// Storage class for variables that each thread has its own copy of
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+//
+// I_Mutex
+//
+class I_Mutex
+{
+public:
+	I_Mutex();
+	~I_Mutex();
+
+	void lock();
+	void unlock();
+
+private:
+	void	*handle;
+
+	// not copyable
+	I_Mutex(const I_Mutex &);
+	I_Mutex &operator =(const I_Mutex &);
+};
+
+//
+// I_MutexLock
+//
+// Holds a mutex for as long as it is in scope.
+//
+class I_MutexLock
+{
+public:
+	I_MutexLock(I_Mutex &mutex) : m(mutex)
+	{
+		m.lock();
+	}
+	~I_MutexLock()
+	{
+		m.unlock();
+	}
+
+private:
+	I_Mutex	&m;
+};
+
+// A job for I_RunParallel, called once for each index
+typedef void (*parallel_func_t)(void *data, size_t index);
+
+void I_SetWorkerThreads (size_t count);
+size_t I_GetWorkerThreads (void);
+size_t I_GetProcessorCount (void);
+void I_RunParallel (parallel_func_t func, void *data, size_t count);
+bool I_InParallel (void);
+
+#endif	// __I_THREAD_H__
@@ -27,6 +27,7 @@
 #include "m_random.h"
 #include "m_alloc.h"
 #include "i_system.h"
+#include "i_thread.h"
 #include "doomdef.h"
 #include "p_local.h"
 #include "p_lnspec.h"
@@ -46,6 +47,7 @@ EXTERN_CVAR (sv_allowexit)
 EXTERN_CVAR (sv_fastmonsters)
 EXTERN_CVAR (co_realactorheight)
 EXTERN_CVAR (co_zdoomphys)
+EXTERN_CVAR (sv_parallelai)
 
 enum dirtype_t
 {
@@ -662,6 +664,104 @@ bool P_LookForPlayers(AActor *actor, bool allaround)
 }
 
 
+//
+// P_CanPrepareMonsters
+//
+// Returns true if DThinker::RunThinkers should hand the actors it is about
+// to run to P_PrepareMonsters.
+//
+bool P_CanPrepareMonsters()
+{
+	return sv_parallelai && serverside && I_GetWorkerThreads() > 0 &&
+		!co_zdoomphys && !HasBehavior;
+}
+
+//
+// P_PrepareMonsters
+//
+// Most of a monster's thinking time goes into sight checks against its
+// target or, while it has none, the players it will look at next.  For the
+// monsters whose state runs out this tic, those checks are done ahead of
+// time on the worker threads (see P_PrefetchSight).  The monsters then think
+// one after another as always and find the results waiting, so the game,
+// including the random number sequence, plays out exactly as it would
+// without this.
+//
+void P_PrepareMonsters(const std::vector<AActor *> &actors)
+{
+	static std::vector<sightpair_t> pairs;
+	pairs.clear();
+
+	// the same table of players as P_LookForPlayers builds
+	player_t *playeringame[MAXPLAYERS];
+	memset(playeringame, 0, sizeof(playeringame));
+
+	short maxid = 0;
+	for (Players::iterator it = players.begin(); it != players.end(); ++it)
+	{
+		if (it->ingame() && !it->spectator)
+		{
+			playeringame[it->id - 1] = &*it;
+			maxid = it->id;
+		}
+	}
+
+	if (maxid != 0 && maxid < MAXPLAYERS_VANILLA)
+		maxid = MAXPLAYERS_VANILLA;
+
+	for (size_t i = 0; i < actors.size(); i++)
+	{
+		AActor *actor = actors[i];
+
+		if (!(actor->flags & MF_COUNTKILL) || (actor->flags & MF_CORPSE) ||
+			actor->health <= 0 || actor->tics != 1 || !actor->subsector)
+			continue;
+
+		sightpair_t pair;
+		pair.t1 = actor;
+		pair.result = false;
+
+		if (actor->target && actor->target->health > 0)
+		{
+			pair.t2 = actor->target;
+			pairs.push_back(pair);
+			continue;
+		}
+
+		if (maxid == 0)
+			continue;
+
+		// Walk the players the way P_LookForPlayers will, without moving
+		// lastlook, and queue each one it would check the sight of.
+		bool queued[MAXPLAYERS];
+		memset(queued, 0, sizeof(bool) * maxid);
+
+		int counter = 0;
+		unsigned int lastlook = actor->lastlook;
+		unsigned int stop = lastlook > 0 ? lastlook - 1 : maxid - 1;
+
+		for ( ; ; lastlook = (lastlook + 1) % maxid)
+		{
+			player_t *player = playeringame[lastlook];
+			if (player == NULL)
+				continue;
+
+			if (++counter == 3 || lastlook == stop)
+				break;
+
+			if (queued[lastlook] || (player->cheats & CF_NOTARGET) ||
+				player->health <= 0 || !player->mo)
+				continue;
+
+			queued[lastlook] = true;
+			pair.t2 = player->mo;
+			pairs.push_back(pair);
+		}
+	}
+
+	P_PrefetchSight(pairs);
+}
+
 //
 // A_KeenDie
 // DOOM II special, map 32.
@@ -30,6 +30,7 @@
 #endif
 
 #include <set>
+#include <vector>
 
 #define FLOATSPEED		(FRACUNIT*4)
 
@@ -132,6 +133,8 @@ BOOL	P_DeactivateMobj (AActor *mobj);
 //
 void	P_NoiseAlert (AActor* target, AActor* emmiter);
 void	P_SpawnBrainTargets(void);	// killough 3/26/98: spawn icon landings
+bool	P_CanPrepareMonsters (void);
+void	P_PrepareMonsters (const std::vector<AActor *> &actors);
 
 extern struct brain_s {				// killough 3/26/98: global state of boss brain
 	int easy, targeton;
@@ -239,6 +242,7 @@ BOOL	P_TryMove (AActor* thing, fixed_t x, fixed_t y, bool dropoff, bool onfloor
 BOOL	P_TeleportMove (AActor* thing, fixed_t x, fixed_t y, fixed_t z, BOOL telefrag);	// [RH] Added z and telefrag parameters
 void	P_SlideMove (AActor* mo);
 bool	P_CheckSight (const AActor* t1, const AActor* t2);
+void	P_InvalidateSightMemo (const sector_t *sector = NULL);
 void	P_UseLines (player_t* player);
 void	P_ApplyTorque(AActor *mo);
 void	P_CopySector(sector_t *dest, sector_t *src);
@@ -273,6 +277,15 @@ v3fixed_t P_LinePlaneIntersection(const plane_t *plane, const v3fixed_t &lineorg
 
 bool P_CheckSightEdges(const AActor* t1, const AActor* t2, float radius_boost);
 
+// P_PrefetchSight checks many pairs at once and fills in result
+struct sightpair_t
+{
+	const AActor	*t1, *t2;
+	bool			result;
+};
+
+void P_PrefetchSight(std::vector<sightpair_t> &pairs);
+
 bool	P_ChangeSector (sector_t* sector, bool crunch);
 
 extern	AActor*	linetarget; 	// who got hit (or NULL)
@@ -289,6 +302,7 @@ extern	fixed_t CameraX, CameraY, CameraZ;
 void	P_RadiusAttack (AActor *spot, AActor *source, int damage, int distance, bool hurtSelf, int mod);
 
 void	P_DelSeclist(msecnode_t *);							// phares 3/16/98
+void	P_ClearSecnodes(void);
 void	P_CreateSecNodeList(AActor*,fixed_t,fixed_t);		// phares 3/14/98
 int		P_GetMoveFactor(const AActor *mo, int *frictionp);	// phares  3/6/98
 int		P_GetFriction(const AActor *mo, int *frictionfactor);
@@ -306,7 +320,13 @@ extern int				bmapwidth;
 extern int				bmapheight; 	// in mapblocks
 extern fixed_t			bmaporgx;
 extern fixed_t			bmaporgy;		// origin of block map
-extern AActor** 		blocklinks; 	// for thing chains
+extern line_t**			blocklines;		// line list of every mapblock, end to end
+extern int*				blocklinestart;	// bmapwidth*bmapheight+1 indices into blocklines
+
+// The actors linked into a mapblock, in the order they were linked.
+// Iterating goes from the back, newest first, like the old thing chains.
+typedef std::vector<AActor*> blockthings_t;
+extern std::vector<blockthings_t> blockthings;
 
 extern std::set<short>	movable_sectors;
 
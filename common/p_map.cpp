@@ -44,6 +44,7 @@
 #include "m_vectors.h"
 #include <math.h>
 #include <set>
+#include <vector>
 
 EXTERN_CVAR(sv_unblockplayers)
 
@@ -2887,12 +2888,8 @@ void P_RadiusAttack(AActor *spot, AActor *source, int damage, int distance,
 		{
 			for (int x=xl ; x<=xh ; x++)
 			{
-				AActor *mobj = blocklinks[y*bmapwidth+x];
-				while (mobj)
-				{
-					actorset.insert(mobj);
-					mobj = mobj->bmapnode.Next(x, y);
-				}
+				const blockthings_t &block = blockthings[y*bmapwidth+x];
+				actorset.insert(block.begin(), block.end());
 			}
 		}
 
@@ -2928,12 +2925,19 @@ void P_RadiusAttack(AActor *spot, AActor *source, int damage, int distance,
 //
 bool	crushchange;
 bool 	nofit;
+static int changevalidcount;
 
 //
 // PIT_ChangeSector
 //
 BOOL PIT_ChangeSector (AActor *thing)
 {
+	// With co_blockmapfix an actor is linked into every block it overlaps,
+	// so only clip and crush it the first time it comes up.
+	if (thing->validcount == changevalidcount)
+		return true;
+	thing->validcount = changevalidcount;
+
 	if (P_ThingHeightClip (thing))
 	{
 		// keep checking
@@ -3011,6 +3015,9 @@ bool P_ChangeSector (sector_t *sector, bool crunch)
 	nofit = false;
 	crushchange = crunch;
 
+	int lastchangevalidcount = changevalidcount;
+	changevalidcount = ++validcount;
+
 	// [ML] co_boomsectortouch now part of co_boomphys
 	if (co_boomphys)
 	{
@@ -3029,16 +3036,32 @@ bool P_ChangeSector (sector_t *sector, bool crunch)
 		for (n=sector->touching_thinglist; n; n=n->m_snext)
 			n->visited = false;
 
-		do
-			for (n=sector->touching_thinglist; n; n=n->m_snext)	// go through list
-				if (!n->visited)								// unprocessed thing found
-				{
-					n->visited	= true; 						// mark thing as processed
-					if (!(n->m_thing->flags & MF_NOBLOCKMAP))	//jff 4/7/98 don't do these
-						PIT_ChangeSector(n->m_thing); 			// process it
-					break;										// exit and start over
-				}
-		while (n);	// repeat from scratch until all things left are marked valid
+		// Restarting from the head finds the first unprocessed thing, and
+		// everything in front of the one just processed has been processed
+		// already, unless a new node was added at the head.  So only go
+		// back to the head if that happened or if the node just processed
+		// has been taken out of the sector, and otherwise carry on from it.
+		// This visits things in the same order without rescanning the list
+		// after every one of them.
+		n = sector->touching_thinglist;
+		while (n)
+		{
+			if (n->visited)
+			{
+				n = n->m_snext;
+				continue;
+			}
+
+			n->visited = true; 								// mark thing as processed
+			if (!(n->m_thing->flags & MF_NOBLOCKMAP))		//jff 4/7/98 don't do these
+				PIT_ChangeSector(n->m_thing); 				// process it
+
+			msecnode_t *head = sector->touching_thinglist;
+			if (head && (!head->visited || n->m_sector != sector))
+				n = head;									// start over
+			else if (!head)
+				n = NULL;
+		}
 	}
 	else
 	{
@@ -3051,6 +3074,7 @@ bool P_ChangeSector (sector_t *sector, bool crunch)
 
 	}
 
+	changevalidcount = lastchangevalidcount;
 	return nofit;
 }
 
@@ -3058,8 +3082,16 @@ bool P_ChangeSector (sector_t *sector, bool crunch)
 // phares 3/21/98
 //
 // Maintain a freelist of msecnode_t's to reduce memory allocs and frees.
+//
+// The nodes are carved out of blocks of SECNODE_BLOCKSIZE, which are kept
+// from one level to the next.  P_ClearSecnodes hands every node back at
+// once when the level is unloaded.
 
-msecnode_t *headsecnode = NULL;
+static const size_t SECNODE_BLOCKSIZE = 512;
+
+static std::vector<msecnode_t *> secnodeblocks;
+static size_t secnodesused;		// handed out from the blocks, in order
+static msecnode_t *headsecnode = NULL;
 
 // P_GetSecnode() retrieves a node from the freelist. The calling routine
 // should make sure it sets all fields properly.
@@ -3072,9 +3104,14 @@ msecnode_t *P_GetSecnode()
 	{
 		node = headsecnode;
 		headsecnode = headsecnode->m_snext;
+		return node;
 	}
-	else
-		node = (msecnode_t *)Z_Malloc (sizeof(*node), PU_LEVEL, NULL);
+
+	if (secnodesused == secnodeblocks.size() * SECNODE_BLOCKSIZE)
+		secnodeblocks.push_back(new msecnode_t[SECNODE_BLOCKSIZE]);
+
+	node = secnodeblocks[secnodesused / SECNODE_BLOCKSIZE] + secnodesused % SECNODE_BLOCKSIZE;
+	secnodesused++;
 	return node;
 }
 
@@ -3085,10 +3122,25 @@ void P_PutSecnode (msecnode_t *node)
 	if (!node)
 		return;
 
+	// P_ChangeSector checks this to tell whether a node is still in use
+	node->m_sector = NULL;
+
 	node->m_snext = headsecnode;
 	headsecnode = node;
 }
 
+//
+// P_ClearSecnodes
+//
+// Returns every node to the pool.  Nothing may use a node from the
+// previous level afterwards.
+//
+void P_ClearSecnodes()
+{
+	headsecnode = NULL;
+	secnodesused = 0;
+}
+
 // phares 3/16/98
 //
 // P_AddSecnode() searches the current list to see if this sector is
@@ -3537,6 +3589,7 @@ void P_ChangeCeilingHeight(sector_t *sector, fixed_t amount)
 
 	plane_t *plane = &sector->ceilingplane;
 	plane->d -= FixedMul(amount, plane->c);
+	P_InvalidateSightMemo(sector);
 
 	// The sector's ceilingheight variable is still used for (among other things)
 	// calculating wall texture offsets
@@ -3550,6 +3603,7 @@ void P_ChangeFloorHeight(sector_t *sector, fixed_t amount)
 
 	plane_t *plane = &sector->floorplane;
 	plane->d -= FixedMul(amount, plane->c);
+	P_InvalidateSightMemo(sector);
 
 	// The sector's floorheight variable is still used for (among other things)
 	// calculating wall texture offsets
@@ -136,27 +136,8 @@ void AActor::ActorBlockMapListNode::Link()
 		// [SL] 2012-05-15 - Add the actor to the blocklinks list for all of the
 		// blockmaps it overlaps, not just the blockmap for the actor's center point.
 		for (int bmy = top; bmy <= bottom; bmy++)
-		{
 			for (int bmx = left; bmx <= right; bmx++)
-			{
-				// killough 8/11/98: simpler scheme using pointer-to-pointer prev
-				// pointers, allows head nodes to be treated like everything else
-
-				AActor **headptr = &blocklinks[bmy * bmapwidth + bmx];
-				AActor *headactor = *headptr;
-
-				size_t thisidx = getIndex(bmx, bmy);
-				
-		        if ((next[thisidx] = headactor))
-		        {
-		        	size_t nextidx = headactor->bmapnode.getIndex(bmx, bmy);
-					headactor->bmapnode.prev[nextidx] = &next[thisidx];
-				}
-				
-		        prev[thisidx] = headptr;
-		        *headptr = actor;
-			}
-		}
+				blockthings[bmy * bmapwidth + bmx].push_back(actor);
 	}
 	else
 	{
@@ -170,55 +151,51 @@ void AActor::ActorBlockMapListNode::Unlink()
 	{
 		for (int bmx = originx; bmx < originx + blockcntx; bmx++)
 		{
-			// killough 8/11/98: simpler scheme using pointers-to-pointers for prev
-			// pointers, allows head node pointers to be treated like everything else
-			//
-			// Also more robust, since it doesn't depend on current position for
-			// unlinking. Old method required computing head node based on position
-			// at time of unlinking, assuming it was the same position as during
-			// linking.
-
-			size_t thisidx = getIndex(bmx, bmy);
-			
-			AActor *nextactor = next[thisidx];
-			AActor **prevactor = prev[thisidx];
-			
-			if (prevactor && (*prevactor = nextactor))
+			if (bmx >= bmapwidth || bmy >= bmapheight)
+				continue;
+
+			// Keep the order of the other actors, since the iterators return
+			// them newest first.  Actors that move are usually near the end.
+			blockthings_t &block = blockthings[bmy * bmapwidth + bmx];
+
+			for (size_t i = block.size(); i-- > 0; )
 			{
-				size_t nextidx = nextactor->bmapnode.getIndex(bmx, bmy);
-				nextactor->bmapnode.prev[nextidx] = prevactor;
+				if (block[i] == actor)
+				{
+					block.erase(block.begin() + i);
+					break;
+				}
 			}
 		}
 	}
+
+	clear();
 }
 
+//
+// AActor::ActorBlockMapListNode::Next
+//
+// Returns the actor that the iterators visit after this one in the given
+// mapblock, or NULL if this one is the last.
+//
 AActor* AActor::ActorBlockMapListNode::Next(int bmx, int bmy)
 {
 	if (bmx < 0 || bmx >= bmapwidth || bmy < 0 || bmy >= bmapheight)
 		return NULL;
 
-	return next[getIndex(bmx, bmy)];
+	const blockthings_t &block = blockthings[bmy * bmapwidth + bmx];
+
+	for (size_t i = block.size(); i-- > 0; )
+		if (block[i] == actor)
+			return i > 0 ? block[i - 1] : NULL;
+
+	return NULL;
 }
 
 void AActor::ActorBlockMapListNode::clear()
 {
 	originx = originy = 0;
 	blockcntx = blockcnty = 0;
-	memset(prev, 0, sizeof(prev));
-	memset(next, 0, sizeof(next));
-}
-
-size_t AActor::ActorBlockMapListNode::getIndex(int bmx, int bmy)
-{
-	if (!co_blockmapfix)
-		return 0;
-
-	// range check
-	if (bmx < originx || bmx > originx + blockcntx - 1 ||
-		bmy < originy || bmy > originy + blockcnty - 1)
-		return 0;
-		
-	return (bmy - originy) * BLOCKSX + bmx - originx;
 }
 
 
@@ -648,13 +625,10 @@ BOOL P_BlockLinesIterator (int x, int y, BOOL(*func)(line_t*))
 	if (x<0 || y<0 || x>=bmapwidth || y>=bmapheight)
 		return true;
 
-	int offset = *(blockmap + (bmapwidth*y + x));
-	int *list = blockmaplump + offset;
-	
 	/* [RH] Polyobj stuff from Hexen --> */
 	polyblock_t *polyLink;
 
-	offset = y*bmapwidth + x;
+	int offset = y*bmapwidth + x;
 	if (PolyBlockMap)
 	{
 		polyLink = PolyBlockMap[offset];
@@ -689,14 +663,17 @@ BOOL P_BlockLinesIterator (int x, int y, BOOL(*func)(line_t*))
 	// referencing linedef 0). Using this first entry (as vanilla Doom does) can
 	// cause hitscan weapons to erroneously hit the first linedef entry regardless
 	// of where that linedef is located in relation to the block.
+	line_t **list = blocklines + blocklinestart[offset];
+	line_t **end = blocklines + blocklinestart[offset+1];
+
 	if (co_blockmapfix)
 		++list;
 
-	for (; *list != -1; list++)
+	for (; list < end; list++)
 	{
-		line_t *ld = &lines[*list];
+		line_t *ld = *list;
 
-		if (ld->validcount != validcount) {
+		if (ld && ld->validcount != validcount) {
 			ld->validcount = validcount;
 
 			if ( !func(ld) )
@@ -715,17 +692,33 @@ BOOL P_BlockThingsIterator (int x, int y, BOOL(*func)(AActor*), AActor *actor)
 {
 	if (x<0 || y<0 || x>=bmapwidth || y>=bmapheight)
 		return true;
-	else
- 	{
-		AActor *mobj = (actor != NULL ? actor : blocklinks[y*bmapwidth+x]);
-		while (mobj)
- 		{
- 			if (!func (mobj))
- 				return false;
-
-			mobj = mobj->bmapnode.Next(x, y);
-		}
+
+	// newest first, starting with actor if one is given
+	blockthings_t &block = blockthings[y*bmapwidth+x];
+	size_t i = block.size();
+
+	if (actor != NULL)
+	{
+		while (i > 0 && block[i-1] != actor)
+			i--;
 	}
+
+	while (i > 0)
+	{
+		AActor *mobj = block[--i];
+
+		if (!func (mobj))
+			return false;
+
+		// func can take actors out of the block, such as a pickup that was
+		// touched.  Those that come after mobj were visited already, but if
+		// one before it is gone, everything from mobj on moved down a place.
+		if (i > block.size())
+			i = block.size();
+		else if (i > 0 && block[i-1] == mobj)
+			i--;
+	}
+
 	return true;
 }
 
@@ -21,6 +21,9 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <math.h>
+#include <vector>
+
 #include "m_alloc.h"
 #include "i_system.h"
 #include "z_zone.h"
@@ -38,6 +41,7 @@
 #include "p_mobj.h"
 #include "p_ctf.h"
 #include "gi.h"
+#include "c_dispatch.h"
 
 #define WATER_SINK_FACTOR		3
 #define WATER_SINK_SMALL_FACTOR	4
@@ -76,9 +80,17 @@ int             iquetail;
 
 NetIDHandler ServerNetID;
 
-// denis - fast netid lookup
-typedef std::map<size_t, AActor::AActorPtr> netid_map_t;
-netid_map_t actor_by_netid;
+// Actors by netid.  A slot only counts if it was filled since the last
+// P_ClearAllNetIds, which makes clearing the table a single increment.
+// Actors take themselves out of the table when they are deleted.
+struct netidslot_t
+{
+	AActor			*actor;
+	unsigned int	generation;
+};
+
+static netidslot_t actor_by_netid[MAX_NETID + 1];
+static unsigned int netid_generation = 1;
 
 IMPLEMENT_SERIAL(AActor, DThinker)
 
@@ -89,6 +101,9 @@ AActor::~AActor ()
 
     // Zero all pointers generated by this->ptr()
     self.update_all(NULL);
+
+	if (netid > 0 && netid <= MAX_NETID && actor_by_netid[netid].actor == this)
+		actor_by_netid[netid].actor = NULL;
 }
 
 void MapThing::Serialize (FArchive &arc)
@@ -106,32 +121,33 @@ void MapThing::Serialize (FArchive &arc)
 }
 
 AActor::AActor () :
-    x(0), y(0), z(0), prevx(0), prevy(0), prevz(0),
+    x(0), y(0), z(0), momx(0), momy(0), momz(0), radius(0), height(0), flags(0), flags2(0),
+    floorz(0), ceilingz(0), subsector(NULL), validcount(0), type(MT_UNKNOWNTHING), bmapnode(this),
+    dropoffz(0), floorsector(NULL), prevx(0), prevy(0), prevz(0),
 	snext(NULL), sprev(NULL), angle(0), prevangle(0), sprite(SPR_UNKN), frame(0),
-    pitch(0), prevpitch(0), effects(0), subsector(NULL),
-    floorz(0), ceilingz(0), dropoffz(0), floorsector(NULL), radius(0), height(0),
-    momx(0), momy(0), momz(0), validcount(0), type(MT_UNKNOWNTHING), info(NULL), tics(0), state(NULL),
-    damage(0), flags(0), flags2(0), special1(0), special2(0), health(0), movedir(0), movecount(0),
+    pitch(0), prevpitch(0), effects(0), info(NULL), tics(0), state(NULL),
+    damage(0), special1(0), special2(0), health(0), movedir(0), movecount(0),
     visdir(0), reactiontime(0), threshold(0), player(NULL), lastlook(0), special(0), inext(NULL),
     iprev(NULL), translation(translationref_t()), translucency(0), waterlevel(0), gear(0), onground(false),
     touching_sectorlist(NULL), deadtic(0), oldframe(0), rndindex(0), netid(0),
-    tid(0), bmapnode(this)
+    tid(0)
 {
 	memset(args, 0, sizeof(args));
 	self.init(this);
 }
 
 AActor::AActor (const AActor &other) :
-    x(other.x), y(other.y), z(other.z), prevx(other.prevx), prevy(other.prevy), prevz(other.prevz),
+    x(other.x), y(other.y), z(other.z), momx(other.momx), momy(other.momy), momz(other.momz),
+    radius(other.radius), height(other.height), flags(other.flags), flags2(other.flags2),
+    floorz(other.floorz), ceilingz(other.ceilingz), subsector(other.subsector),
+    validcount(other.validcount), type(other.type), bmapnode(other.bmapnode),
+    dropoffz(other.dropoffz), floorsector(other.floorsector),
+    prevx(other.prevx), prevy(other.prevy), prevz(other.prevz),
 	snext(other.snext), sprev(other.sprev),
     angle(other.angle), prevangle(other.prevangle), sprite(other.sprite), frame(other.frame),
     pitch(other.pitch), prevpitch(other.prevpitch), effects(other.effects),
-    subsector(other.subsector),
-    floorz(other.floorz), ceilingz(other.ceilingz), dropoffz(other.dropoffz),
-    floorsector(other.floorsector),	radius(other.radius), height(other.height), momx(other.momx),
-	momy(other.momy), momz(other.momz), validcount(other.validcount),
-	type(other.type), info(other.info), tics(other.tics), state(other.state),
-	damage(other.damage), flags(other.flags), flags2(other.flags2), special1(other.special1),
+	info(other.info), tics(other.tics), state(other.state),
+	damage(other.damage), special1(other.special1),
 	special2(other.special2), health(other.health), movedir(other.movedir),
 	movecount(other.movecount), visdir(other.visdir), reactiontime(other.reactiontime),
     threshold(other.threshold), player(other.player), lastlook(other.lastlook),
@@ -139,7 +155,7 @@ AActor::AActor (const AActor &other) :
     translucency(other.translucency), waterlevel(other.waterlevel), gear(other.gear),
     onground(other.onground), touching_sectorlist(other.touching_sectorlist),
     deadtic(other.deadtic), oldframe(other.oldframe),
-    rndindex(other.rndindex), netid(other.netid), tid(other.tid), bmapnode(other.bmapnode)
+    rndindex(other.rndindex), netid(other.netid), tid(other.tid)
 {
 	memcpy(args, other.args, sizeof(args));
 	self.init(this);
@@ -217,16 +233,16 @@ AActor &AActor::operator= (const AActor &other)
 //
 
 AActor::AActor (fixed_t ix, fixed_t iy, fixed_t iz, mobjtype_t itype) :
-    x(0), y(0), z(0), prevx(0), prevy(0), prevz(0),
+    x(0), y(0), z(0), momx(0), momy(0), momz(0), radius(0), height(0), flags(0), flags2(0),
+    floorz(0), ceilingz(0), subsector(NULL), validcount(0), type(MT_UNKNOWNTHING), bmapnode(this),
+    dropoffz(0), floorsector(NULL), prevx(0), prevy(0), prevz(0),
 	snext(NULL), sprev(NULL), angle(0), prevangle(0), sprite(SPR_UNKN), frame(0),
-    pitch(0), prevpitch(0), effects(0), subsector(NULL),
-    floorz(0), ceilingz(0), dropoffz(0), floorsector(NULL), radius(0), height(0), momx(0), momy(0), momz(0),
-    validcount(0), type(MT_UNKNOWNTHING), info(NULL), tics(0), state(NULL), damage(0), flags(0), flags2(0),
+    pitch(0), prevpitch(0), effects(0), info(NULL), tics(0), state(NULL), damage(0),
     special1(0), special2(0), health(0), movedir(0), movecount(0), visdir(0),
     reactiontime(0), threshold(0), player(NULL), lastlook(0), special(0), inext(NULL),
     iprev(NULL), translation(translationref_t()), translucency(0), waterlevel(0), gear(0), onground(false),
     touching_sectorlist(NULL), deadtic(0), oldframe(0), rndindex(0), netid(0),
-    tid(0), bmapnode(this)
+    tid(0)
 {
 	state_t *st;
 
@@ -250,7 +266,7 @@ AActor::AActor (fixed_t ix, fixed_t iy, fixed_t iz, mobjtype_t itype) :
 	rndindex = M_Random();
 
     if (multiplayer && serverside)
-        netid = ServerNetID.ObtainNetID();
+        P_SetThingId(this, ServerNetID.ObtainNetID());
 
 	if (sv_skill != sk_nightmare)
 		reactiontime = info->reactiontime;
@@ -325,9 +341,15 @@ void P_AnimationTick(AActor *mo)
 //
 // P_ClearAllNetIds
 //
+// Empties the netid table in constant time by moving on to a new generation.
+//
 void P_ClearAllNetIds()
 {
-	actor_by_netid.clear();
+	if (++netid_generation == 0)
+	{
+		memset(actor_by_netid, 0, sizeof(actor_by_netid));
+		netid_generation = 1;
+	}
 }
 
 //
@@ -336,21 +358,33 @@ void P_ClearAllNetIds()
 //
 AActor* P_FindThingById(size_t id)
 {
-	netid_map_t::iterator i = actor_by_netid.find(id);
+	if (id > MAX_NETID)
+		return NULL;
 
-	if(i == actor_by_netid.end())
-		return AActor::AActorPtr();
-	else
-		return i->second;
+	const netidslot_t &slot = actor_by_netid[id];
+	if (slot.generation != netid_generation)
+		return NULL;
+
+	return slot.actor;
 }
 
 //
 // P_SetThingId
 //
+// Gives an actor a new netid, or none if it is 0.
+//
 void P_SetThingId(AActor *mo, size_t newnetid)
 {
+	if (mo->netid > 0 && mo->netid <= MAX_NETID && actor_by_netid[mo->netid].actor == mo)
+		actor_by_netid[mo->netid].actor = NULL;
+
 	mo->netid = newnetid;
-	actor_by_netid[newnetid] = mo->ptr();
+
+	if (newnetid > 0 && newnetid <= MAX_NETID)
+	{
+		actor_by_netid[newnetid].actor = mo;
+		actor_by_netid[newnetid].generation = netid_generation;
+	}
 }
 
 
@@ -2666,4 +2700,108 @@ bool P_VisibleToPlayers(AActor *mo)
 	return false;
 }
 
+//
+// actorbench
+//
+// Microbenchmark of actor movement and collision: spawns a grid of barrels
+// around the first player start, pushes each of them in a random direction
+// every tic and times only their RunThink calls.  The barrels are destroyed
+// afterwards and the game's random number indices are put back, but the
+// level is still disturbed, so this refuses to run with players in a
+// netgame or while a demo is recorded or played.
+//
+// actorbench [actors] [tics]
+//
+static const fixed_t ACTORBENCH_MAXSTEP = 4 * FRACUNIT;	// per tic
+
+BEGIN_COMMAND (actorbench)
+{
+	if (gamestate != GS_LEVEL || playerstarts.empty())
+	{
+		Printf(PRINT_HIGH, "actorbench: a level with a player start must be loaded\n");
+		return;
+	}
+
+	if ((multiplayer && !players.empty()) || demorecording || demoplayback)
+	{
+		Printf(PRINT_HIGH, "actorbench: can not run in a netgame with players or during a demo\n");
+		return;
+	}
+
+	int count = argc > 1 ? atoi(argv[1]) : 1000;
+	int tics = argc > 2 ? atoi(argv[2]) : TICRATE * 10;
+	if (count <= 0 || tics <= 0)
+	{
+		Printf(PRINT_HIGH, "Usage: actorbench [actors] [tics]\n");
+		return;
+	}
+
+	// far enough apart that two neighbours stepping towards each other
+	// don't touch, so the moves are mostly real ones rather than blocked
+	const fixed_t spacing = 2 * mobjinfo[MT_BARREL].radius + 2 * ACTORBENCH_MAXSTEP;
+	const int side = (int)ceil(sqrt((double)count));
+	const fixed_t originx = playerstarts[0].x << FRACBITS;
+	const fixed_t originy = playerstarts[0].y << FRACBITS;
+
+	// spawning draws from the game's random numbers
+	extern unsigned char rndindex, prndindex;
+	const unsigned char saved_rndindex = rndindex;
+	const unsigned char saved_prndindex = prndindex;
+
+	// a private generator for the pushes
+	unsigned int seed = 1;
+
+	std::vector<AActor::AActorPtr> crowd;
+	crowd.reserve(count);
+
+	for (int i = 0; i < count; i++)
+	{
+		fixed_t x = originx + (i % side - side / 2) * spacing;
+		fixed_t y = originy + (i / side - side / 2) * spacing;
+		crowd.push_back((new AActor(x, y, ONFLOORZ, MT_BARREL))->ptr());
+	}
+
+	dtime_t elapsed = 0;
+	unsigned int ticks = 0;
+
+	for (int t = 0; t < tics; t++)
+	{
+		for (size_t i = 0; i < crowd.size(); i++)
+		{
+			if (!crowd[i])
+				continue;
+
+			seed = seed * 1664525 + 1013904223;
+			crowd[i]->momx = (int)((seed >> 8) % (2 * ACTORBENCH_MAXSTEP)) - ACTORBENCH_MAXSTEP;
+			seed = seed * 1664525 + 1013904223;
+			crowd[i]->momy = (int)((seed >> 8) % (2 * ACTORBENCH_MAXSTEP)) - ACTORBENCH_MAXSTEP;
+		}
+
+		dtime_t start = I_GetTime();
+
+		for (size_t i = 0; i < crowd.size(); i++)
+		{
+			if (!crowd[i])
+				continue;
+
+			crowd[i]->RunThink();
+			ticks++;
+		}
+
+		elapsed += I_GetTime() - start;
+	}
+
+	for (size_t i = 0; i < crowd.size(); i++)
+		if (crowd[i])
+			crowd[i]->Destroy();
+
+	rndindex = saved_rndindex;
+	prndindex = saved_prndindex;
+
+	Printf(PRINT_HIGH, "actorbench: %d actors, %d tics, %u actor ticks\n", count, tics, ticks);
+	Printf(PRINT_HIGH, "%.1f ns per actor tick, %.3f ms per tic\n",
+		ticks ? (double)elapsed / ticks : 0.0, (double)elapsed / tics / 1000000.0);
+}
+END_COMMAND (actorbench)
+
 VERSION_CONTROL (p_mobj_cpp, "$Id$")
@@ -0,0 +1,766 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Potentially visible sets for sight checks
+//
+//	A line of sight that leaves a sector has to go through one of the
+//	two-sided lines of that sector, since one-sided lines always block
+//	sight.  The flood starts from the region of the map that the BSP assigns
+//	to a subsector and follows the two-sided lines into the sectors behind
+//	them.  Every line passed through narrows the lines of sight that can
+//	still continue, in the same way as the portal flood of Quake's vis:
+//	the next line is clipped against the lines that separate the source
+//	region from the line that was just passed.
+//
+//	All of the clipping is conservative.  Sector heights are ignored since
+//	they can change, and anything that is close to a boundary is kept, so a
+//	subsector is only left out of the set if no straight line from the
+//	source region can reach it.
+//
+//-----------------------------------------------------------------------------
+
+#include <math.h>
+#include <string.h>
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "doomtype.h"
+#include "doomstat.h"
+#include "md5.h"
+#include "m_argv.h"
+#include "m_alloc.h"
+#include "m_fileio.h"
+#include "i_system.h"
+#include "z_zone.h"
+#include "w_wad.h"
+#include "p_local.h"
+#include "p_setup.h"
+#include "c_console.h"
+#include "p_pvs.h"
+
+byte	*subsectorpvs;
+size_t	pvsrowbytes;
+
+// The table would take numsubsectors^2 / 8 bytes
+static const int PVS_MAXSUBSECTORS = 8192;
+
+// Most portals visited from one subsector before everything is assumed to
+// be visible from it, and the most time spent building the tables before
+// giving up on the level
+static const unsigned int PVS_MAXSTEPS = 1 << 16;
+static const dtime_t PVS_MAXTIME = 10000;	// ms
+
+// Anything this close to a clipping line, in map units, is kept
+static const double PVS_EPSILON = 0.125;
+
+// Maps whose build timed out this session, by the hash of their lumps
+static std::set<std::string> pvstimedout;
+
+static const DWORD PVS_CACHEMAGIC = 0x5356504F;	// "OPVS"
+static const DWORD PVS_CACHEVERSION = 1;
+
+struct pvscacheheader_t
+{
+	DWORD	magic;
+	DWORD	version;
+	DWORD	numsectors;
+	DWORD	numsubsectors;
+	DWORD	rejectsize;		// 0 if the map's own REJECT is used
+	DWORD	pvssize;		// 0 if there is no table for this map
+};
+
+struct pvsvec_t
+{
+	double x, y;
+};
+
+typedef std::vector<pvsvec_t> pvswinding_t;
+
+// Points with a*x + b*y - d >= 0 are kept.  (a, b) has unit length.
+struct pvsplane_t
+{
+	double a, b, d;
+};
+
+// A two-sided line seen from one of its sectors.  The sector entered is on
+// the left of v1 -> v2.
+struct pvsportal_t
+{
+	pvsvec_t	v1, v2;
+	pvsplane_t	plane;
+	int			line;
+	int			to;
+};
+
+struct pvsitem_t
+{
+	int		portal;
+	double	lo, hi;		// part of the portal that can be passed through
+};
+
+typedef std::vector<std::pair<double, double> > pvsintervals_t;
+
+struct pvsbuild_t
+{
+	std::vector<pvsportal_t>		portals;
+	std::vector<std::vector<int> >	sectorportals;		// leaving each sector
+	std::vector<std::vector<int> >	sectorsubsectors;
+	std::vector<pvswinding_t>		cells;				// region of each subsector
+	std::vector<pvsintervals_t>		explored;			// from the current source
+};
+
+//
+// PVS_PlaneThrough
+//
+// Returns the line through p1 and p2 that keeps the points on its left.
+//
+static pvsplane_t PVS_PlaneThrough(const pvsvec_t &p1, const pvsvec_t &p2)
+{
+	pvsplane_t plane;
+	double a = p1.y - p2.y;
+	double b = p2.x - p1.x;
+	double len = sqrt(a * a + b * b);
+
+	if (len == 0.0)
+		len = 1.0;
+
+	plane.a = a / len;
+	plane.b = b / len;
+	plane.d = plane.a * p1.x + plane.b * p1.y;
+	return plane;
+}
+
+static inline double PVS_Dist(const pvsplane_t &plane, const pvsvec_t &p)
+{
+	return plane.a * p.x + plane.b * p.y - plane.d;
+}
+
+//
+// PVS_ClipWinding
+//
+// Cuts away the part of a convex polygon that is outside of plane.
+//
+static void PVS_ClipWinding(const pvswinding_t &in, const pvsplane_t &plane, pvswinding_t &out)
+{
+	out.clear();
+
+	size_t count = in.size();
+	for (size_t i = 0; i < count; i++)
+	{
+		const pvsvec_t &p1 = in[i];
+		const pvsvec_t &p2 = in[(i + 1) % count];
+		double d1 = PVS_Dist(plane, p1) + PVS_EPSILON;
+		double d2 = PVS_Dist(plane, p2) + PVS_EPSILON;
+
+		if (d1 >= 0.0)
+			out.push_back(p1);
+
+		if ((d1 >= 0.0) != (d2 >= 0.0))
+		{
+			double frac = d1 / (d1 - d2);
+			pvsvec_t mid;
+			mid.x = p1.x + frac * (p2.x - p1.x);
+			mid.y = p1.y + frac * (p2.y - p1.y);
+			out.push_back(mid);
+		}
+	}
+}
+
+//
+// PVS_WindingVisible
+//
+// Returns true if any of a convex polygon is inside all of the planes.
+//
+static bool PVS_WindingVisible(const pvswinding_t &winding, const std::vector<pvsplane_t> &planes)
+{
+	static pvswinding_t work[2];
+
+	const pvswinding_t *in = &winding;
+	for (size_t i = 0; i < planes.size(); i++)
+	{
+		pvswinding_t &out = work[i & 1];
+		PVS_ClipWinding(*in, planes[i], out);
+
+		if (out.empty())
+			return false;
+
+		in = &out;
+	}
+
+	return true;
+}
+
+//
+// PVS_ClipPortal
+//
+// Narrows the part lo..hi of a portal to what is inside all of the planes.
+//
+static bool PVS_ClipPortal(const pvsportal_t &portal, const std::vector<pvsplane_t> &planes,
+						   double &lo, double &hi)
+{
+	lo = 0.0;
+	hi = 1.0;
+
+	for (size_t i = 0; i < planes.size(); i++)
+	{
+		double d1 = PVS_Dist(planes[i], portal.v1) + PVS_EPSILON;
+		double d2 = PVS_Dist(planes[i], portal.v2) + PVS_EPSILON;
+
+		if (d1 < 0.0 && d2 < 0.0)
+			return false;
+		if (d1 >= 0.0 && d2 >= 0.0)
+			continue;
+
+		double frac = d1 / (d1 - d2);
+		if (d1 < 0.0)
+			lo = MAX(lo, frac);
+		else
+			hi = MIN(hi, frac);
+
+		if (lo > hi)
+			return false;
+	}
+
+	return true;
+}
+
+//
+// PVS_AddSeparators
+//
+// Adds the lines that have the source on one side and the pass on the other.
+// A line of sight through both can only go on into the pass's side of them.
+// Lines that touch both are left out, which only makes the result larger.
+//
+static void PVS_AddSeparators(const pvswinding_t &source, const pvsvec_t pass[2],
+							  std::vector<pvsplane_t> &planes)
+{
+	for (size_t i = 0; i < source.size(); i++)
+	{
+		for (int j = 0; j < 2; j++)
+		{
+			const pvsvec_t &a = source[i];
+			const pvsvec_t &b = pass[j];
+			double nx = a.y - b.y;
+			double ny = b.x - a.x;
+
+			if (nx == 0.0 && ny == 0.0)
+				continue;
+
+			double smin = 0.0, smax = 0.0;
+			for (size_t k = 0; k < source.size(); k++)
+			{
+				double d = (source[k].x - a.x) * nx + (source[k].y - a.y) * ny;
+				smin = MIN(smin, d);
+				smax = MAX(smax, d);
+			}
+
+			double pmin = 0.0, pmax = 0.0;
+			for (int k = 0; k < 2; k++)
+			{
+				double d = (pass[k].x - a.x) * nx + (pass[k].y - a.y) * ny;
+				pmin = MIN(pmin, d);
+				pmax = MAX(pmax, d);
+			}
+
+			if (smax <= 0.0 && smin < 0.0 && pmin >= 0.0 && pmax > 0.0)
+				planes.push_back(PVS_PlaneThrough(a, b));
+			else if (smin >= 0.0 && smax > 0.0 && pmax <= 0.0 && pmin < 0.0)
+				planes.push_back(PVS_PlaneThrough(b, a));
+		}
+	}
+}
+
+//
+// PVS_BuildCells
+//
+// Finds the region of the map that the BSP assigns to each subsector by
+// cutting the map's bounding box with the partition lines.
+//
+static void PVS_BuildCells(pvsbuild_t &build, unsigned int node, const pvswinding_t &region)
+{
+	if (node & NF_SUBSECTOR)
+	{
+		build.cells[node & ~NF_SUBSECTOR] = region;
+		return;
+	}
+
+	const node_t &bsp = nodes[node];
+	pvsvec_t p1, p2;
+	p1.x = FIXED2DOUBLE(bsp.x);
+	p1.y = FIXED2DOUBLE(bsp.y);
+	p2.x = FIXED2DOUBLE(bsp.x + bsp.dx);
+	p2.y = FIXED2DOUBLE(bsp.y + bsp.dy);
+
+	pvswinding_t child;
+
+	// the front is on the right of the partition line
+	PVS_ClipWinding(region, PVS_PlaneThrough(p2, p1), child);
+	PVS_BuildCells(build, bsp.children[0], child);
+
+	PVS_ClipWinding(region, PVS_PlaneThrough(p1, p2), child);
+	PVS_BuildCells(build, bsp.children[1], child);
+}
+
+//
+// PVS_Setup
+//
+static void PVS_Setup(pvsbuild_t &build)
+{
+	build.sectorportals.resize(numsectors);
+	build.sectorsubsectors.resize(numsectors);
+	build.cells.resize(numsubsectors);
+
+	for (int i = 0; i < numlines; i++)
+	{
+		const line_t *line = &lines[i];
+
+		if (!line->frontsector || !line->backsector || line->frontsector == line->backsector)
+			continue;
+
+		pvsvec_t v1, v2;
+		v1.x = FIXED2DOUBLE(line->v1->x);
+		v1.y = FIXED2DOUBLE(line->v1->y);
+		v2.x = FIXED2DOUBLE(line->v2->x);
+		v2.y = FIXED2DOUBLE(line->v2->y);
+
+		// the front sector is on the right of v1 -> v2
+		pvsportal_t portal;
+		portal.line = i;
+
+		portal.v1 = v1;
+		portal.v2 = v2;
+		portal.plane = PVS_PlaneThrough(v1, v2);
+		portal.to = line->backsector - sectors;
+		build.sectorportals[line->frontsector - sectors].push_back(build.portals.size());
+		build.portals.push_back(portal);
+
+		portal.v1 = v2;
+		portal.v2 = v1;
+		portal.plane = PVS_PlaneThrough(v2, v1);
+		portal.to = line->frontsector - sectors;
+		build.sectorportals[line->backsector - sectors].push_back(build.portals.size());
+		build.portals.push_back(portal);
+	}
+
+	build.explored.resize(build.portals.size());
+
+	for (int i = 0; i < numsubsectors; i++)
+		build.sectorsubsectors[subsectors[i].sector - sectors].push_back(i);
+
+	// everything in the map, with some room around it
+	double left = 0.0, right = 0.0, bottom = 0.0, top = 0.0;
+	for (int i = 0; i < numvertexes; i++)
+	{
+		double x = FIXED2DOUBLE(vertexes[i].x);
+		double y = FIXED2DOUBLE(vertexes[i].y);
+
+		if (i == 0 || x < left)		left = x;
+		if (i == 0 || x > right)	right = x;
+		if (i == 0 || y < bottom)	bottom = y;
+		if (i == 0 || y > top)		top = y;
+	}
+
+	pvswinding_t box(4);
+	box[0].x = left - 64.0;		box[0].y = bottom - 64.0;
+	box[1].x = right + 64.0;	box[1].y = bottom - 64.0;
+	box[2].x = right + 64.0;	box[2].y = top + 64.0;
+	box[3].x = left - 64.0;		box[3].y = top + 64.0;
+
+	if (numnodes > 0)
+		PVS_BuildCells(build, numnodes - 1, box);
+	else
+		PVS_BuildCells(build, NF_SUBSECTOR, box);
+}
+
+//
+// PVS_Explore
+//
+// Returns false if the part lo..hi of a portal has already been passed
+// through from the current source.  Anything that can be seen through a part
+// of a portal can also be seen through a larger part of it.
+//
+static bool PVS_Explore(pvsintervals_t &explored, double lo, double hi)
+{
+	for (size_t i = 0; i < explored.size(); i++)
+		if (explored[i].first <= lo && explored[i].second >= hi)
+			return false;
+
+	for (size_t i = 0; i < explored.size(); )
+	{
+		if (explored[i].first >= lo && explored[i].second <= hi)
+		{
+			explored[i] = explored.back();
+			explored.pop_back();
+		}
+		else
+			i++;
+	}
+
+	explored.push_back(std::make_pair(lo, hi));
+	return true;
+}
+
+//
+// PVS_Flood
+//
+// Marks the subsectors that might be visible from subsector ss in row, and
+// their sectors in sectorseen.
+//
+static void PVS_Flood(pvsbuild_t &build, int ss, byte *row, size_t rowbytes, byte *sectorseen)
+{
+	const pvswinding_t &source = build.cells[ss];
+	int sec = subsectors[ss].sector - sectors;
+
+	std::deque<pvsitem_t> queue;
+	std::vector<int> touched;
+	std::vector<pvsplane_t> planes;
+
+	// all of its own sector, which may not be convex
+	for (size_t i = 0; i < build.sectorsubsectors[sec].size(); i++)
+	{
+		int other = build.sectorsubsectors[sec][i];
+		row[other >> 3] |= 1 << (other & 7);
+	}
+	sectorseen[sec] = 1;
+
+	for (size_t i = 0; i < build.sectorportals[sec].size(); i++)
+	{
+		int p = build.sectorportals[sec][i];
+
+		// some of the source has to be behind the portal
+		bool behind = false;
+		for (size_t j = 0; j < source.size() && !behind; j++)
+			behind = PVS_Dist(build.portals[p].plane, source[j]) < PVS_EPSILON;
+
+		if (!behind || !PVS_Explore(build.explored[p], 0.0, 1.0))
+			continue;
+
+		pvsitem_t item = { p, 0.0, 1.0 };
+		queue.push_back(item);
+		touched.push_back(p);
+	}
+
+	unsigned int steps = 0;
+
+	while (!queue.empty())
+	{
+		if (++steps > PVS_MAXSTEPS)
+		{
+			memset(row, 0xFF, rowbytes);
+			memset(sectorseen, 1, numsectors);
+			break;
+		}
+
+		pvsitem_t item = queue.front();
+		queue.pop_front();
+
+		const pvsportal_t &portal = build.portals[item.portal];
+
+		pvsvec_t pass[2];
+		pass[0].x = portal.v1.x + item.lo * (portal.v2.x - portal.v1.x);
+		pass[0].y = portal.v1.y + item.lo * (portal.v2.y - portal.v1.y);
+		pass[1].x = portal.v1.x + item.hi * (portal.v2.x - portal.v1.x);
+		pass[1].y = portal.v1.y + item.hi * (portal.v2.y - portal.v1.y);
+
+		planes.clear();
+		planes.push_back(portal.plane);
+		PVS_AddSeparators(source, pass, planes);
+
+		const std::vector<int> &ssecs = build.sectorsubsectors[portal.to];
+		for (size_t i = 0; i < ssecs.size(); i++)
+		{
+			int other = ssecs[i];
+			if (row[other >> 3] & (1 << (other & 7)))
+				continue;
+
+			if (PVS_WindingVisible(build.cells[other], planes))
+			{
+				row[other >> 3] |= 1 << (other & 7);
+				sectorseen[portal.to] = 1;
+			}
+		}
+
+		const std::vector<int> &next = build.sectorportals[portal.to];
+		for (size_t i = 0; i < next.size(); i++)
+		{
+			int p = next[i];
+			if (build.portals[p].line == portal.line)
+				continue;
+
+			double lo, hi;
+			if (!PVS_ClipPortal(build.portals[p], planes, lo, hi))
+				continue;
+
+			if (build.explored[p].empty())
+				touched.push_back(p);
+			if (!PVS_Explore(build.explored[p], lo, hi))
+				continue;
+
+			pvsitem_t nextitem = { p, lo, hi };
+			queue.push_back(nextitem);
+		}
+	}
+
+	for (size_t i = 0; i < touched.size(); i++)
+		build.explored[touched[i]].clear();
+}
+
+//
+// PVS_MapHash
+//
+// Returns the MD5 of the lumps that the tables are built from.
+//
+static std::string PVS_MapHash(int lumpnum)
+{
+	std::vector<byte> data;
+
+	for (int i = ML_LINEDEFS; i <= ML_REJECT; i++)
+	{
+		size_t offset = data.size();
+		DWORD length = W_LumpLength(lumpnum + i);
+
+		data.resize(offset + length + sizeof(DWORD));
+		memcpy(&data[offset], &length, sizeof(DWORD));
+		if (length)
+			W_ReadLump(lumpnum + i, &data[offset + sizeof(DWORD)]);
+	}
+
+	return MD5SUM(&data[0], data.size());
+}
+
+static std::string PVS_CacheFileName(const std::string &hash)
+{
+	std::string name = "sight-" + hash + ".pvs";
+	return I_GetUserFileName(name.c_str());
+}
+
+//
+// PVS_ReadCache
+//
+// Returns true if the tables for the map were found.  They are left NULL if
+// it was too large to build them for.
+//
+static bool PVS_ReadCache(const std::string &filename, size_t rejectsize, size_t pvssize,
+						  byte **reject, byte **pvs)
+{
+	if (!M_FileExists(filename))
+		return false;
+
+	FILE *f = fopen(filename.c_str(), "rb");
+	if (!f)
+		return false;
+
+	pvscacheheader_t header;
+	bool valid = fread(&header, sizeof(header), 1, f) == 1 &&
+				header.magic == PVS_CACHEMAGIC &&
+				header.version == PVS_CACHEVERSION &&
+				header.numsectors == (DWORD)numsectors &&
+				header.numsubsectors == (DWORD)numsubsectors &&
+				(header.rejectsize == 0 || header.rejectsize == rejectsize) &&
+				(header.pvssize == 0 || header.pvssize == pvssize);
+
+	if (valid && header.rejectsize)
+	{
+		*reject = (byte *)Z_Malloc(rejectsize, PU_LEVEL, 0);
+		valid = fread(*reject, rejectsize, 1, f) == 1;
+	}
+
+	if (valid && header.pvssize)
+	{
+		*pvs = (byte *)M_Malloc(pvssize);
+		valid = fread(*pvs, pvssize, 1, f) == 1;
+	}
+
+	fclose(f);
+
+	if (!valid)
+	{
+		if (*reject)
+			Z_Free(*reject);
+		M_Free(*pvs);
+		*reject = *pvs = NULL;
+	}
+
+	return valid;
+}
+
+static void PVS_WriteCache(const std::string &filename, size_t rejectsize, size_t pvssize,
+						   const byte *reject, const byte *pvs)
+{
+	FILE *f = fopen(filename.c_str(), "wb");
+	if (!f)
+		return;
+
+	pvscacheheader_t header;
+	header.magic = PVS_CACHEMAGIC;
+	header.version = PVS_CACHEVERSION;
+	header.numsectors = numsectors;
+	header.numsubsectors = numsubsectors;
+	header.rejectsize = reject ? rejectsize : 0;
+	header.pvssize = pvs ? pvssize : 0;
+
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+	if (ok && reject)
+		ok = fwrite(reject, rejectsize, 1, f) == 1;
+	if (ok && pvs)
+		ok = fwrite(pvs, pvssize, 1, f) == 1;
+
+	fclose(f);
+
+	if (!ok)
+		remove(filename.c_str());
+}
+
+//
+// P_FreeSightTables
+//
+void P_FreeSightTables()
+{
+	M_Free(subsectorpvs);
+
+	subsectorpvs = NULL;
+	pvsrowbytes = 0;
+}
+
+//
+// P_BuildSightTables
+//
+// Called by P_SetupLevel once the BSP and the REJECT lump are loaded.  Maps
+// whose REJECT is missing or all zeroes get one generated from the flood.
+// Demos are played back without the tables, in case a line of sight that
+// slips through a corner of the map matters to them.
+//
+void P_BuildSightTables(int lumpnum)
+{
+	P_FreeSightTables();
+
+	if (!serverside || demoplayback || demorecording || po_NumPolyobjs ||
+		Args.CheckParm("-nosighttables") || numsubsectors <= 0)
+		return;
+
+	size_t rejectsize = ((size_t)numsectors * numsectors + 7) / 8;
+
+	bool needreject = rejectempty || !rejectmatrix;
+	for (size_t i = 0; i < rejectsize && !needreject; i++)
+		if (rejectmatrix[i])
+			break;
+		else if (i == rejectsize - 1)
+			needreject = true;
+
+	bool wantpvs = numsubsectors <= PVS_MAXSUBSECTORS;
+	if (!needreject && !wantpvs)
+		return;
+
+	size_t rowbytes = (numsubsectors + 7) / 8;
+	size_t pvssize = rowbytes * numsubsectors;
+
+	byte *reject = NULL;
+	byte *pvs = NULL;
+
+	std::string hash = PVS_MapHash(lumpnum);
+	if (pvstimedout.count(hash))
+		return;
+
+	std::string filename = PVS_CacheFileName(hash);
+
+	if (!PVS_ReadCache(filename, rejectsize, pvssize, &reject, &pvs))
+	{
+		dtime_t start = I_GetTime();
+
+		pvsbuild_t build;
+		PVS_Setup(build);
+
+		if (needreject)
+		{
+			reject = (byte *)Z_Malloc(rejectsize, PU_LEVEL, 0);
+			memset(reject, 0xFF, rejectsize);
+		}
+
+		if (wantpvs)
+		{
+			pvs = (byte *)M_Malloc(pvssize);
+			memset(pvs, 0, pvssize);
+		}
+
+		std::vector<byte> scratch(rowbytes);
+		std::vector<byte> sectorseen(numsectors);
+		bool timedout = false;
+
+		for (int ss = 0; ss < numsubsectors; ss++)
+		{
+			byte *row = pvs ? pvs + ss * rowbytes : &scratch[0];
+
+			if (!pvs)
+				memset(row, 0, rowbytes);
+			memset(&sectorseen[0], 0, numsectors);
+
+			PVS_Flood(build, ss, row, rowbytes, &sectorseen[0]);
+
+			if (reject)
+			{
+				int s1 = subsectors[ss].sector - sectors;
+				for (int s2 = 0; s2 < numsectors; s2++)
+				{
+					if (!sectorseen[s2])
+						continue;
+
+					int pnum = s1 * numsectors + s2;
+					reject[pnum >> 3] &= ~(1 << (pnum & 7));
+				}
+			}
+
+			if (I_ConvertTimeToMs(I_GetTime() - start) > PVS_MAXTIME)
+			{
+				DPrintf("Sight tables took too long to build and will not be used.\n");
+
+				if (reject)
+					Z_Free(reject);
+				M_Free(pvs);
+				reject = pvs = NULL;
+				timedout = true;
+				break;
+			}
+		}
+
+		// A build that timed out is not written to the cache, since it may
+		// only have been slow because the machine was busy, but it is not
+		// tried again until the next time the program is run.
+		if (timedout)
+			pvstimedout.insert(hash);
+		else
+		{
+			DPrintf("Built sight tables for %d subsectors in %u ms.\n", numsubsectors,
+					(unsigned int)I_ConvertTimeToMs(I_GetTime() - start));
+
+			PVS_WriteCache(filename, rejectsize, pvssize, reject, pvs);
+		}
+	}
+
+	if (reject)
+	{
+		rejectmatrix = reject;
+		rejectempty = false;
+	}
+
+	subsectorpvs = pvs;
+	pvsrowbytes = pvs ? rowbytes : 0;
+}
+
+VERSION_CONTROL (p_pvs_cpp, "$Id$")
@@ -0,0 +1,61 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Potentially visible sets for sight checks
+//
+//	When a level is loaded, every subsector is flooded through the
+//	two-sided lines of the map to find the subsectors that could possibly
+//	be seen from it, no matter how the doors and lifts of the level move.
+//	A sight check between actors in subsectors that can not see each other
+//	is rejected without tracing the line of sight.  A REJECT lump is
+//	generated from the same flood for maps that come with an empty one.
+//
+//	Building the tables can take a while on large maps, so they are saved
+//	in the user's directory, keyed by the MD5 of the map's lumps.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __P_PVS_H__
+#define __P_PVS_H__
+
+#include <stddef.h>
+
+#include "doomtype.h"
+#include "r_state.h"
+
+extern byte		*subsectorpvs;	// numsubsectors rows of pvsrowbytes, or NULL
+extern size_t	pvsrowbytes;
+
+void P_BuildSightTables (int lumpnum);
+void P_FreeSightTables (void);
+
+//
+// P_PotentiallyVisible
+//
+// Returns false if nothing in subsector to can be seen from subsector from.
+//
+inline bool P_PotentiallyVisible(const subsector_t *from, const subsector_t *to)
+{
+	if (!subsectorpvs)
+		return true;
+
+	size_t s2 = to - subsectors;
+	return (subsectorpvs[(from - subsectors) * pvsrowbytes + (s2 >> 3)] & (1 << (s2 & 7))) != 0;
+}
+
+#endif // __P_PVS_H__
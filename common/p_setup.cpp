@@ -32,6 +32,7 @@
 #include "m_vectors.h"
 #include "m_argv.h"
 #include "z_zone.h"
+#include "z_slab.h"
 #include "m_swap.h"
 #include "m_bbox.h"
 #include "g_game.h"
@@ -47,6 +48,7 @@
 #include "c_console.h"
 
 #include "p_setup.h"
+#include "p_pvs.h"
 
 void SV_PreservePlayer(player_t &player);
 void P_SpawnMapThing (mapthing2_t *mthing, int position);
@@ -104,10 +106,13 @@ int 			bmapheight; 	// size in mapblocks
 int				*blockmap;		// int for larger maps ([RH] Made int because BOOM does)
 int				*blockmaplump;	// offsets in blockmap are from here
 
+line_t			**blocklines;		// the line list of every mapblock, end to end
+int				*blocklinestart;	// where each mapblock's list starts in blocklines
+
 fixed_t 		bmaporgx;		// origin of block map
 fixed_t 		bmaporgy;
 
-AActor**		blocklinks;		// for thing chains
+std::vector<blockthings_t>	blockthings;	// for thing lists
 
 
 
@@ -145,7 +150,7 @@ mapthing2_t		*redteam_p;
 //
 void P_LoadVertexes (int lump)
 {
-	byte *data;
+	const byte *data;
 	int i;
 
 	// Determine number of vertices:
@@ -156,18 +161,18 @@ void P_LoadVertexes (int lump)
 	vertexes = (vertex_t *)Z_Malloc (numvertexes*sizeof(vertex_t), PU_LEVEL, 0);
 
 	// Load data into cache.
-	data = (byte *)W_CacheLumpNum (lump, PU_STATIC);
+	data = (const byte *)W_MapLumpNum (lump);
 
 	// Copy and convert vertex coordinates,
 	// internal representation as fixed.
 	for (i = 0; i < numvertexes; i++)
 	{
-		vertexes[i].x = LESHORT(((mapvertex_t *)data)[i].x)<<FRACBITS;
-		vertexes[i].y = LESHORT(((mapvertex_t *)data)[i].y)<<FRACBITS;
+		vertexes[i].x = LESHORT(((const mapvertex_t *)data)[i].x)<<FRACBITS;
+		vertexes[i].y = LESHORT(((const mapvertex_t *)data)[i].y)<<FRACBITS;
 	}
 
 	// Free buffer memory.
-	Z_Free (data);
+	W_UnmapLump (lump, data);
 }
 
 
@@ -180,17 +185,17 @@ void P_LoadVertexes (int lump)
 void P_LoadSegs (int lump)
 {
 	int  i;
-	byte *data;
+	const byte *data;
 
 	numsegs = W_LumpLength (lump) / sizeof(mapseg_t);
 	segs = (seg_t *)Z_Malloc (numsegs*sizeof(seg_t), PU_LEVEL, 0);
 	memset (segs, 0, numsegs*sizeof(seg_t));
-	data = (byte *)W_CacheLumpNum (lump, PU_STATIC);
+	data = (const byte *)W_MapLumpNum (lump);
 
 	for (i = 0; i < numsegs; i++)
 	{
 		seg_t *li = segs+i;
-		mapseg_t *ml = (mapseg_t *) data + i;
+		const mapseg_t *ml = (const mapseg_t *) data + i;
 
 		int side, linedef;
 		line_t *ldef;
@@ -252,7 +257,7 @@ void P_LoadSegs (int lump)
 		li->length = FLOAT2FIXED(sqrt(dx * dx + dy* dy));
 	}
 
-	Z_Free (data);
+	W_UnmapLump (lump, data);
 }
 
 
@@ -261,22 +266,22 @@ void P_LoadSegs (int lump)
 //
 void P_LoadSubsectors (int lump)
 {
-	byte *data;
+	const byte *data;
 	int i;
 
 	numsubsectors = W_LumpLength (lump) / sizeof(mapsubsector_t);
 	subsectors = (subsector_t *)Z_Malloc (numsubsectors*sizeof(subsector_t),PU_LEVEL,0);
-	data = (byte *)W_CacheLumpNum (lump,PU_STATIC);
+	data = (const byte *)W_MapLumpNum (lump);
 
 	memset (subsectors, 0, numsubsectors*sizeof(subsector_t));
 
 	for (i = 0; i < numsubsectors; i++)
 	{
-		subsectors[i].numlines = (unsigned short)LESHORT(((mapsubsector_t *)data)[i].numsegs);
-		subsectors[i].firstline = (unsigned short)LESHORT(((mapsubsector_t *)data)[i].firstseg);
+		subsectors[i].numlines = (unsigned short)LESHORT(((const mapsubsector_t *)data)[i].numsegs);
+		subsectors[i].firstline = (unsigned short)LESHORT(((const mapsubsector_t *)data)[i].firstseg);
 	}
 
-	Z_Free (data);
+	W_UnmapLump (lump, data);
 }
 
 
@@ -286,9 +291,9 @@ void P_LoadSubsectors (int lump)
 //
 void P_LoadSectors (int lump)
 {
-	byte*				data;
+	const byte*			data;
 	int 				i;
-	mapsector_t*		ms;
+	const mapsector_t*	ms;
 	sector_t*			ss;
 	int					defSeqType;
 
@@ -301,14 +306,14 @@ void P_LoadSectors (int lump)
 	sectors = new sector_t[numsectors];
 	memset(sectors, 0, sizeof(sector_t)*numsectors);
 
-	data = (byte *)W_CacheLumpNum (lump, PU_STATIC);
+	data = (const byte *)W_MapLumpNum (lump);
 
 	if (level.flags & LEVEL_SNDSEQTOTALCTRL)
 		defSeqType = 0;
 	else
 		defSeqType = -1;
 
-	ms = (mapsector_t *)data;
+	ms = (const mapsector_t *)data;
 	ss = sectors;
 	for (i = 0; i < numsectors; i++, ss++, ms++)
 	{
@@ -379,7 +384,7 @@ void P_LoadSectors (int lump)
 		ss->movefactor = ORIG_FRICTION_FACTOR;
 	}
 
-	Z_Free (data);
+	W_UnmapLump (lump, data);
 }
 
 
@@ -388,18 +393,18 @@ void P_LoadSectors (int lump)
 //
 void P_LoadNodes (int lump)
 {
-	byte*		data;
+	const byte*	data;
 	int 		i;
 	int 		j;
 	int 		k;
-	mapnode_t*	mn;
+	const mapnode_t*	mn;
 	node_t* 	no;
 
 	numnodes = W_LumpLength (lump) / sizeof(mapnode_t);
 	nodes = (node_t *)Z_Malloc (numnodes*sizeof(node_t), PU_LEVEL, 0);
-	data = (byte *)W_CacheLumpNum (lump, PU_STATIC);
+	data = (const byte *)W_MapLumpNum (lump);
 
-	mn = (mapnode_t *)data;
+	mn = (const mapnode_t *)data;
 	no = nodes;
 
 	for (i = 0; i < numnodes; i++, no++, mn++)
@@ -425,7 +430,7 @@ void P_LoadNodes (int lump)
 		}
 	}
 
-	Z_Free (data);
+	W_UnmapLump (lump, data);
 }
 
 //
@@ -570,9 +575,9 @@ bool P_LoadXNOD(int lump)
 void P_LoadThings (int lump)
 {
 	mapthing2_t mt2;		// [RH] for translation
-	byte *data = (byte *)W_CacheLumpNum (lump, PU_STATIC);
-	mapthing_t *mt = (mapthing_t *)data;
-	mapthing_t *lastmt = (mapthing_t *)(data + W_LumpLength (lump));
+	const byte *data = (const byte *)W_MapLumpNum (lump);
+	const mapthing_t *mt = (const mapthing_t *)data;
+	const mapthing_t *lastmt = (const mapthing_t *)(data + W_LumpLength (lump));
 
 	playerstarts.clear();
 	voodoostarts.clear();
@@ -604,7 +609,7 @@ void P_LoadThings (int lump)
 		P_SpawnMapThing (&mt2, 0);
 	}
 
-	Z_Free (data);
+	W_UnmapLump (lump, data);
 }
 
 // [RH]
@@ -1103,9 +1108,10 @@ static void AddBlockLine
 // This finds the intersection of each linedef with the column and
 // row lines at the left and bottom of each blockmap cell. It then
 // adds the line to all block lists touching the intersection.
+// Returns the length of the lump.
 //
 
-void P_CreateBlockMap()
+int P_CreateBlockMap()
 {
 	int xorg,yorg;					// blockmap origin (lower left)
 	int nrows,ncols;				// blockmap dimensions
@@ -1369,11 +1375,74 @@ void P_CreateBlockMap()
 	delete[] blocklists;
 	delete[] blockcount;
 	delete[] blockdone;
+
+	return 4 + NBlocks + linetotal;
 }
 
 // jff 10/6/98
 // End new code added to speed up calculation of internal blockmap
 
+//
+// P_CompactBlockMap
+//
+// Copies the line list of every mapblock out of the blockmap lump into
+// blocklines, one after another in mapblock order, so that iterating over
+// a mapblock reads a single run of line pointers without going through the
+// lump's offsets.  Lists that are shared by several mapblocks in the lump
+// are copied for each of them.
+//
+// The first entry of each list is kept as it is, because it is only
+// skipped when co_blockmapfix is set.  A list that is missing from the
+// lump gets a NULL first entry, and line numbers that are out of range
+// are left out.
+//
+static void P_CompactBlockMap(int count)
+{
+	const int numblocks = bmapwidth * bmapheight;
+	int total = 0;
+	int i;
+
+	for (i = 0; i < numblocks; i++)
+	{
+		int offset = 4 + i < count ? blockmaplump[4 + i] : count;
+		int length = 1;
+
+		if (offset >= 0 && offset < count && blockmaplump[offset] != -1)
+		{
+			for (int j = offset + 1; j < count && blockmaplump[j] != -1; j++)
+				if (blockmaplump[j] >= 0 && blockmaplump[j] < numlines)
+					length++;
+		}
+
+		total += length;
+	}
+
+	blocklines = (line_t **)Z_Malloc(sizeof(*blocklines) * total, PU_LEVEL, 0);
+	blocklinestart = (int *)Z_Malloc(sizeof(*blocklinestart) * (numblocks + 1), PU_LEVEL, 0);
+
+	line_t **list = blocklines;
+
+	for (i = 0; i < numblocks; i++)
+	{
+		int offset = 4 + i < count ? blockmaplump[4 + i] : count;
+
+		blocklinestart[i] = list - blocklines;
+		*list++ = NULL;
+
+		if (offset < 0 || offset >= count || blockmaplump[offset] == -1)
+			continue;
+
+		if (blockmaplump[offset] >= 0 && blockmaplump[offset] < numlines)
+			list[-1] = &lines[blockmaplump[offset]];
+
+		for (int j = offset + 1; j < count && blockmaplump[j] != -1; j++)
+			if (blockmaplump[j] >= 0 && blockmaplump[j] < numlines)
+				*list++ = &lines[blockmaplump[j]];
+	}
+
+	blocklinestart[numblocks] = list - blocklines;
+}
+
 //
 // P_LoadBlockMap
 //
@@ -1384,7 +1453,7 @@ void P_LoadBlockMap (int lump)
 	int count;
 
 	if (Args.CheckParm("-blockmap") || (count = W_LumpLength(lump)/2) >= 0x10000 || count < 4)
-		P_CreateBlockMap();
+		count = P_CreateBlockMap();
 	else
 	{
 		short *wadblockmaplump = (short *)W_CacheLumpNum (lump, PU_LEVEL);
@@ -1414,12 +1483,13 @@ void P_LoadBlockMap (int lump)
 	bmaporgy = blockmaplump[1]<<FRACBITS;
 	bmapwidth = blockmaplump[2];
 	bmapheight = blockmaplump[3];
-
-	// clear out mobj chains
-	count = sizeof(*blocklinks) * bmapwidth*bmapheight;
-	blocklinks = (AActor **)Z_Malloc (count, PU_LEVEL, 0);
-	memset (blocklinks, 0, count);
 	blockmap = blockmaplump+4;
+
+	P_CompactBlockMap(count);
+
+	// clear out mobj lists
+	blockthings.clear();
+	blockthings.resize(bmapwidth*bmapheight);
 }
 
 
@@ -1682,6 +1752,7 @@ void P_SetupLevel (char *lumpname, int position)
 
 	DThinker::DestroyAllThinkers ();
 	Z_FreeTags (PU_LEVEL, PU_PURGELEVEL-1);
+	Z_TrimSlabs ();
 	NormalLight.next = NULL;	// [RH] Z_FreeTags frees all the custom colormaps
 
 	// UNUSED W_Profile ();
@@ -1729,6 +1800,7 @@ void P_SetupLevel (char *lumpname, int position)
 	}
 
 	rejectmatrix = (byte *)W_CacheLumpNum (lumpnum+ML_REJECT, PU_LEVEL);
+	rejectempty = false;
 	{
 		// [SL] 2011-07-01 - Check to see if the reject table is of the proper size
 		// If it's too short, the reject table should be ignored when
@@ -1761,6 +1833,9 @@ void P_SetupLevel (char *lumpname, int position)
 
     PO_Init ();
 
+	// build the subsector PVS and, if the map has none, the reject table
+	P_BuildSightTables (lumpnum);
+
     if (serverside)
     {
 		for (Players::iterator it = players.begin();it != players.end();++it)
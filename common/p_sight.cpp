@@ -31,6 +31,10 @@
 #include "m_random.h"
 #include "m_bbox.h"
 #include "m_vectors.h"
+#include "c_dispatch.h"
+#include "c_console.h"
+#include "p_pvs.h"
+#include "i_thread.h"
 
 // State.
 #include "r_state.h"
@@ -38,17 +42,84 @@
 //
 // P_CheckSight
 //
-fixed_t		sightzstart;		// eye z of looker
-fixed_t		topslope;
-fixed_t		bottomslope;		// slopes to top and bottom of target
+// Each thread has its own trace so that P_PrefetchSight can run the Doom
+// sight check on several at once.
+//
+THREAD_LOCAL fixed_t	sightzstart;		// eye z of looker
+THREAD_LOCAL fixed_t	topslope;
+THREAD_LOCAL fixed_t	bottomslope;		// slopes to top and bottom of target
+
+THREAD_LOCAL divline_t	strace;			// from t1 to t2
+THREAD_LOCAL fixed_t	t2x;
+THREAD_LOCAL fixed_t	t2y;
 
-divline_t	strace;			// from t1 to t2
-fixed_t		t2x;
-fixed_t		t2y;
+// Set while a worker thread checks sight.  Lines are then not marked with
+// validcount, which is shared, and are checked again if the trace reaches
+// them twice; that gives the same result.
+static THREAD_LOCAL bool sightnomark;
 
 int		sightcounts[2];
 int		sightcounts2[3];
 
+//
+// Sight memo
+//
+// A monster looks at its target several times a tic, and the same actors are
+// checked again when nothing between them has moved.  The results are kept
+// for the rest of the tic.  The positions are part of the key since actors
+// can move between checks.
+//
+// Sectors are hashed into regions, and a trace notes the regions of the
+// sectors whose heights it looked at.  A moving sector plane stamps its
+// region with a new generation, which only drops the results that crossed
+// that region; a moving polyobject drops all of them.
+//
+static const int SIGHTREGIONS = 512;	// must be a power of two
+static const int SIGHTREGION_WORDS = SIGHTREGIONS / 32;
+
+struct sightregions_t
+{
+	DWORD			bits[SIGHTREGION_WORDS];
+};
+
+struct sightmemo_t
+{
+	const AActor	*t1, *t2;
+	fixed_t			x1, y1, z1, h1;
+	fixed_t			x2, y2, z2, h2;
+	int				tic;
+	QWORD			generation;
+	sightregions_t	regions;
+	bool			zdoom;
+	bool			result;
+};
+
+static const size_t SIGHTMEMO_SIZE = 4096;	// must be a power of two
+static sightmemo_t sightmemo[SIGHTMEMO_SIZE];
+
+static QWORD sightgeneration = 1;
+static QWORD sightflushgeneration;				// older results are all stale
+static QWORD sightregiongeneration[SIGHTREGIONS];
+
+// regions crossed by the trace being run on this thread
+static THREAD_LOCAL sightregions_t sightcrossed;
+
+static int P_SightRegion(const sector_t *sector)
+{
+	return (sector - sectors) & (SIGHTREGIONS - 1);
+}
+
+static void P_MarkSightSector(const sector_t *sector)
+{
+	if (sector)
+	{
+		int region = P_SightRegion(sector);
+		sightcrossed.bits[region >> 5] |= 1u << (region & 31);
+	}
+}
+
+static unsigned int sightchecks, sightpvsrejects, sightmemohits;
+
 extern bool HasBehavior;
 EXTERN_CVAR (co_zdoomphys)
 
@@ -73,6 +144,9 @@ bool PTR_SightTraverse (intercept_t *in)
 	if (!li->backsector)
         return false;
 
+	P_MarkSightSector(li->frontsector);
+	P_MarkSightSector(li->backsector);
+
 //
 // crosses a two sided line
 //
@@ -116,7 +190,7 @@ bool PTR_SightTraverse (intercept_t *in)
 bool P_SightBlockLinesIterator (int x, int y)
 {
 	int offset;
-	int *list;
+	line_t **list;
 	line_t *ld;
 	int s1, s2;
 	divline_t dl;
@@ -171,12 +245,12 @@ bool P_SightBlockLinesIterator (int x, int y)
 		polyLink = polyLink->next;
 	}
 
-	offset = *(blockmap + (bmapwidth*y + x));
+	line_t **end = blocklines + blocklinestart[offset+1];
 
-	for (list = blockmaplump + offset; *list != -1; list++)
+	for (list = blocklines + blocklinestart[offset]; list < end; list++)
 	{
-		ld = &lines[*list];
-		if (ld->validcount == validcount)
+		ld = *list;
+		if (!ld || ld->validcount == validcount)
 			continue;				// line has already been checked
 		ld->validcount = validcount;
 
@@ -418,6 +492,9 @@ bool P_CheckSightZDoom(const AActor *t1, const AActor *t2)
 	//
 	// killough 4/19/98: make fake floors and ceilings block monster view
 
+	P_MarkSightSector(s1->heightsec);
+	P_MarkSightSector(s2->heightsec);
+
 	fixed_t s1_floorheight_t1 = P_FloorHeight(t1->x, t1->y, s1->heightsec);
 	fixed_t s1_floorheight_t2 = P_FloorHeight(t2->x, t2->y, s1->heightsec);
 	fixed_t s1_ceilingheight_t1 = P_CeilingHeight(t1->x, t1->y, s1->heightsec);
@@ -646,10 +723,13 @@ bool P_CrossSubsector (int num)
 		line = seg->linedef;
 		
 		// allready checked other side?
-		if (line->validcount == validcount)
-			continue;
-		
-		line->validcount = validcount;
+		if (!sightnomark)
+		{
+			if (line->validcount == validcount)
+				continue;
+
+			line->validcount = validcount;
+		}
 		
 		v1 = line->v1;
 		v2 = line->v2;
@@ -680,6 +760,9 @@ bool P_CrossSubsector (int num)
 		front = seg->frontsector;
 		back = seg->backsector;
 
+		P_MarkSightSector(front);
+		P_MarkSightSector(back);
+
 		frac = P_InterceptVector2 (&strace, &divl);
 		
 		// no wall to block sight with?
@@ -804,7 +887,8 @@ bool P_CheckSightDoom(const AActor* t1, const AActor* t2)
     // Check in REJECT table.
     if (!rejectempty && rejectmatrix[bytenum]&bitnum)
     {
-		sightcounts[0]++;
+		if (!sightnomark)
+			sightcounts[0]++;
 		
 		// can't possibly be connected
 		return false;	
@@ -812,9 +896,11 @@ bool P_CheckSightDoom(const AActor* t1, const AActor* t2)
 	
     // An unobstructed LOS is possible.
     // Now look from eyes of t1 to any part of t2.
-    sightcounts[1]++;
-	
-    validcount++;
+    if (!sightnomark)
+    {
+		sightcounts[1]++;
+		validcount++;
+    }
 	
     sightzstart = t1->z + t1->height - (t1->height>>2);
     topslope = (t2->z+t2->height) - sightzstart;
@@ -850,8 +936,17 @@ static bool P_CheckSightDoom
     // First check for trivial rejection.
 	
     // Determine subsector entries in REJECT table.
-    s1 = (P_PointInSubsector(x1, y1)->sector - sectors);
-    s2 = (P_PointInSubsector(x2, y2)->sector - sectors);
+    subsector_t *ss1 = P_PointInSubsector(x1, y1);
+    subsector_t *ss2 = P_PointInSubsector(x2, y2);
+
+    if (!P_PotentiallyVisible(ss1, ss2))
+    {
+		sightpvsrejects++;
+		return false;
+    }
+
+    s1 = (ss1->sector - sectors);
+    s2 = (ss2->sector - sectors);
     pnum = s1*numsectors + s2;
     bytenum = pnum>>3;
     bitnum = 1 << (pnum&7);
@@ -886,12 +981,168 @@ static bool P_CheckSightDoom
     return P_CrossBSPNode (numnodes-1);	
 }
 
+//
+// P_InvalidateSightMemo
+//
+// Called when something that can block sight moves.  A sector only makes
+// the results that crossed its region stale; without one, all of them are.
+//
+void P_InvalidateSightMemo(const sector_t *sector)
+{
+	sightgeneration++;
+
+	if (sector)
+		sightregiongeneration[P_SightRegion(sector)] = sightgeneration;
+	else
+		sightflushgeneration = sightgeneration;
+}
+
+static sightmemo_t &P_SightMemoSlot(const AActor *t1, const AActor *t2)
+{
+	size_t hash = ((size_t)t1 >> 4) * 2654435761u + ((size_t)t2 >> 4);
+	return sightmemo[(hash ^ (hash >> 12)) & (SIGHTMEMO_SIZE - 1)];
+}
+
+static bool P_SightRegionsUnchanged(const sightmemo_t &memo)
+{
+	if (memo.generation == sightgeneration)
+		return true;
+
+	if (memo.generation < sightflushgeneration)
+		return false;
+
+	for (int word = 0; word < SIGHTREGION_WORDS; word++)
+	{
+		int region = word * 32;
+		for (DWORD bits = memo.regions.bits[word]; bits; bits >>= 1, region++)
+		{
+			if ((bits & 1) && sightregiongeneration[region] > memo.generation)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static bool P_SightMemoValid(const sightmemo_t &memo, const AActor *t1, const AActor *t2, bool zdoom)
+{
+	return memo.t1 == t1 && memo.t2 == t2 && memo.tic == gametic && memo.zdoom == zdoom &&
+		memo.x1 == t1->x && memo.y1 == t1->y && memo.z1 == t1->z && memo.h1 == t1->height &&
+		memo.x2 == t2->x && memo.y2 == t2->y && memo.z2 == t2->z && memo.h2 == t2->height &&
+		P_SightRegionsUnchanged(memo);
+}
+
+static void P_SightMemoStore(sightmemo_t &memo, const AActor *t1, const AActor *t2, bool zdoom,
+							 bool result, const sightregions_t &regions)
+{
+	memo.t1 = t1;
+	memo.t2 = t2;
+	memo.x1 = t1->x;
+	memo.y1 = t1->y;
+	memo.z1 = t1->z;
+	memo.h1 = t1->height;
+	memo.x2 = t2->x;
+	memo.y2 = t2->y;
+	memo.z2 = t2->z;
+	memo.h2 = t2->height;
+	memo.tic = gametic;
+	memo.generation = sightgeneration;
+	memo.regions = regions;
+	memo.zdoom = zdoom;
+	memo.result = result;
+}
+
 bool P_CheckSight(const AActor* t1, const AActor* t2)
+{
+	if (!t1 || !t2 || !t1->subsector || !t2->subsector)
+		return false;
+
+	sightchecks++;
+
+	if (!P_PotentiallyVisible(t1->subsector, t2->subsector))
+	{
+		sightpvsrejects++;
+		return false;
+	}
+
+	bool zdoom = co_zdoomphys || HasBehavior;
+
+	sightmemo_t &memo = P_SightMemoSlot(t1, t2);
+	if (P_SightMemoValid(memo, t1, t2, zdoom))
+	{
+		sightmemohits++;
+		return memo.result;
+	}
+
+	sightcrossed = sightregions_t();
+	bool result = zdoom ? P_CheckSightZDoom(t1, t2) : P_CheckSightDoom(t1, t2);
+	P_SightMemoStore(memo, t1, t2, zdoom, result, sightcrossed);
+
+	return result;
+}
+
+static const size_t SIGHT_PREFETCH_CHUNK = 32;
+
+// regions crossed for each of the pairs being prefetched
+static std::vector<sightregions_t> prefetchregions;
+
+static void P_PrefetchSightJob(void *data, size_t index)
+{
+	std::vector<sightpair_t> &pairs = *(std::vector<sightpair_t> *)data;
+	size_t end = MIN(pairs.size(), (index + 1) * SIGHT_PREFETCH_CHUNK);
+
+	sightnomark = true;
+
+	for (size_t i = index * SIGHT_PREFETCH_CHUNK; i < end; i++)
+	{
+		sightpair_t &pair = pairs[i];
+		sightcrossed = sightregions_t();
+		pair.result = P_PotentiallyVisible(pair.t1->subsector, pair.t2->subsector) &&
+					  P_CheckSightDoom(pair.t1, pair.t2);
+		prefetchregions[i] = sightcrossed;
+	}
+
+	sightnomark = false;
+}
+
+//
+// P_PrefetchSight
+//
+// Checks the sight of many pairs of actors on the worker threads and puts
+// the results in the sight memo, where P_CheckSight finds them if nothing
+// has moved by the time it is called.  Only the Doom sight check can be run
+// this way; the ZDoom one shares its trace with the other line traversals.
+//
+void P_PrefetchSight(std::vector<sightpair_t> &pairs)
 {
 	if (co_zdoomphys || HasBehavior)
-		return P_CheckSightZDoom(t1, t2);
-	else
-		return P_CheckSightDoom(t1, t2);
+		return;
+
+	for (size_t i = 0; i < pairs.size(); )
+	{
+		const sightpair_t &pair = pairs[i];
+
+		if (!pair.t1->subsector || !pair.t2->subsector ||
+			P_SightMemoValid(P_SightMemoSlot(pair.t1, pair.t2), pair.t1, pair.t2, false))
+		{
+			pairs[i] = pairs.back();
+			pairs.pop_back();
+		}
+		else
+			i++;
+	}
+
+	prefetchregions.resize(pairs.size());
+
+	size_t chunks = (pairs.size() + SIGHT_PREFETCH_CHUNK - 1) / SIGHT_PREFETCH_CHUNK;
+	I_RunParallel(P_PrefetchSightJob, &pairs, chunks);
+
+	for (size_t i = 0; i < pairs.size(); i++)
+	{
+		const sightpair_t &pair = pairs[i];
+		P_SightMemoStore(P_SightMemoSlot(pair.t1, pair.t2), pair.t1, pair.t2, false, pair.result,
+						 prefetchregions[i]);
+	}
 }
 
 //
@@ -940,5 +1191,20 @@ bool P_CheckSightEdges(const AActor* t1, const AActor* t2, float radius_boost)
 		return P_CheckSightEdgesDoom(t1, t2, radius_boost);
 }
 
+BEGIN_COMMAND (sightstats)
+{
+	Printf(PRINT_HIGH, "%u sight checks: %u rejected by the PVS, %u remembered\n",
+			sightchecks, sightpvsrejects, sightmemohits);
+
+	if (subsectorpvs)
+		Printf(PRINT_HIGH, "PVS: %d subsectors, %u KB\n", numsubsectors,
+				(unsigned int)(pvsrowbytes * numsubsectors / 1024));
+	else
+		Printf(PRINT_HIGH, "PVS: not built for this map\n");
+
+	sightchecks = sightpvsrejects = sightmemohits = 0;
+}
+END_COMMAND (sightstats)
+
 VERSION_CONTROL (p_sight_cpp, "$Id$")
 
@@ -28,6 +28,7 @@
 #include "c_console.h"
 #include "doomstat.h"
 #include "p_unlag.h"
+#include "stats.h"
 
 //
 // P_AtInterval
@@ -47,6 +48,8 @@ void P_AnimationTick(AActor *mo);
 //
 void P_Ticker (void)
 {
+	PROFILE_SCOPE(P_Ticker);
+
 	if(paused)
 		return;
 
@@ -72,10 +75,16 @@ void P_Ticker (void)
 		P_AnimationTick(it->mo);
 	}
 
-	DThinker::RunThinkers ();
-	
-	P_UpdateSpecials ();
-	P_RespawnSpecials ();
+	{
+		PROFILE_SCOPE(RunThinkers);
+		DThinker::RunThinkers ();
+	}
+
+	{
+		PROFILE_SCOPE(P_UpdateSpecials);
+		P_UpdateSpecials ();
+		P_RespawnSpecials ();
+	}
 
 	if (clientside)
 		P_RunEffects ();	// [RH] Run particle effects
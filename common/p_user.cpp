@@ -1073,6 +1073,8 @@ player_s &player_s::operator =(const player_s &other)
 
 	blend_color = other.blend_color;
 
+	// the send buffers are about to be reallocated
+	client.flushPending();
 	client = other.client;
 
 	snapshots = other.snapshots;
@@ -761,6 +761,8 @@ void DoMovePolyobj (polyobj_t *po, int x, int y)
 	segList = po->segs;
 	prevPts = po->prevPts;
 
+	P_InvalidateSightMemo();
+
 	validcount++;
 	for (count = po->numsegs; count; count--, segList++, prevPts++)
 	{
@@ -835,6 +837,7 @@ BOOL PO_RotatePolyobj (int num, angle_t angle)
 	an = (po->angle+angle)>>ANGLETOFINESHIFT;
 
 	UnLinkPolyobj(po);
+	P_InvalidateSightMemo();
 
 	segList = po->segs;
 	originalPts = po->originalPts;
@@ -1054,8 +1057,13 @@ static BOOL CheckMobjBlocking (seg_t *seg, polyobj_t *po)
 	{
 		for (i = left; i <= right; i++)
 		{
-			for (mobj = blocklinks[j+i]; mobj; mobj = mobj->bmapnode.Next(i, j/bmapwidth))
+			blockthings_t &block = blockthings[j+i];
+
+			// newest first; ThrustMobj can move an actor out of the block,
+			// which moves the ones that were checked already down a place
+			for (size_t k = block.size(); k > 0; k = MIN(k - 1, block.size()))
 			{
+				mobj = block[k - 1];
 				if ((mobj->flags&MF_SOLID) && !(mobj->flags&MF_NOCLIP))
 				{
 					tmbbox[BOXTOP] = mobj->y+mobj->radius;
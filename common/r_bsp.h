@@ -25,20 +25,22 @@
 #ifndef __R_BSP__
 #define __R_BSP__
 
+#include "i_thread.h"
+
 extern const fixed_t NEARCLIP;
 
-extern seg_t*		curline;
-extern side_t*		sidedef;
-extern line_t*		linedef;
-extern sector_t*	frontsector;
-extern sector_t*	backsector;
+extern THREAD_LOCAL seg_t*		curline;
+extern THREAD_LOCAL side_t*		sidedef;
+extern THREAD_LOCAL line_t*		linedef;
+extern THREAD_LOCAL sector_t*	frontsector;
+extern THREAD_LOCAL sector_t*	backsector;
 
 extern BOOL			skymap;
 
-extern drawseg_t	*drawsegs;
-extern drawseg_t*	ds_p;
+extern THREAD_LOCAL drawseg_t	*drawsegs;
+extern THREAD_LOCAL drawseg_t*	ds_p;
 
-extern byte			solidcol[MAXWIDTH];
+extern THREAD_LOCAL byte		solidcol[MAXWIDTH];
 
 typedef void (*drawfunc_t) (int start, int stop);
 
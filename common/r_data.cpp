@@ -246,9 +246,9 @@ void R_DrawColumnInCache(const tallpost_t *post, byte *cache,
 
 void R_GenerateComposite (int texnum)
 {
-	byte *block = (byte *)Z_Malloc (texturecompositesize[texnum], PU_STATIC,
-						   (void **) &texturecomposite[texnum]);
-	texturecomposite[texnum] = block;
+	// Not published in texturecomposite until it has been built, so that
+	// the threads drawing the view never see a partly built texture.
+	byte *block = (byte *)Z_Malloc (texturecompositesize[texnum], PU_STATIC, NULL);
 	texture_t *texture = textures[texnum];
 
 	// Composite the columns together.
@@ -325,6 +325,9 @@ void R_GenerateComposite (int texnum)
 	delete [] marks;
 	delete [] tmpdata;
 
+	Z_ChangeOwner(block, &texturecomposite[texnum]);
+	texturecomposite[texnum] = block;
+
 	// Now that the texture has been built in column cache,
 	// it is purgable from zone memory.
 
@@ -436,12 +439,49 @@ void R_GenerateLookup(int texnum, int *const errors)
 	delete [] postcount;
 }
 
+static I_Mutex cache_mutex;
+
+//
+// R_CacheLock
+//
+R_CacheLock::R_CacheLock() : locked(I_InParallel())
+{
+	if (locked)
+		cache_mutex.lock();
+}
+
+R_CacheLock::~R_CacheLock()
+{
+	if (locked)
+		cache_mutex.unlock();
+}
+
+//
+// R_CachePatch
+//
+// W_CachePatch for the renderer.  A patch that is already cached is used
+// as it is while drawing the view in parallel, without taking the lock.
+//
+patch_t* R_CachePatch(unsigned lumpnum)
+{
+	if (I_InParallel())
+	{
+		if (lumpnum < numlumps && lumpcache[lumpnum])
+			return (patch_t*)lumpcache[lumpnum];
+
+		R_CacheLock lock;
+		return W_CachePatch(lumpnum, PU_CACHE);
+	}
+
+	return W_CachePatch(lumpnum, PU_CACHE);
+}
+
 //
 // R_GetPatchColumn
 //
 tallpost_t* R_GetPatchColumn(int lumpnum, int colnum)
 {
-	patch_t* patch = W_CachePatch(lumpnum, PU_CACHE);
+	patch_t* patch = R_CachePatch(lumpnum);
 	return (tallpost_t*)((byte*)patch + LELONG(patch->columnofs[colnum]));
 }
 
@@ -463,10 +503,14 @@ tallpost_t* R_GetTextureColumn(int texnum, int colnum)
 	int ofs = texturecolumnofs[texnum][colnum];
 
 	if (lump > 0)
-		return (tallpost_t*)((byte *)W_CachePatch(lump, PU_CACHE) + ofs);
+		return (tallpost_t*)((byte *)R_CachePatch(lump) + ofs);
 
 	if (!texturecomposite[texnum])
-		R_GenerateComposite(texnum);
+	{
+		R_CacheLock lock;
+		if (!texturecomposite[texnum])
+			R_GenerateComposite(texnum);
+	}
 
 	return (tallpost_t*)(texturecomposite[texnum] + ofs);
 }
@@ -28,6 +28,7 @@
 
 #include "r_defs.h"
 #include "r_state.h"
+#include "i_thread.h"
 
 
 // On the Alpha, accessing the shorts directly if they aren't aligned on a
@@ -85,6 +86,29 @@ extern byte* textureheightmask;
 extern fixed_t* texturescalex;
 extern fixed_t* texturescaley;
 
+//
+// R_CacheLock
+//
+// Held while the threads drawing slices of the view load lumps or build
+// composite textures, since the zone and the lump cache are not thread-safe.
+// Does nothing outside of I_RunParallel.
+//
+class R_CacheLock
+{
+public:
+	R_CacheLock();
+	~R_CacheLock();
+
+private:
+	bool	locked;
+
+	// not copyable
+	R_CacheLock(const R_CacheLock &);
+	R_CacheLock &operator =(const R_CacheLock &);
+};
+
+patch_t* R_CachePatch(unsigned lumpnum);
+
 // Retrieve column data for span blitting.
 tallpost_t* R_GetPatchColumn(int lumpnum, int colnum);
 byte* R_GetPatchColumnData(int lumpnum, int colnum);
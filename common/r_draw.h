@@ -27,6 +27,7 @@
 
 #include "r_intrin.h"
 #include "r_defs.h"
+#include "i_thread.h"
 
 typedef struct 
 {
@@ -55,7 +56,10 @@ typedef struct
 	palindex_t			color;				// for r_drawflat
 } drawcolumn_t;
 
-extern "C" drawcolumn_t dcol;
+// Each thread drawing a slice of the view points these at its own column and
+// span state (see R_RenderPlayerView)
+extern "C" THREAD_LOCAL drawcolumn_t* r_dcol;
+#define dcol (*r_dcol)
 
 typedef struct
 {
@@ -89,7 +93,8 @@ typedef struct
 	palindex_t			color;
 } drawspan_t;
 
-extern "C" drawspan_t dspan;
+extern "C" THREAD_LOCAL drawspan_t* r_dspan;
+#define dspan (*r_dspan)
 
 
 // [RH] Temporary buffer for column drawing
@@ -136,10 +141,7 @@ void	R_DrawTranslatedColumnP (void);
 void	R_DrawSpanP (void);
 void	R_DrawSlopeSpanIdealP_C (void);
 
-void	R_DrawColumnD (void);
 void	R_DrawFuzzColumnD (void);
-void	R_DrawTranslucentColumnD (void);
-void	R_DrawTranslatedColumnD (void);
 
 void	R_DrawTlatedLucentColumnP (void);
 #define R_DrawTlatedLucentColumn R_DrawTlatedLucentColumnP
@@ -152,6 +154,9 @@ void	R_BlankSpan (void);
 void	R_FillSpanP (void);
 void	R_FillSpanD (void);
 
+void R_DrawColumnD_c(void);
+void R_DrawTranslucentColumnD_c(void);
+void R_DrawTranslatedColumnD_c(void);
 void R_DrawSpanD_c(void);
 void R_DrawSlopeSpanD_c(void);
 
@@ -174,6 +179,15 @@ void R_DrawSlopeSpanD_MMX(void);
 void r_dimpatchD_MMX(IWindowSurface*, argb_t color, int alpha, int x1, int y1, int w, int h);
 #endif
 
+#ifdef __AVX2_DRAWERS__
+bool R_HasAVX2(void);
+void R_DrawColumnD_AVX2(void);
+void R_DrawTranslucentColumnD_AVX2(void);
+void R_DrawTranslatedColumnD_AVX2(void);
+void R_DrawSpanD_AVX2(void);
+void R_DrawSlopeSpanD_AVX2(void);
+#endif
+
 #ifdef __ALTIVEC__
 void R_DrawSpanD_ALTIVEC(void);
 void R_DrawSlopeSpanD_ALTIVEC(void);
@@ -181,6 +195,9 @@ void r_dimpatchD_ALTIVEC(IWindowSurface*, argb_t color, int alpha, int x1, int y
 #endif
 
 // Vectorizable function pointers:
+extern void (*R_DrawColumnD)(void);
+extern void (*R_DrawTranslucentColumnD)(void);
+extern void (*R_DrawTranslatedColumnD)(void);
 extern void (*R_DrawSpanD)(void);
 extern void (*R_DrawSlopeSpanD)(void);
 extern void (*r_dimpatchD)(IWindowSurface* surface, argb_t color, int alpha, int x1, int y1, int w, int h);
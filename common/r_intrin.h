@@ -58,4 +58,17 @@
 	#endif
 #endif
 
+// The compiler flags do not assume AVX2. R_AVX2_TARGET builds a function for
+// it anyway, so that the AVX2 drawers can be chosen at run time on processors
+// that have it.
+#if defined(_MSC_VER) && (_MSC_VER >= 1800) && (defined(_M_IX86) || defined(_M_X64))
+	#define __AVX2_DRAWERS__
+	#define R_AVX2_TARGET
+#elif (defined(__i386__) || defined(__x86_64__)) && \
+	((defined(__clang__) && __clang_major__ >= 4) || \
+	(!defined(__clang__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+	#define __AVX2_DRAWERS__
+	#define R_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
 #endif
@@ -31,6 +31,7 @@
 #include "v_palette.h"
 #include "m_vectors.h"
 #include "v_video.h"
+#include "i_thread.h"
 
 // killough 10/98: special mask indicates sky flat comes from sidedef
 #define PL_SKYFLAT (0x80000000)
@@ -51,7 +52,7 @@ extern int				viewheight;
 extern int				viewwindowx;
 extern int				viewwindowy;
 
-extern bool				r_fakingunderwater;
+extern THREAD_LOCAL bool	r_fakingunderwater;
 extern bool				r_underwater;
 
 extern int				centerx;
@@ -61,7 +62,15 @@ extern fixed_t			centerxfrac;
 extern fixed_t			centeryfrac;
 extern fixed_t			yaspectmul;
 
-extern shaderef_t		basecolormap;	// [RH] Colormap for sector currently being drawn
+// One for each thread drawing a slice of the view
+extern THREAD_LOCAL shaderef_t*	r_basecolormap;
+
+// [RH] Colormap for sector currently being drawn
+#define basecolormap (*r_basecolormap)
+
+// The columns of the view drawn by the current thread
+extern THREAD_LOCAL int	viewslicestart;
+extern THREAD_LOCAL int	viewslicestop;
 
 extern int				validcount;
 
@@ -100,7 +109,7 @@ extern int				scalelightfixed[MAXLIGHTSCALE];
 extern int				zlight[LIGHTLEVELS][MAXLIGHTZ];
 
 extern int				extralight;
-extern BOOL				foggy;
+extern THREAD_LOCAL BOOL	foggy;
 extern int				fixedlightlev;
 extern shaderef_t		fixedcolormap;
 
@@ -116,9 +125,9 @@ extern int				lightscaleymul;
 //
 // Function pointers to switch refresh/drawing functions.
 //
-extern void 			(*colfunc) (void);
-extern void 			(*spanfunc) (void);
-extern void				(*spanslopefunc) (void);
+extern THREAD_LOCAL void	(*colfunc) (void);
+extern THREAD_LOCAL void	(*spanfunc) (void);
+extern THREAD_LOCAL void	(*spanslopefunc) (void);
 
 
 //
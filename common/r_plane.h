@@ -26,6 +26,7 @@
 #define __R_PLANE_H__
 
 #include "r_data.h"
+#include "i_thread.h"
 
 // Visplane related.
 extern	int*			lastopening;
@@ -35,8 +36,8 @@ typedef void (*planefunction_t) (int top, int bottom);
 extern planefunction_t	floorfunc;
 extern planefunction_t	ceilingfunc_t;
 
-extern int  			*floorclip;
-extern int  			*ceilingclip;
+extern THREAD_LOCAL int	*floorclip;
+extern THREAD_LOCAL int	*ceilingclip;
 extern int				*floorclipinitial;
 extern int				*ceilingclipinitial;
 
@@ -28,6 +28,7 @@
 // Need data structure definitions.
 #include "d_player.h"
 #include "r_data.h"
+#include "i_thread.h"
 
 #define WALLFRACBITS	4
 #define WALLFRACUNIT	(1<<WALLFRACBITS)
@@ -138,9 +139,9 @@ extern angle_t			clipangle;
 
 //extern fixed_t		finetangent[FINEANGLES/2];
 
-extern visplane_t*		floorplane;
-extern visplane_t*		ceilingplane;
-extern visplane_t*		skyplane;
+extern THREAD_LOCAL visplane_t*	floorplane;
+extern THREAD_LOCAL visplane_t*	ceilingplane;
+extern THREAD_LOCAL visplane_t*	skyplane;
 
 // [AM] 4:3 Field of View
 extern int				FieldOfView;
@@ -25,6 +25,8 @@
 #ifndef __R_THINGS__
 #define __R_THINGS__
 
+#include "i_thread.h"
+
 // [RH] Particle details
 struct particle_s {
 	fixed_t	x,y,z;
@@ -69,17 +71,17 @@ void R_DrawParticle(vissprite_t*);
 void R_ProjectParticle (particle_t *, const sector_t* sector, int fakeside);
 void R_FindParticleSubsectors();
 
-extern int MaxVisSprites;
+extern THREAD_LOCAL int MaxVisSprites;
 
-extern vissprite_t		*vissprites;
-extern vissprite_t* 	vissprite_p;
+extern THREAD_LOCAL vissprite_t	*vissprites;
+extern THREAD_LOCAL vissprite_t* vissprite_p;
 extern vissprite_t		vsprsortedhead;
 
 // vars for R_DrawMaskedColumn
-extern int*			mfloorclip;
-extern int*			mceilingclip;
-extern fixed_t		spryscale;
-extern fixed_t		sprtopscreen;
+extern THREAD_LOCAL int*		mfloorclip;
+extern THREAD_LOCAL int*		mceilingclip;
+extern THREAD_LOCAL fixed_t	spryscale;
+extern THREAD_LOCAL fixed_t	sprtopscreen;
 
 extern fixed_t		pspritexscale;
 extern fixed_t		pspriteyscale;
@@ -93,6 +95,7 @@ void R_DrawSprites (void);
 void R_InitSprites (const char** namelist);
 void R_ClearSprites (void);
 void R_DrawMasked (void);
+void R_DrawPlayerSprites (void);
 
 #endif
 
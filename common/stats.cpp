@@ -32,6 +32,9 @@
 #include "m_swap.h"
 #include "stats.h"
 #include "i_system.h"
+#include "i_thread.h"
+#include "doomdef.h"
+#include "doomstat.h"
 
 std::vector<FStat*> FStat::stats;
 
@@ -101,6 +104,503 @@ BEGIN_COMMAND (stat)
 }
 END_COMMAND (stat)
 
+//
+// Tic profiler
+//
+
+struct profevent_t
+{
+	FProfileStat	*stat;
+	dtime_t			start;		// from the start of the tic
+	dtime_t			elapsed;
+};
+
+struct proftic_t
+{
+	proftic_t() : gametic(0), start(0), elapsed(0) {}
+
+	int							gametic;
+	dtime_t						start;
+	dtime_t						elapsed;
+	std::vector<profevent_t>	events;
+};
+
+static const dtime_t PROFILE_BUDGET = 1000000000 / TICRATE;
+
+// one more than the tics that are kept, for the tic being measured
+static const size_t PROFILE_SLOTS = PROFILE_TICS + 1;
+
+static proftic_t proftics[PROFILE_SLOTS];
+static size_t proftic_slot = 0;			// the slot of the current tic
+static size_t proftic_count = 0;		// number of tics kept
+static unsigned int prof_overruns = 0;	// since the last reset
+static bool prof_resetpending = false;
+
+static bool profiling = false;
+static THREAD_LOCAL bool prof_thread = false;
+static std::vector<FProfileStat*> profstack;
+
+// scopes in code that runs on worker threads can be constructed there
+static I_Mutex profstats_mutex;
+
+std::vector<FProfileStat*> FProfileStat::stats;
+
+FProfileStat::FProfileStat (const char *cname)
+: parent(NULL), depth(-1), ticelapsed(0), history(PROFILE_SLOTS, 0),
+  start(0), entered(0), name(cname)
+{
+	I_MutexLock lock(profstats_mutex);
+	stats.push_back(this);
+}
+
+FProfileStat::~FProfileStat ()
+{
+	I_MutexLock lock(profstats_mutex);
+	std::vector<FProfileStat*>::iterator i = std::find(stats.begin(), stats.end(), this);
+
+	if(i != stats.end())
+		stats.erase(i);
+}
+
+//
+// FProfileStat::enter
+//
+// Returns false if the scope is not being measured.
+//
+bool FProfileStat::enter()
+{
+	if (!profiling || !prof_thread || I_InParallel())
+		return false;
+
+	// the first time it is entered decides where it goes in the tree
+	if (depth < 0)
+	{
+		parent = profstack.empty() ? NULL : profstack.back();
+		depth = parent ? parent->depth + 1 : 0;
+	}
+
+	if (entered++ == 0)
+		start = I_GetTime();
+
+	profstack.push_back(this);
+	return true;
+}
+
+void FProfileStat::leave()
+{
+	profstack.pop_back();
+
+	if (--entered > 0)
+		return;
+
+	profevent_t ev;
+	ev.stat = this;
+	ev.start = start - proftics[proftic_slot].start;
+	ev.elapsed = I_GetTime() - start;
+
+	ticelapsed += ev.elapsed;
+	proftics[proftic_slot].events.push_back(ev);
+}
+
+const char *FProfileStat::getname() const
+{
+	return name.c_str();
+}
+
+std::string FProfileStat::getpath() const
+{
+	return parent ? parent->getpath() + "/" + name : name;
+}
+
+void FProfileStat::endtic(size_t slot)
+{
+	for (size_t i = 0; i < stats.size(); i++)
+	{
+		stats[i]->history[slot] = stats[i]->ticelapsed;
+		stats[i]->ticelapsed = 0;
+	}
+}
+
+void FProfileStat::reset()
+{
+	for (size_t i = 0; i < stats.size(); i++)
+		std::fill(stats[i]->history.begin(), stats[i]->history.end(), 0);
+}
+
+const std::vector<FProfileStat*> &FProfileStat::getstats()
+{
+	return stats;
+}
+
+static void Prof_Reset();
+
+//
+// Prof_BeginTic
+//
+// Starts measuring a tic on the calling thread if enable is set.  A tic
+// that was never ended, because an error was thrown through it, is
+// discarded first.
+//
+void Prof_BeginTic(bool enable)
+{
+	if (profiling)
+		Prof_DiscardTic();
+
+	if (!enable)
+		return;
+
+	proftic_t &tic = proftics[proftic_slot];
+
+	tic.gametic = gametic;
+	tic.events.clear();
+	tic.elapsed = 0;
+
+	profiling = true;
+	prof_thread = true;
+
+	tic.start = I_GetTime();
+}
+
+//
+// Prof_EndTic
+//
+void Prof_EndTic()
+{
+	if (!profiling)
+		return;
+
+	proftic_t &tic = proftics[proftic_slot];
+	tic.elapsed = I_GetTime() - tic.start;
+
+	if (tic.elapsed > PROFILE_BUDGET)
+		prof_overruns++;
+
+	FProfileStat::endtic(proftic_slot);
+
+	proftic_slot = (proftic_slot + 1) % PROFILE_SLOTS;
+	if (proftic_count < PROFILE_TICS)
+		proftic_count++;
+
+	profiling = false;
+	prof_thread = false;
+
+	if (prof_resetpending)
+		Prof_Reset();
+}
+
+//
+// Prof_DiscardTic
+//
+// Stops measuring the current tic without keeping it.
+//
+void Prof_DiscardTic()
+{
+	if (!profiling)
+		return;
+
+	proftics[proftic_slot].events.clear();
+	proftics[proftic_slot].elapsed = 0;
+
+	const std::vector<FProfileStat*> &stats = FProfileStat::getstats();
+	for (size_t i = 0; i < stats.size(); i++)
+		stats[i]->ticelapsed = 0;
+	profstack.clear();
+
+	profiling = false;
+	prof_thread = false;
+
+	if (prof_resetpending)
+		Prof_Reset();
+}
+
+// The slot of the last tic that was measured
+static size_t Prof_LastSlot()
+{
+	return (proftic_slot + PROFILE_SLOTS - 1) % PROFILE_SLOTS;
+}
+
+//
+// Prof_LastTic
+//
+dtime_t Prof_LastTic()
+{
+	return proftic_count ? proftics[Prof_LastSlot()].elapsed : 0;
+}
+
+dtime_t Prof_LastTic(const FProfileStat *stat)
+{
+	return proftic_count ? stat->history[Prof_LastSlot()] : 0;
+}
+
+//
+// Prof_Reset
+//
+// Forgets every tic that was kept.  During a tic, which is when console
+// commands run on the server, this waits until the end of the tic.
+//
+static void Prof_Reset()
+{
+	if (profiling)
+	{
+		prof_resetpending = true;
+		return;
+	}
+
+	prof_resetpending = false;
+	proftic_slot = proftic_count = 0;
+	prof_overruns = 0;
+
+	for (size_t i = 0; i < PROFILE_SLOTS; i++)
+	{
+		proftics[i] = proftic_t();
+	}
+
+	FProfileStat::reset();
+}
+
+// The slot of the i'th oldest tic that is kept
+static size_t Prof_Slot(size_t i)
+{
+	return (proftic_slot + PROFILE_SLOTS - proftic_count + i) % PROFILE_SLOTS;
+}
+
+static double Prof_Ms(dtime_t ns)
+{
+	return ns / 1000000.0;
+}
+
+struct profsummary_t
+{
+	dtime_t p50, p99, max, total;
+};
+
+static profsummary_t Prof_Summarize(std::vector<dtime_t> values)
+{
+	profsummary_t sum = { 0, 0, 0, 0 };
+
+	if (values.empty())
+		return sum;
+
+	for (size_t i = 0; i < values.size(); i++)
+		sum.total += values[i];
+
+	std::sort(values.begin(), values.end());
+	sum.p50 = values[(values.size() - 1) / 2];
+	sum.p99 = values[(values.size() - 1) * 99 / 100];
+	sum.max = values.back();
+
+	return sum;
+}
+
+static profsummary_t Prof_SummarizeTics()
+{
+	std::vector<dtime_t> values;
+	for (size_t i = 0; i < proftic_count; i++)
+		values.push_back(proftics[Prof_Slot(i)].elapsed);
+
+	return Prof_Summarize(values);
+}
+
+static profsummary_t Prof_SummarizeStat(const FProfileStat *stat)
+{
+	std::vector<dtime_t> values;
+	for (size_t i = 0; i < proftic_count; i++)
+		values.push_back(stat->history[Prof_Slot(i)]);
+
+	return Prof_Summarize(values);
+}
+
+static unsigned int Prof_CountOverruns()
+{
+	unsigned int count = 0;
+	for (size_t i = 0; i < proftic_count; i++)
+		if (proftics[Prof_Slot(i)].elapsed > PROFILE_BUDGET)
+			count++;
+
+	return count;
+}
+
+// The kept tic that took the longest
+static size_t Prof_WorstSlot()
+{
+	size_t worst = Prof_Slot(0);
+	for (size_t i = 1; i < proftic_count; i++)
+		if (proftics[Prof_Slot(i)].elapsed > proftics[worst].elapsed)
+			worst = Prof_Slot(i);
+
+	return worst;
+}
+
+// Adds the scopes under parent to list, depth first
+static void Prof_AddChildren(std::vector<FProfileStat*> &list, const FProfileStat *parent)
+{
+	const std::vector<FProfileStat*> &stats = FProfileStat::getstats();
+
+	for (size_t i = 0; i < stats.size(); i++)
+	{
+		if (stats[i]->depth >= 0 && stats[i]->parent == parent)
+		{
+			list.push_back(stats[i]);
+			Prof_AddChildren(list, stats[i]);
+		}
+	}
+}
+
+static std::vector<FProfileStat*> Prof_Tree()
+{
+	std::vector<FProfileStat*> list;
+	Prof_AddChildren(list, NULL);
+	return list;
+}
+
+//
+// Prof_WriteJSON
+//
+static bool Prof_WriteJSON(const char *filename)
+{
+	FILE *f = fopen(filename, "w");
+	if (!f)
+		return false;
+
+	profsummary_t tics = Prof_SummarizeTics();
+
+	fprintf(f, "{\n");
+	fprintf(f, "\t\"tics\": %u,\n", (unsigned int)proftic_count);
+	fprintf(f, "\t\"budget_ms\": %.3f,\n", Prof_Ms(PROFILE_BUDGET));
+	fprintf(f, "\t\"overruns\": %u,\n", Prof_CountOverruns());
+	fprintf(f, "\t\"overruns_since_reset\": %u,\n", prof_overruns);
+	fprintf(f, "\t\"tic\": {\"p50_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f",
+			Prof_Ms(tics.p50), Prof_Ms(tics.p99), Prof_Ms(tics.max));
+
+	if (proftic_count)
+	{
+		const proftic_t &worst = proftics[Prof_WorstSlot()];
+		fprintf(f, ", \"worst_gametic\": %d", worst.gametic);
+	}
+
+	fprintf(f, "},\n");
+	fprintf(f, "\t\"scopes\": [");
+
+	std::vector<FProfileStat*> tree = Prof_Tree();
+	for (size_t i = 0; i < tree.size(); i++)
+	{
+		profsummary_t sum = Prof_SummarizeStat(tree[i]);
+
+		fprintf(f, "%s\n\t\t{\"name\": \"%s\", \"path\": \"%s\", \"depth\": %d, "
+				"\"p50_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f, \"total_ms\": %.3f}",
+				i ? "," : "", tree[i]->getname(), tree[i]->getpath().c_str(), tree[i]->depth,
+				Prof_Ms(sum.p50), Prof_Ms(sum.p99), Prof_Ms(sum.max), Prof_Ms(sum.total));
+	}
+
+	fprintf(f, "\n\t]\n}\n");
+	fclose(f);
+
+	return true;
+}
+
+//
+// Prof_WriteTrace
+//
+// Writes the kept tics in the Trace Event format that chrome://tracing and
+// other trace viewers load.  Every tic is an event of its own, with the
+// scopes that were entered during it inside.
+//
+static bool Prof_WriteTrace(const char *filename)
+{
+	FILE *f = fopen(filename, "w");
+	if (!f)
+		return false;
+
+	fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+
+	dtime_t origin = proftic_count ? proftics[Prof_Slot(0)].start : 0;
+	bool first = true;
+
+	for (size_t i = 0; i < proftic_count; i++)
+	{
+		const proftic_t &tic = proftics[Prof_Slot(i)];
+		double ticstart = (tic.start - origin) / 1000.0;
+
+		fprintf(f, "%s\n{\"name\": \"tic\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, "
+				"\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"gametic\": %d}}",
+				first ? "" : ",", tic.elapsed > PROFILE_BUDGET ? "overrun" : "tic",
+				ticstart, tic.elapsed / 1000.0, tic.gametic);
+		first = false;
+
+		for (size_t j = 0; j < tic.events.size(); j++)
+		{
+			const profevent_t &ev = tic.events[j];
+
+			fprintf(f, ",\n{\"name\": \"%s\", \"cat\": \"scope\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, "
+					"\"ts\": %.3f, \"dur\": %.3f}",
+					ev.stat->getname(), ticstart + ev.start / 1000.0, ev.elapsed / 1000.0);
+		}
+	}
+
+	fprintf(f, "\n]}\n");
+	fclose(f);
+
+	return true;
+}
+
+BEGIN_COMMAND (profile)
+{
+	if (argc > 1 && !stricmp(argv[1], "reset"))
+	{
+		Prof_Reset();
+		return;
+	}
+
+	if (argc > 1 && (!stricmp(argv[1], "json") || !stricmp(argv[1], "trace")))
+	{
+		bool json = !stricmp(argv[1], "json");
+		std::string filename = argc > 2 ? std::string(argv[2]) :
+			I_GetUserFileName(json ? "profile.json" : "profile-trace.json");
+
+		if (json ? Prof_WriteJSON(filename.c_str()) : Prof_WriteTrace(filename.c_str()))
+			Printf(PRINT_HIGH, "Wrote %u tics to %s\n", (unsigned int)proftic_count, filename.c_str());
+		else
+			Printf(PRINT_HIGH, "Could not write %s\n", filename.c_str());
+		return;
+	}
+
+	if (argc > 1)
+	{
+		Printf(PRINT_HIGH, "Usage: profile [reset | json [file] | trace [file]]\n");
+		return;
+	}
+
+	if (proftic_count == 0)
+	{
+		Printf(PRINT_HIGH, "No tics have been profiled\n");
+		return;
+	}
+
+	profsummary_t tics = Prof_SummarizeTics();
+	size_t worstslot = Prof_WorstSlot();
+
+	Printf(PRINT_HIGH, "%u tics, %u over the %.2f ms budget (%u since reset)\n",
+			(unsigned int)proftic_count, Prof_CountOverruns(), Prof_Ms(PROFILE_BUDGET), prof_overruns);
+	Printf(PRINT_HIGH, "%-32s %9s %9s %9s %9s\n", "ms per tic", "p50", "p99", "max", "worst");
+	Printf(PRINT_HIGH, "%-32s %9.3f %9.3f %9.3f %9.3f\n", "tic",
+			Prof_Ms(tics.p50), Prof_Ms(tics.p99), Prof_Ms(tics.max),
+			Prof_Ms(proftics[worstslot].elapsed));
+
+	std::vector<FProfileStat*> tree = Prof_Tree();
+	for (size_t i = 0; i < tree.size(); i++)
+	{
+		profsummary_t sum = Prof_SummarizeStat(tree[i]);
+		std::string label = std::string(2 * (tree[i]->depth + 1), ' ') + tree[i]->getname();
+
+		Printf(PRINT_HIGH, "%-32s %9.3f %9.3f %9.3f %9.3f\n", label.c_str(),
+				Prof_Ms(sum.p50), Prof_Ms(sum.p99), Prof_Ms(sum.max),
+				Prof_Ms(tree[i]->history[worstslot]));
+	}
+
+	Printf(PRINT_HIGH, "The worst tic was gametic %d\n", proftics[worstslot].gametic);
+}
+END_COMMAND (profile)
+
 
 VERSION_CONTROL (stats_cpp, "$Id$")
 
@@ -29,6 +29,8 @@
 #include <string>
 #include <algorithm>
 
+#include "doomtype.h"
+
 class FStat
 {
 public:
@@ -61,6 +63,82 @@ private:
 
 #define END_STAT(n) Stat_var_##n.unclock();
 
+//
+// Tic profiler
+//
+// PROFILE_SCOPE measures the time until the end of the enclosing block.
+// Scopes nest: a scope belongs to the one that was open when it was first
+// entered.  For each of the last PROFILE_TICS tics, the time spent in each
+// scope during that tic is kept, along with every entry into a scope for
+// the trace.  Only the thread that called Prof_BeginTic is measured, and
+// nothing is measured outside of Prof_BeginTic and Prof_EndTic.
+//
+static const size_t PROFILE_TICS = 35 * 30;
+
+class FProfileStat
+{
+public:
+	FProfileStat (const char *cname);
+	virtual ~FProfileStat ();
+
+	bool enter();
+	void leave();
+
+	const char *getname() const;
+	std::string getpath() const;
+
+	static void endtic(size_t slot);
+	static void reset();
+	static const std::vector<FProfileStat*> &getstats();
+
+	FProfileStat			*parent;
+	int						depth;
+
+	dtime_t					ticelapsed;		// during the current tic
+	std::vector<dtime_t>	history;		// per tic, 0 if not entered
+
+private:
+	dtime_t					start;
+	int						entered;		// recursion depth
+	std::string				name;
+
+	static std::vector<FProfileStat*> stats;
+};
+
+class FProfileScope
+{
+public:
+	FProfileScope (FProfileStat &s) : stat(s.enter() ? &s : NULL) {}
+	~FProfileScope () { if (stat) stat->leave(); }
+
+private:
+	FProfileStat *stat;
+};
+
+#define PROFILE_SCOPE(n) \
+	static FProfileStat ProfileStat_##n (#n); \
+	FProfileScope ProfileScope_##n (ProfileStat_##n);
+
+void Prof_BeginTic (bool enable);
+void Prof_EndTic (void);
+void Prof_DiscardTic (void);
+
+// Measures a tic until end() is called.  A tic that is left without calling
+// end(), such as one an error is thrown through, is discarded.
+class FProfileTic
+{
+public:
+	FProfileTic (bool enable) { Prof_BeginTic(enable); }
+	~FProfileTic () { Prof_DiscardTic(); }
+
+	void end () { Prof_EndTic(); }
+};
+
+// The length of the last tic that was measured and the time spent in a scope
+// during it
+dtime_t Prof_LastTic (void);
+dtime_t Prof_LastTic (const FProfileStat *stat);
+
 #endif //__STATS_H__
 
 
@@ -33,10 +33,15 @@
 
 #ifdef _WIN32
 #include <io.h>
+#include "win32inc.h"
 #else
 #define strcmpi	strcasecmp
 #endif
 
+#ifdef UNIX
+#include <sys/mman.h>
+#endif
+
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -74,6 +79,20 @@ void**			lumpcache;
 
 static unsigned	stdisk_lumpnum;
 
+// The WAD files that are mapped into memory, so that their lumps can be
+// read without seeking and used in place.
+typedef struct
+{
+	FILE		*handle;
+	void		*base;
+	size_t		length;
+#if defined(_WIN32) && !defined(_XBOX)
+	HANDLE		mapping;
+#endif
+} wadmapping_t;
+
+static std::vector<wadmapping_t> wadmappings;
+
 //
 // W_LumpNameHash
 //
@@ -171,6 +190,70 @@ std::string W_MD5(std::string filename)
 }
 
 
+//
+// W_MapFile
+//
+// Maps the whole file into memory read-only.  Returns NULL if the file can't
+// be mapped, in which case its lumps are read with fread.  -nowadmap turns
+// the mapping off.
+//
+static const byte* W_MapFile(FILE* handle)
+{
+	if (Args.CheckParm("-nowadmap"))
+		return NULL;
+
+	SDWORD length = M_FileLength(handle);
+	if (length <= 0)
+		return NULL;
+
+	wadmapping_t map;
+	map.handle = handle;
+	map.length = length;
+
+#if defined(_WIN32) && !defined(_XBOX)
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno(handle));
+
+	map.mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (map.mapping == NULL)
+		return NULL;
+
+	map.base = MapViewOfFile(map.mapping, FILE_MAP_READ, 0, 0, 0);
+	if (map.base == NULL)
+	{
+		CloseHandle(map.mapping);
+		return NULL;
+	}
+#elif defined(UNIX)
+	map.base = mmap(NULL, map.length, PROT_READ, MAP_SHARED, fileno(handle), 0);
+	if (map.base == MAP_FAILED)
+		return NULL;
+#else
+	return NULL;
+#endif
+
+	wadmappings.push_back(map);
+	return (const byte*)map.base;
+}
+
+//
+// W_UnmapFiles
+//
+static void W_UnmapFiles()
+{
+	for (size_t i = 0; i < wadmappings.size(); i++)
+	{
+#if defined(_WIN32) && !defined(_XBOX)
+		UnmapViewOfFile(wadmappings[i].base);
+		CloseHandle(wadmappings[i].mapping);
+#elif defined(UNIX)
+		munmap(wadmappings[i].base, wadmappings[i].length);
+#endif
+	}
+
+	wadmappings.clear();
+}
+
+
 //
 // LUMP BASED ROUTINES.
 //
@@ -190,6 +273,9 @@ void W_AddLumps(FILE* handle, filelump_t* fileinfo, size_t newlumps, bool client
 	lumpinfo_t* lump = &lumpinfo[numlumps];
 	filelump_t* info = &fileinfo[0];
 
+	const byte* base = W_MapFile(handle);
+	const SDWORD filelength = base ? M_FileLength(handle) : 0;
+
 	for (size_t i = 0; i < newlumps; i++, info++)
 	{
 		lump->handle = handle;
@@ -197,6 +283,13 @@ void W_AddLumps(FILE* handle, filelump_t* fileinfo, size_t newlumps, bool client
 		lump->size = info->size;
 		strncpy(lump->name, info->name, 8);
 
+		// lumps that don't fit in the file are left to W_ReadLump to report
+		if (base && info->filepos >= 0 && info->size >= 0 &&
+			info->filepos <= filelength - info->size)
+			lump->data = base + info->filepos;
+		else
+			lump->data = NULL;
+
 		lump++;
 		numlumps++;
 	}
@@ -363,6 +456,7 @@ void W_MergeLumps (const char *start, const char *end, int space)
 					newlumps++;
 					strncpy (newlumpinfos[0].name, ustart, 8);
 					newlumpinfos[0].handle = NULL;
+					newlumpinfos[0].data = NULL;
 					newlumpinfos[0].position =
 						newlumpinfos[0].size = 0;
 					newlumpinfos[0].namespc = ns_global;
@@ -431,6 +525,7 @@ void W_MergeLumps (const char *start, const char *end, int space)
 
 		strncpy (lumpinfo[numlumps].name, uend, 8);
 		lumpinfo[numlumps].handle = NULL;
+		lumpinfo[numlumps].data = NULL;
 		lumpinfo[numlumps].position =
 			lumpinfo[numlumps].size = 0;
 		lumpinfo[numlumps].namespc = ns_global;
@@ -597,6 +692,12 @@ void W_ReadLump(unsigned int lump, void* dest)
 
 	l = lumpinfo + lump;
 
+	if (l->data)
+	{
+		memcpy(dest, l->data, l->size);
+		return;
+	}
+
 	if (lump != stdisk_lumpnum)
     	I_BeginRead();
 
@@ -699,6 +800,39 @@ void* W_CacheLumpName(const char* name, int tag)
 	return W_CacheLumpNum (W_GetNumForName(name), tag);
 }
 
+//
+// W_MapLumpNum
+//
+// Returns a read-only view of the lump for callers that don't modify it.
+// If the WAD file is mapped, this points into the mapping and nothing is
+// copied.  Otherwise the lump is read into the zone with PU_STATIC, the
+// same as W_CacheLumpNum.  Either way, pass the view to W_UnmapLump when
+// done with it.  Unlike W_CacheLumpNum, the lump is not zero-terminated.
+//
+// Lumps can start at any offset in the file.  The callers read views
+// through the map structures in doomdata.h, which are made of shorts, so a
+// lump at an odd offset is copied as well.
+//
+const void* W_MapLumpNum(unsigned int lump)
+{
+	if (lump >= numlumps)
+		I_Error ("W_MapLumpNum: %i >= numlumps", lump);
+
+	if (lumpinfo[lump].data && (size_t)lumpinfo[lump].data % sizeof(short) == 0)
+		return lumpinfo[lump].data;
+
+	return W_CacheLumpNum(lump, PU_STATIC);
+}
+
+//
+// W_UnmapLump
+//
+void W_UnmapLump(unsigned int lump, const void* data)
+{
+	if (lump < numlumps && data != lumpinfo[lump].data)
+		Z_Free((void*)data);
+}
+
 size_t R_CalculateNewPatchSize(patch_t *patch, size_t length);
 void R_ConvertPatch(patch_t *rawpatch, patch_t *newpatch);
 
@@ -727,17 +861,26 @@ patch_t* W_CachePatch(unsigned lumpnum, int tag)
 		if (newlumplen > 0)
 		{
 			// valid patch
-			lumpcache[lumpnum] = (byte *)Z_Malloc(newlumplen + 1, tag, &lumpcache[lumpnum]);
-			patch_t *newpatch = (patch_t*)lumpcache[lumpnum];
-			*((unsigned char*)lumpcache[lumpnum] + newlumplen) = 0;
+			// Not published in lumpcache until it has been converted, so
+			// that the threads drawing the view never see a partial patch.
+			patch_t *newpatch = (patch_t*)Z_Malloc(newlumplen + 1, PU_STATIC, NULL);
+			*((unsigned char*)newpatch + newlumplen) = 0;
 
 			R_ConvertPatch(newpatch, rawpatch);
+
+			Z_ChangeOwner(newpatch, &lumpcache[lumpnum]);
+			lumpcache[lumpnum] = newpatch;
+			Z_ChangeTag(newpatch, tag);
 		}
 		else
 		{
 			// invalid patch - just create a header with width = 0, height = 0
-			lumpcache[lumpnum] = Z_Malloc(sizeof(patch_t), tag, &lumpcache[lumpnum]);
-			memset(lumpcache[lumpnum], 0, sizeof(patch_t));
+			void *newpatch = Z_Malloc(sizeof(patch_t), PU_STATIC, NULL);
+			memset(newpatch, 0, sizeof(patch_t));
+
+			Z_ChangeOwner(newpatch, &lumpcache[lumpnum]);
+			lumpcache[lumpnum] = newpatch;
+			Z_ChangeTag(newpatch, tag);
 		}
 
 		delete [] rawlumpdata;
@@ -807,6 +950,8 @@ void W_Close ()
 		}
 		lump_p++;
 	}
+
+	W_UnmapFiles();
 }
 
 VERSION_CONTROL (w_wad_cpp, "$Id$")
@@ -69,6 +69,7 @@ typedef struct lumpinfo_s
 	FILE		*handle;
 	int			position;
 	int			size;
+	const byte	*data;		// lump in the mapped WAD file or NULL
 
 	// [RH] Hashing stuff
 	int			next;
@@ -101,6 +102,10 @@ unsigned	W_ReadChunk (const char *file, unsigned offs, unsigned len, void *dest,
 
 void *W_CacheLumpNum (unsigned lump, int tag);
 void *W_CacheLumpName (const char *name, int tag);
+
+// Read-only view of a lump, valid until W_UnmapLump or W_Close.
+const void *W_MapLumpNum (unsigned lump);
+void W_UnmapLump (unsigned lump, const void *data);
 patch_t* W_CachePatch (unsigned lump, int tag = PU_CACHE);
 patch_t* W_CachePatch (const char *name, int tag = PU_CACHE);
 
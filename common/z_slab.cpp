@@ -0,0 +1,203 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Slab allocator for thinkers
+//
+//-----------------------------------------------------------------------------
+
+#include <vector>
+
+#include "doomtype.h"
+#include "z_zone.h"
+#include "z_slab.h"
+#include "c_console.h"
+
+static const size_t NUMSLABCLASSES = Z_SLAB_MAXSIZE / Z_SLAB_GRANULE;
+
+struct slabclass_t
+{
+	slabclass_t() : freelist(NULL), next(NULL), end(NULL), live(0), peak(0), allocs(0) {}
+
+	void				*freelist;	// freed objects, linked through their first word
+	byte				*next;		// unused part of the newest slab
+	byte				*end;
+	std::vector<byte *>	slabs;
+
+	size_t				live;		// objects allocated and not freed
+	size_t				peak;
+	unsigned int		allocs;		// since the program started
+};
+
+static slabclass_t slabclasses[NUMSLABCLASSES];
+static bool slabs_enabled = true;
+
+static size_t Z_SlabClass(size_t size)
+{
+	return (size + Z_SLAB_GRANULE - 1) / Z_SLAB_GRANULE - 1;
+}
+
+static size_t Z_SlabClassSize(size_t index)
+{
+	return (index + 1) * Z_SLAB_GRANULE;
+}
+
+//
+// Z_InitSlabs
+//
+// Called by Z_Init.  With -nozone, every object gets its own allocation so
+// that memory analysis tools can track them.  This can only change while no
+// objects are allocated from the slabs.
+//
+void Z_InitSlabs(bool enable)
+{
+	for (size_t i = 0; i < NUMSLABCLASSES; i++)
+		if (slabclasses[i].live)
+			return;
+
+	slabs_enabled = enable;
+	Z_TrimSlabs();
+}
+
+//
+// Z_SlabAlloc
+//
+void* Z_SlabAlloc(size_t size)
+{
+	if (!slabs_enabled || size == 0 || size > Z_SLAB_MAXSIZE)
+		return Z_Malloc(size, PU_LEVSPEC, 0);
+
+	size_t index = Z_SlabClass(size);
+	size_t classsize = Z_SlabClassSize(index);
+	slabclass_t &sc = slabclasses[index];
+
+	void *ptr;
+
+	if (sc.freelist)
+	{
+		ptr = sc.freelist;
+		sc.freelist = *(void **)ptr;
+	}
+	else
+	{
+		if (sc.next + classsize > sc.end)
+		{
+			byte *slab = new byte[Z_SLAB_SIZE];
+			sc.slabs.push_back(slab);
+			sc.next = slab;
+			sc.end = slab + (Z_SLAB_SIZE / classsize) * classsize;
+		}
+
+		ptr = sc.next;
+		sc.next += classsize;
+	}
+
+	sc.allocs++;
+	if (++sc.live > sc.peak)
+		sc.peak = sc.live;
+
+	return ptr;
+}
+
+//
+// Z_SlabFree
+//
+// The size must be the one the object was allocated with.
+//
+void Z_SlabFree(void *ptr, size_t size)
+{
+	if (ptr == NULL)
+		return;
+
+	if (!slabs_enabled || size == 0 || size > Z_SLAB_MAXSIZE)
+	{
+		Z_Free(ptr);
+		return;
+	}
+
+	slabclass_t &sc = slabclasses[Z_SlabClass(size)];
+
+	*(void **)ptr = sc.freelist;
+	sc.freelist = ptr;
+	sc.live--;
+}
+
+//
+// Z_TrimSlabs
+//
+// Gives the slabs of every size that has no objects left back to the
+// system, such as after the thinkers of a level have been destroyed.
+//
+void Z_TrimSlabs()
+{
+	for (size_t i = 0; i < NUMSLABCLASSES; i++)
+	{
+		slabclass_t &sc = slabclasses[i];
+
+		if (sc.live)
+			continue;
+
+		for (size_t j = 0; j < sc.slabs.size(); j++)
+			delete [] sc.slabs[j];
+
+		sc.slabs.clear();
+		sc.freelist = NULL;
+		sc.next = sc.end = NULL;
+	}
+}
+
+//
+// Z_PrintSlabSummary
+//
+void Z_PrintSlabSummary()
+{
+	size_t live = 0, peak = 0, slabs = 0;
+
+	for (size_t i = 0; i < NUMSLABCLASSES; i++)
+	{
+		live += slabclasses[i].live;
+		peak += slabclasses[i].peak;
+		slabs += slabclasses[i].slabs.size();
+	}
+
+	Printf(PRINT_HIGH, "slabs: %u objects in use (peak %u), %u KB in %u slabs%s\n",
+			(unsigned int)live, (unsigned int)peak,
+			(unsigned int)(slabs * Z_SLAB_SIZE / 1024), (unsigned int)slabs,
+			slabs_enabled ? "" : " (disabled)");
+}
+
+//
+// Z_DumpSlabs
+//
+void Z_DumpSlabs()
+{
+	Z_PrintSlabSummary();
+
+	for (size_t i = 0; i < NUMSLABCLASSES; i++)
+	{
+		const slabclass_t &sc = slabclasses[i];
+
+		if (!sc.allocs)
+			continue;
+
+		Printf(PRINT_HIGH, "size:%5u    live:%6u    peak:%6u    slabs:%4u    allocs:%u\n",
+				(unsigned int)Z_SlabClassSize(i), (unsigned int)sc.live,
+				(unsigned int)sc.peak, (unsigned int)sc.slabs.size(), sc.allocs);
+	}
+}
+
+VERSION_CONTROL (z_slab_cpp, "$Id$")
@@ -0,0 +1,46 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Slab allocator for thinkers
+//
+//	Objects are grouped by size, rounded up to Z_SLAB_GRANULE bytes, and
+//	each size is carved out of large slabs.  Freed objects go on a free
+//	list for their size and are handed out again before a new slab is
+//	allocated, so spawning and destroying actors does not touch the zone.
+//	Sizes above Z_SLAB_MAXSIZE, and every size when the zone is disabled
+//	with -nozone, are passed on to Z_Malloc.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __Z_SLAB_H__
+#define __Z_SLAB_H__
+
+#include <stddef.h>
+
+static const size_t Z_SLAB_GRANULE = 16;
+static const size_t Z_SLAB_MAXSIZE = 2048;
+static const size_t Z_SLAB_SIZE = 64 * 1024;
+
+void	Z_InitSlabs (bool enable);
+void*	Z_SlabAlloc (size_t size);
+void	Z_SlabFree (void *ptr, size_t size);
+void	Z_TrimSlabs (void);
+void	Z_PrintSlabSummary (void);
+void	Z_DumpSlabs (void);
+
+#endif // __Z_SLAB_H__
@@ -25,10 +25,13 @@
 #include <stdlib.h>
 
 #include "z_zone.h"
+#include "z_slab.h"
+#include "dthinker.h"
 #include "i_system.h"
 #include "doomdef.h"
 #include "c_dispatch.h"
 #include "hashtable.h"
+#include "i_thread.h"
 
 static bool use_zone = true;
 
@@ -121,6 +124,7 @@ static FauxZone faux_zone;
 // 
 
 #define ZONEID	0x1d4a11
+#define HEAPID	0x1d4a12
 
 typedef struct
 {
@@ -137,6 +141,11 @@ typedef struct
 static memzone_t* mainzone;
 static size_t zonesize;
 
+// Blocks allocated on the system heap because the zone was full while its
+// purgable blocks could not be thrown out (see Z_Malloc).
+static memblock_t heapblocks;
+static size_t heapallocations;
+
 //
 // Z_Close
 //
@@ -152,6 +161,8 @@ void STACK_ARGS Z_Close()
 void Z_Init(bool _use_zone)
 {
 	use_zone = _use_zone;
+	Z_InitSlabs(use_zone);
+
 	if (!use_zone)
 	{
 		Z_Close();
@@ -177,6 +188,68 @@ void Z_Init(bool _use_zone)
 	block->user = NULL;
 	
 	block->size = mainzone->size - sizeof(memzone_t);
+
+	if (heapblocks.next == NULL)
+		heapblocks.next = heapblocks.prev = &heapblocks;
+}
+
+
+//
+// Z_MallocHeap
+//
+// Allocates a block on the system heap with the same header as a zone
+// block, for when the zone is full and may not be purged.
+//
+static void* Z_MallocHeap(size_t size, int tag, void* user, const char* file, int line)
+{
+	memblock_t* block = (memblock_t*)malloc(size);
+	if (block == NULL)
+		I_FatalError("Z_Malloc: failed on allocation of %i bytes at %s:%i", size, file, line);
+
+	block->size = size;
+	block->tag = tag;
+	block->user = (void**)user;
+	block->id = HEAPID;
+	heapallocations++;
+
+	block->prev = &heapblocks;
+	block->next = heapblocks.next;
+	block->next->prev = block;
+	heapblocks.next = block;
+
+	if (user)
+		*(void**)user = (void*)((byte*)block + sizeof(memblock_t));
+
+	return (void*)((byte*)block + sizeof(memblock_t));
+}
+
+//
+// Z_HeapAllocations
+//
+// Returns the number of blocks that have been allocated on the system heap
+// because the zone was full while it could not be purged.
+//
+size_t Z_HeapAllocations()
+{
+	return heapallocations;
+}
+
+//
+// Z_FreeHeapTags
+//
+// Frees the heap blocks with tags between lowtag and hightag.
+//
+static void Z_FreeHeapTags(int lowtag, int hightag)
+{
+	memblock_t* next;
+
+	for (memblock_t* block = heapblocks.next; block != &heapblocks; block = next)
+	{
+		next = block->next;
+
+		if (block->tag >= lowtag && block->tag <= hightag)
+			Z_Free((byte*)block + sizeof(memblock_t));
+	}
 }
 
 
@@ -197,6 +270,18 @@ void Z_Free2(void* ptr, const char* file, int line)
 
 	memblock_t* block = (memblock_t*)((byte*)ptr - sizeof(memblock_t));
 
+	if (block->id == HEAPID)
+	{
+		if (block->user != NULL)
+			*block->user = NULL;
+
+		block->prev->next = block->next;
+		block->next->prev = block->prev;
+		block->id = 0;
+		free(block);
+		return;
+	}
+
 	if (block->id != ZONEID)
 		I_FatalError("Z_Free: freed a pointer without ZONEID at %s:%i", file, line);
 
@@ -244,6 +329,11 @@ void Z_Free2(void* ptr, const char* file, int line)
 // Z_Malloc
 // You can pass a NULL user if the tag is < PU_PURGELEVEL.
 //
+// While the renderer runs in parallel, other threads can be using purgable
+// blocks they looked up without a lock, so none are thrown out.  If the zone
+// is full the block comes from the system heap instead, and the purgable
+// heap blocks are freed by the next allocation outside the parallel region.
+//
 #define MINFRAGMENT	64
 #define ALIGN		8
 
@@ -261,6 +351,13 @@ void* Z_Malloc2(size_t size, int tag, void* user, const char* file, int line)
 	if (tag == PU_FREE)
 		I_FatalError("Z_Malloc: cannot allocate a block with tag PU_FREE at %s:%i", file, line);
 
+	if (tag >= PU_PURGELEVEL && user == NULL)
+		I_FatalError("Z_Malloc: an owner is required for purgable blocks at %s:%i", file, line);
+
+	const bool nopurge = I_InParallel();
+	if (!nopurge && heapblocks.next != &heapblocks)
+		Z_FreeHeapTags(PU_PURGELEVEL, PU_CACHE);
+
 	size = (size + ALIGN - 1) & ~(ALIGN - 1);
 
     // scan through the block list,
@@ -285,12 +382,15 @@ void* Z_Malloc2(size_t size, int tag, void* user, const char* file, int line)
 		if (rover == start)
 		{
 			// scanned all the way around the list
+			if (nopurge)
+				return Z_MallocHeap(size, tag, user, file, line);
+
 			I_FatalError("Z_Malloc: failed on allocation of %i bytes at %s:%i", size, file, line);
 		}
 		
 		if (rover->tag != PU_FREE)
 		{
-			if (rover->tag < PU_PURGELEVEL)
+			if (rover->tag < PU_PURGELEVEL || nopurge)
 			{
 				// hit a block that can't be purged,
 				//  so move past it
@@ -336,9 +436,6 @@ void* Z_Malloc2(size_t size, int tag, void* user, const char* file, int line)
 
 	if (user)
 		*(void**)user = (void*)((byte*)base + sizeof(memblock_t));
-	else
-		if (tag >= PU_PURGELEVEL)
-			I_FatalError("Z_Malloc: an owner is required for purgable blocks at %s:%i", file, line);
 
 	// next allocation will start looking here
 	mainzone->rover = base->next;
@@ -381,6 +478,8 @@ void Z_FreeTags(int lowtag, int hightag)
 			Z_Free((byte*)block+sizeof(memblock_t));
 	}
 
+	Z_FreeHeapTags(lowtag, hightag);
+
 	#ifdef ODAMEX_DEBUG
 	Z_CheckHeap();
 	#endif
@@ -421,7 +520,7 @@ void Z_ChangeTag2(void* ptr, int tag, const char* file, int line)
 		return;
 
 	memblock_t*	block = (memblock_t*)((byte*)ptr - sizeof(memblock_t));
-	if (block->id != ZONEID)
+	if (block->id != ZONEID && block->id != HEAPID)
 		I_Error("Z_ChangeTag: block does not have a proper ID at %s:%i", file, line);
 
 	if (tag == PU_FREE)
@@ -440,7 +539,7 @@ void Z_ChangeOwner2(void* ptr, void* user, const char* file, int line)
 		return;
 	
 	memblock_t*	block = (memblock_t*)((byte*)ptr - sizeof(memblock_t));
-	if (block->id != ZONEID)
+	if (block->id != ZONEID && block->id != HEAPID)
 		I_Error("Z_ChangeOwner: block does not have a proper ID at %s:%i", file, line);
 
 	if (block->tag >= PU_PURGELEVEL && user == NULL)
@@ -592,6 +691,8 @@ BEGIN_COMMAND (dumpheap)
 	}
 
 	Z_DumpHeap(lo, hi);
+	Z_DumpSlabs();
+	DThinker::DumpClassStats();
 }
 END_COMMAND (dumpheap)
 
@@ -615,6 +716,8 @@ BEGIN_COMMAND (mem)
 			usedpblocks + usedeblocks, pfree + efree,
 			largestpfree > largestefree ? largestpfree : largestefree
 			);
+
+	Z_PrintSlabSummary();
 }
 END_COMMAND (mem)
 
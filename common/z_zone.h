@@ -51,6 +51,7 @@ void	Z_FreeTags (int lowtag, int hightag);
 void	Z_DumpHeap (int lowtag, int hightag);
 void	Z_CheckHeap (void);
 size_t 	Z_FreeMemory (void);
+size_t	Z_HeapAllocations (void);
 
 // Don't use these, use the macros instead!
 void*   Z_Malloc2 (size_t size, int tag, void *user, const char *file, int line);
@@ -53,6 +53,7 @@
 #include "sv_main.h"
 #include "p_ctf.h"
 #include "gi.h"
+#include "stats.h"
 
 #define SAVESTRINGSIZE	24
 
@@ -269,6 +270,8 @@ int mapchange;
 
 void G_Ticker (void)
 {
+	PROFILE_SCOPE(G_Ticker);
+
 	// do player reborns if needed
 	if (serverside)
 	{
@@ -578,7 +578,7 @@ void G_DoResetLevel(bool full_reset)
 			if (mo->netid && mo->type != MT_PLAYER)
 			{
 				ServerNetID.ReleaseNetID(mo->netid);
-				mo->netid = 0;
+				P_SetThingId(mo, 0);
 			}
 		}
 	}
@@ -610,7 +610,7 @@ void G_DoResetLevel(bool full_reset)
 		{
 			if (mo->netid && mo->type != MT_PLAYER)
 			{
-				mo->netid = ServerNetID.ObtainNetID();
+				P_SetThingId(mo, ServerNetID.ObtainNetID());
 			}
 		}
 	}
@@ -772,13 +772,11 @@ void G_DoLoadLevel (int position)
 	}
 
 	// initialize the msecnode_t freelist.					phares 3/25/98
-	// any nodes in the freelist are gone by now, cleared
-	// by Z_FreeTags() when the previous level ended or player
-	// died.
+	// the nodes of the previous level go back to the pool,
+	// so no actor may hold on to them.
 
 	{
-		extern msecnode_t *headsecnode; // phares 3/25/98
-		headsecnode = NULL;
+		P_ClearSecnodes ();
 
 		// denis - todo - wtf is this crap?
 		// [RH] Need to prevent the AActor destructor from trying to
@@ -792,7 +790,7 @@ void G_DoLoadLevel (int position)
 
 			// denis - clear every actor netid so that they don't announce their destruction to clients
 			ServerNetID.ReleaseNetID(actor->netid);
-			actor->netid = 0;
+			P_SetThingId(actor, 0);
 		}
 	}
 
@@ -109,7 +109,7 @@ int				lightscaleymul;
 int			extralight;
 
 // [RH] ignore extralight and fullbright
-BOOL		foggy;
+THREAD_LOCAL BOOL	foggy;
 
 fixed_t			freelookviewheight;
 
@@ -117,13 +117,13 @@ fixed_t		render_lerp_amount;
 
 unsigned int	R_OldBlend = ~0;
 
-void (*colfunc) (void);
+THREAD_LOCAL void (*colfunc) (void);
 void (*basecolfunc) (void);
 void (*fuzzcolfunc) (void);
 void (*lucentcolfunc) (void);
 void (*transcolfunc) (void);
 void (*tlatedlucentcolfunc) (void);
-void (*spanfunc) (void);
+THREAD_LOCAL void (*spanfunc) (void);
 
 void (*hcolfunc_pre) (void);
 void (*hcolfunc_post1) (int hx, int sx, int yl, int yh);
@@ -251,10 +251,10 @@ void R_InitSpriteDefs (const char **namelist)
 //
 // GAME FUNCTIONS
 //
-int				MaxVisSprites;
-vissprite_t 	*vissprites;
-vissprite_t		*vissprite_p;
-vissprite_t		*lastvissprite;
+THREAD_LOCAL int			MaxVisSprites;
+THREAD_LOCAL vissprite_t	*vissprites;
+THREAD_LOCAL vissprite_t	*vissprite_p;
+THREAD_LOCAL vissprite_t	*lastvissprite;
 int 			newvissprite;
 
 
@@ -114,6 +114,21 @@ CVAR_RANGE_FUNC_DECL(sv_maxrate, "200", "Forces clients to be on or below this r
 CVAR_RANGE_FUNC_DECL(sv_waddownloadcap, "200", "Cap wad file downloading to a specific rate",
 				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 7.0f, 100000.0f)
 
+CVAR_FUNC_DECL(	sv_batchio, "1", "Read and send packets in batches to reduce system calls (Linux only)",
+				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
+
+CVAR(			sv_netdelta, "1", "Send player and monster movement as deltas to clients that support it",
+				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
+
+CVAR(			sv_netrelevance, "1", "Update monsters and missiles that are far from or hidden from a client less often",
+				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
+
+CVAR_RANGE_FUNC_DECL(sv_netthreads, "0", "Number of threads that build and compress client packets, 0 or 1 uses the main thread only",
+				CVARTYPE_BYTE, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 64.0f)
+
+CVAR(			sv_profiler, "0", "Time each tic of the server for the profile command",
+				CVARTYPE_BOOL, CVAR_NULL)
+
 #ifdef ODA_HAVE_MINIUPNP
 CVAR(			sv_upnp, "1", "Enable UPnP support",
 				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
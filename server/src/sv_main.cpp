@@ -65,6 +65,10 @@
 #include "g_warmup.h"
 #include "sv_banlist.h"
 #include "d_main.h"
+#include "hashtable.h"
+#include "i_thread.h"
+#include "stats.h"
+#include "p_pvs.h"
 
 #include <algorithm>
 #include <sstream>
@@ -98,6 +102,7 @@ EXTERN_CVAR(sv_motd)
 EXTERN_CVAR(sv_hostname)
 EXTERN_CVAR(sv_email)
 EXTERN_CVAR(sv_website)
+EXTERN_CVAR(sv_profiler)
 EXTERN_CVAR(sv_waddownload)
 EXTERN_CVAR(sv_maxrate)
 EXTERN_CVAR(sv_emptyreset)
@@ -108,6 +113,9 @@ EXTERN_CVAR(sv_allowtargetnames)
 EXTERN_CVAR(sv_flooddelay)
 EXTERN_CVAR(sv_ticbuffer)
 EXTERN_CVAR(sv_warmup)
+EXTERN_CVAR(sv_netdelta)
+EXTERN_CVAR(sv_netthreads)
+EXTERN_CVAR(sv_netrelevance)
 
 void SexMessage (const char *from, char *to, int gender,
 	const char *victim, const char *killer);
@@ -268,6 +276,17 @@ CVAR_FUNC_IMPL(sv_maxrate)
 	}
 }
 
+CVAR_FUNC_IMPL (sv_batchio)
+{
+	NET_SetBatchIO(var);
+}
+
+CVAR_FUNC_IMPL (sv_netthreads)
+{
+	// the main thread builds packets too
+	I_SetWorkerThreads(var > 1 ? (size_t)var - 1 : 0);
+}
+
 CVAR_FUNC_IMPL (sv_waddownloadcap)
 {
 	// sv_waddownloadcap can not be larger than sv_maxrate
@@ -510,17 +529,84 @@ Players::iterator SV_GetFreeClient(void)
 	return --it;
 }
 
-player_t &SV_FindPlayerByAddr(void)
+//
+// Player address index
+//
+// Every incoming datagram has to be matched to the client that sent it,
+// so keep a hash table from network address to player instead of walking the
+// players list for each packet.  player_t objects live in a std::list, so
+// pointers to them stay valid until the player is erased.
+//
+typedef OHashTable<unsigned long long, player_t*> PlayerAddressTable;
+static PlayerAddressTable player_addresses;
+
+static inline unsigned long long SV_AddressKey(const netadr_t &addr)
 {
-	for (Players::iterator it = players.begin();it != players.end();++it)
-	{
-		if (NET_CompareAdr(it->client.address, net_from))
-		   return *it;
-	}
+	return ((unsigned long long)addr.ip[0] << 40) | ((unsigned long long)addr.ip[1] << 32) |
+		   ((unsigned long long)addr.ip[2] << 24) | ((unsigned long long)addr.ip[3] << 16) |
+		   addr.port;
+}
+
+//
+// SV_SetPlayerAddress
+//
+// Assigns a network address to a client and updates the address index.
+//
+static void SV_SetPlayerAddress(player_t &player, const netadr_t &addr)
+{
+	SV_UnindexPlayerAddress(player);
+
+	player.client.address = addr;
+	player_addresses[SV_AddressKey(addr)] = &player;
+}
+
+//
+// SV_UnindexPlayerAddress
+//
+// Removes a client from the address index.  Must be called before the
+// player is erased from the players list.
+//
+void SV_UnindexPlayerAddress(player_t &player)
+{
+	PlayerAddressTable::iterator it =
+		player_addresses.find(SV_AddressKey(player.client.address));
+
+	if (it != player_addresses.end() && it->second == &player)
+		player_addresses.erase(it);
+}
+
+//
+// SV_FindPlayerByAddr
+//
+// Returns the client connected from the given address, or an invalid
+// player if there is none.
+//
+player_t &SV_FindPlayerByAddr(const netadr_t &addr)
+{
+	PlayerAddressTable::iterator it = player_addresses.find(SV_AddressKey(addr));
+
+	if (it != player_addresses.end())
+		return *(it->second);
 
 	return idplayer(0);
 }
 
+player_t &SV_FindPlayerByAddr(void)
+{
+	return SV_FindPlayerByAddr(net_from);
+}
+
+//
+// SV_ClearPlayers
+//
+// Empties the players list along with the address index.
+//
+static void SV_ClearPlayers()
+{
+	players.clear();
+	player_addresses.clear();
+}
+
 //
 // SV_CheckTimeouts
 // If a packet has not been received from a client in CLIENT_TIMEOUT
@@ -572,6 +658,8 @@ Players::iterator SV_RemoveDisconnectedPlayer(Players::iterator it)
 		it->mo = AActor::AActorPtr();
 	}
 
+	SV_UnindexPlayerAddress(*it);
+
 	// remove this player from the global players vector
 	Players::iterator next;
 	next = players.erase(it);
@@ -590,6 +678,8 @@ Players::iterator SV_RemoveDisconnectedPlayer(Players::iterator it)
 //
 void SV_GetPackets()
 {
+	PROFILE_SCOPE(SV_GetPackets);
+
 	while (NET_GetPacket())
 	{
 		player_t &player = SV_FindPlayerByAddr();
@@ -654,17 +744,17 @@ void SV_Sound (AActor *mo, byte channel, const char *name, byte attenuation)
 	{
 		cl = &(it->client);
 
-		MSG_WriteMarker (&cl->netbuf, svc_startsound);
+		buf_t *buf = SV_StartMessage(cl, NETPRI_COSMETIC, svc_startsound);
 		if(mo)
-			MSG_WriteShort (&cl->netbuf, mo->netid);
+			MSG_WriteShort (buf, mo->netid);
 		else
-			MSG_WriteShort (&cl->netbuf, 0);
-		MSG_WriteLong (&cl->netbuf, x);
-		MSG_WriteLong (&cl->netbuf, y);
-		MSG_WriteByte (&cl->netbuf, channel);
-		MSG_WriteByte (&cl->netbuf, sfx_id);
-		MSG_WriteByte (&cl->netbuf, attenuation);
-		MSG_WriteByte (&cl->netbuf, 255); // client calculates volume on its own
+			MSG_WriteShort (buf, 0);
+		MSG_WriteLong (buf, x);
+		MSG_WriteLong (buf, y);
+		MSG_WriteByte (buf, channel);
+		MSG_WriteByte (buf, sfx_id);
+		MSG_WriteByte (buf, attenuation);
+		MSG_WriteByte (buf, 255); // client calculates volume on its own
 	}
 
 }
@@ -690,17 +780,17 @@ void SV_Sound (player_t &pl, AActor *mo, byte channel, const char *name, byte at
 
 	client_t *cl = &pl.client;
 
-	MSG_WriteMarker (&cl->netbuf, svc_startsound);
+	buf_t *buf = SV_StartMessage(cl, NETPRI_COSMETIC, svc_startsound);
 	if (mo == NULL)
-		MSG_WriteShort (&cl->netbuf, 0);
+		MSG_WriteShort (buf, 0);
 	else
-		MSG_WriteShort (&cl->netbuf, mo->netid);
-	MSG_WriteLong (&cl->netbuf, x);
-	MSG_WriteLong (&cl->netbuf, y);
-	MSG_WriteByte (&cl->netbuf, channel);
-	MSG_WriteByte (&cl->netbuf, sfx_id);
-	MSG_WriteByte (&cl->netbuf, attenuation);
-	MSG_WriteByte (&cl->netbuf, 255);		// client calculates volume on its own
+		MSG_WriteShort (buf, mo->netid);
+	MSG_WriteLong (buf, x);
+	MSG_WriteLong (buf, y);
+	MSG_WriteByte (buf, channel);
+	MSG_WriteByte (buf, sfx_id);
+	MSG_WriteByte (buf, attenuation);
+	MSG_WriteByte (buf, 255);		// client calculates volume on its own
 }
 
 //
@@ -732,14 +822,14 @@ void UV_SoundAvoidPlayer (AActor *mo, byte channel, const char *name, byte atten
 
 		cl = &(it->client);
 
-		MSG_WriteMarker(&cl->netbuf, svc_startsound);
-		MSG_WriteShort(&cl->netbuf, mo->netid);
-		MSG_WriteLong(&cl->netbuf, mo->x);
-		MSG_WriteLong(&cl->netbuf, mo->y);
-		MSG_WriteByte(&cl->netbuf, channel);
-		MSG_WriteByte(&cl->netbuf, sfx_id);
-		MSG_WriteByte(&cl->netbuf, attenuation);
-		MSG_WriteByte(&cl->netbuf, 255); // client calculates volume on its own
+		buf_t *buf = SV_StartMessage(cl, NETPRI_COSMETIC, svc_startsound);
+		MSG_WriteShort(buf, mo->netid);
+		MSG_WriteLong(buf, mo->x);
+		MSG_WriteLong(buf, mo->y);
+		MSG_WriteByte(buf, channel);
+		MSG_WriteByte(buf, sfx_id);
+		MSG_WriteByte(buf, attenuation);
+		MSG_WriteByte(buf, 255); // client calculates volume on its own
 	}
 }
 
@@ -767,15 +857,15 @@ void SV_SoundTeam (byte channel, const char* name, byte attenuation, int team)
 		{
 			cl = &(it->client);
 
-			MSG_WriteMarker(&cl->netbuf, svc_startsound);
+			buf_t *buf = SV_StartMessage(cl, NETPRI_COSMETIC, svc_startsound);
 			// Set netid to 0 since it's not a sound originating from any player's location
-			MSG_WriteShort(&cl->netbuf, 0); // netid
-			MSG_WriteLong(&cl->netbuf, 0); // x
-			MSG_WriteLong(&cl->netbuf, 0); // y
-			MSG_WriteByte(&cl->netbuf, channel);
-			MSG_WriteByte(&cl->netbuf, sfx_id);
-			MSG_WriteByte(&cl->netbuf, attenuation);
-			MSG_WriteByte(&cl->netbuf, 255); // client calculates volume on its own
+			MSG_WriteShort(buf, 0); // netid
+			MSG_WriteLong(buf, 0); // x
+			MSG_WriteLong(buf, 0); // y
+			MSG_WriteByte(buf, channel);
+			MSG_WriteByte(buf, sfx_id);
+			MSG_WriteByte(buf, attenuation);
+			MSG_WriteByte(buf, 255); // client calculates volume on its own
 		}
 	}
 }
@@ -800,13 +890,13 @@ void SV_Sound (fixed_t x, fixed_t y, byte channel, const char *name, byte attenu
 
 		cl = &(it->client);
 
-		MSG_WriteMarker(&cl->netbuf, svc_soundorigin);
-		MSG_WriteLong(&cl->netbuf, x);
-		MSG_WriteLong(&cl->netbuf, y);
-		MSG_WriteByte(&cl->netbuf, channel);
-		MSG_WriteByte(&cl->netbuf, sfx_id);
-		MSG_WriteByte(&cl->netbuf, attenuation);
-		MSG_WriteByte(&cl->netbuf, 255); // client calculates volume on its own
+		buf_t *buf = SV_StartMessage(cl, NETPRI_COSMETIC, svc_soundorigin);
+		MSG_WriteLong(buf, x);
+		MSG_WriteLong(buf, y);
+		MSG_WriteByte(buf, channel);
+		MSG_WriteByte(buf, sfx_id);
+		MSG_WriteByte(buf, attenuation);
+		MSG_WriteByte(buf, 255); // client calculates volume on its own
 	}
 }
 
@@ -1217,6 +1307,7 @@ bool SV_AwarenessUpdate(player_t &player, AActor *mo)
 
 		MSG_WriteMarker (&cl->reliablebuf, svc_removemobj);
 		MSG_WriteShort (&cl->reliablebuf, mo->netid);
+		cl->delta.reset(mo->netid);
 
 		return true;
 	}
@@ -1245,6 +1336,27 @@ bool SV_AwarenessUpdate(player_t &player, AActor *mo)
 	return false;
 }
 
+//
+// Actor awareness accounting
+//
+// Counts the work done by SV_UpdateHiddenMobj each tic, which depends on the
+// number of actors spawned and of clients, not on the size of the map.
+//
+struct awareness_stats_t
+{
+	awareness_stats_t() : queued(0), drained(0), updated(0), walked(0), backlog(0) {}
+
+	unsigned int	queued;		// actors added to the clients' spawn queues
+	unsigned int	drained;	// queue entries processed
+	unsigned int	updated;	// actors spawned on or removed from a client
+	unsigned int	walked;		// thinkers walked by SV_QueueHiddenMobjs
+	unsigned int	backlog;	// queue entries left at the end of the tic
+};
+
+static awareness_stats_t awareness_stats;
+static awareness_stats_t tic_awareness_stats[TICRATE];
+static size_t tic_awareness_index = 0;
+
 //
 // [denis] SV_SpawnMobj
 // because you can't expect the constructors to send network messages!
@@ -1259,7 +1371,10 @@ void SV_SpawnMobj(AActor *mo)
 		if(mo->player)
 			SV_AwarenessUpdate(*it, mo);
 		else
+		{
 			it->to_spawn.push(mo->ptr());
+			awareness_stats.queued++;
+		}
 	}
 }
 
@@ -1280,46 +1395,114 @@ bool SV_IsPlayerAllowedToSee(player_t &p, AActor *mo)
 
 #define HARDWARE_CAPABILITY 1000
 
+// Most actors a client is told about per tic
+static const int SV_AWARENESS_BUDGET = 32;
+
+// Most spawn queue entries looked at per client per tic
+static const int SV_AWARENESS_DRAIN = 256;
+
 //
-// SV_UpdateHiddenMobj
+// SV_QueueHiddenMobjs
 //
-void SV_UpdateHiddenMobj (void)
+// Queues every actor a client has not been told about, for a client that
+// joins a level that is already running.  This is the only walk over all of
+// the actors, and it happens once per connection or level change.
+//
+static void SV_QueueHiddenMobjs(player_t &pl)
 {
-	// denis - todo - throttle this
+	while (!pl.to_spawn.empty())
+		pl.to_spawn.pop();
+
 	AActor *mo;
 	TThinkerIterator<AActor> iterator;
-
-	for (Players::iterator it = players.begin();it != players.end();++it)
+	while ((mo = iterator.Next()))
 	{
-		player_t &pl = *it;
+		awareness_stats.walked++;
 
-		if(!pl.mo)
+		if (mo->player || mo->players_aware.get(pl.id))
 			continue;
 
-		int updated = 0;
+		pl.to_spawn.push(mo->ptr());
+		awareness_stats.queued++;
+	}
+}
 
-		while(!pl.to_spawn.empty())
-		{
-			mo = pl.to_spawn.front();
+//
+// SV_DrainHiddenMobjs
+//
+// Tells a client about a bounded number of the actors in its spawn queue and
+// brings its awareness of the player actors up to date, as those can become
+// hidden or visible when a player spectates or changes teams.
+//
+static void SV_DrainHiddenMobjs(player_t &pl)
+{
+	if (!pl.mo)
+		return;
 
-			pl.to_spawn.pop();
+	for (Players::iterator it = players.begin();it != players.end();++it)
+		if (it->mo)
+			awareness_stats.updated += SV_AwarenessUpdate(pl, it->mo);
 
-			if(mo && !mo->WasDestroyed())
-				updated += SV_AwarenessUpdate(pl, mo);
+	int updated = 0, drained = 0;
 
-			if(updated > 16)
-				break;
-		}
+	while (!pl.to_spawn.empty() && updated < SV_AWARENESS_BUDGET &&
+		   drained < SV_AWARENESS_DRAIN)
+	{
+		AActor *mo = pl.to_spawn.front();
 
-		while ( (mo = iterator.Next() ) )
-		{
+		pl.to_spawn.pop();
+		drained++;
+
+		if(mo && !mo->WasDestroyed())
 			updated += SV_AwarenessUpdate(pl, mo);
+	}
 
-			if(updated > 16)
-				break;
-		}
+	awareness_stats.drained += drained;
+	awareness_stats.updated += updated;
+}
+
+//
+// SV_UpdateHiddenMobj
+//
+// Brings every client's actor awareness up to date, once per tic.
+//
+void SV_UpdateHiddenMobj (void)
+{
+	for (Players::iterator it = players.begin();it != players.end();++it)
+	{
+		SV_DrainHiddenMobjs(*it);
+		awareness_stats.backlog += it->to_spawn.size();
+	}
+
+	tic_awareness_stats[tic_awareness_index] = awareness_stats;
+	tic_awareness_index = (tic_awareness_index + 1) % TICRATE;
+	awareness_stats = awareness_stats_t();
+}
+
+BEGIN_COMMAND (awarenessstats)
+{
+	const awareness_stats_t &last =
+		tic_awareness_stats[(tic_awareness_index + TICRATE - 1) % TICRATE];
+
+	awareness_stats_t total;
+	unsigned int peak = 0;
+	for (size_t i = 0; i < TICRATE; i++)
+	{
+		const awareness_stats_t &s = tic_awareness_stats[i];
+
+		total.queued += s.queued;
+		total.drained += s.drained;
+		total.updated += s.updated;
+		total.walked += s.walked;
+		peak = MAX(peak, s.drained);
 	}
+
+	Printf(PRINT_HIGH, "Last tic: %u queued, %u drained, %u updated, %u walked, %u waiting\n",
+		last.queued, last.drained, last.updated, last.walked, last.backlog);
+	Printf(PRINT_HIGH, "Last second: %u queued, %u drained (peak %u/tic), %u updated, %u walked\n",
+		total.queued, total.drained, peak, total.updated, total.walked);
 }
+END_COMMAND (awarenessstats)
 
 //
 // SV_UpdateSectors
@@ -1610,7 +1793,8 @@ void SV_ClientFullUpdate(player_t &pl)
 			MSG_WriteShort(&cl->reliablebuf, TEAMpoints[i]);
 	}
 
-	SV_UpdateHiddenMobj();
+	SV_QueueHiddenMobjs(pl);
+	SV_DrainHiddenMobjs(pl);
 
 	// update flags
 	if (sv_gametype == GM_CTF)
@@ -1890,7 +2074,7 @@ void SV_ConnectClient()
 	client_t* cl = &(player->client);
 
 	// clear client network info
-	cl->address = net_from;
+	SV_SetPlayerAddress(*player, net_from);
 	cl->last_received = gametic;
 	cl->reliable_bps = 0;
 	cl->unreliable_bps = 0;
@@ -1910,6 +2094,9 @@ void SV_ConnectClient()
 	SZ_Clear(&cl->netbuf);
 	SZ_Clear(&cl->reliablebuf);
 	SZ_Clear(&cl->relpackets);
+	cl->reliable.clear();
+	for (int i = 0; i < NUMNETPRIORITIES; i++)
+		cl->netqueue[i].clear();
 
 	memset(cl->packetseq, -1, sizeof(cl->packetseq));
 	memset(cl->packetbegin, 0, sizeof(cl->packetbegin));
@@ -1945,6 +2132,8 @@ void SV_ConnectClient()
 
 	// get rate value
 	SV_SetClientRate(*cl, MSG_ReadLong());
+	cl->rate_tokens = 0;
+	SV_RefillRate(cl);
 
 	if (SV_BanCheck(cl))
 	{
@@ -1967,6 +2156,13 @@ void SV_ConnectClient()
 		return;
 	}
 
+	// Newer clients append the optional protocol features they support.
+	// Older servers never read this far, so it does not need a GAMEVER bump.
+	cl->netcaps = 0;
+	if (MSG_BytesLeft() >= 4)
+		cl->netcaps = MSG_ReadLong();
+	cl->delta.clear();
+
 	// send consoleplayer number
 	MSG_WriteMarker(&cl->reliablebuf, svc_consoleplayer);
 	MSG_WriteByte(&cl->reliablebuf, player->id);
@@ -2133,16 +2329,40 @@ void SV_DisconnectClient(player_t &who)
 
 
 //
-// SV_DropClient
-// Called when the player is leaving the server unwillingly.
+// SV_SendDisconnect
 //
-void SV_DropClient(player_t &who)
+// Tells a client it is being disconnected.  The reliable channel may have a
+// backlog queued that would hold svc_disconnect back, so a client using it
+// is sent whatever is due and then svc_disconnect in a packet of its own.
+//
+static void SV_SendDisconnect(player_t &who)
 {
 	client_t *cl = &who.client;
 
-	MSG_WriteMarker(&cl->reliablebuf, svc_disconnect);
+	if (!(cl->netcaps & NETCAP_RELIABLE))
+	{
+		MSG_WriteMarker(&cl->reliablebuf, svc_disconnect);
+		SV_SendPacket(who);
+		return;
+	}
 
 	SV_SendPacket(who);
+	cl->flushPending();
+
+	static buf_t smallbuf(16);
+	SZ_Clear(&smallbuf);
+	MSG_WriteLong(&smallbuf, cl->sequence++);
+	MSG_WriteMarker(&smallbuf, svc_disconnect);
+	NET_SendPacket(smallbuf, cl->address);
+}
+
+//
+// SV_DropClient
+// Called when the player is leaving the server unwillingly.
+//
+void SV_DropClient(player_t &who)
+{
+	SV_SendDisconnect(who);
 
 	SV_DisconnectClient(who);
 }
@@ -2154,16 +2374,13 @@ void SV_SendDisconnectSignal()
 {
 	for (Players::iterator it = players.begin();it != players.end();++it)
 	{
-		client_t *cl = &(it->client);
-
-		MSG_WriteMarker(&cl->reliablebuf, svc_disconnect);
-		SV_SendPacket(*it);
+		SV_SendDisconnect(*it);
 
 		if (it->mo)
 			it->mo->Destroy();
 	}
 
-	players.clear();
+	SV_ClearPlayers();
 }
 
 //
@@ -2182,7 +2399,7 @@ void SV_SendReconnectSignal()
 			it->mo->Destroy();
 	}
 
-	players.clear();
+	SV_ClearPlayers();
 }
 
 //
@@ -2211,6 +2428,9 @@ void SV_SendLoadMap(const std::vector<std::string> &wadnames,
 	buf_t *buf = &(player->client.reliablebuf);
 	MSG_WriteMarker(buf, svc_loadmap);
 
+	// the client forgets its delta baselines when it loads the map
+	player->client.delta.clear();
+
 	// send list of wads (skip over wadnames[0] == odamex.wad)
 	MSG_WriteByte(buf, MIN<size_t>(wadnames.size() - 1, 255));
 	for (size_t i = 1; i < MIN<size_t>(wadnames.size(), 256); i++)
@@ -2867,59 +3087,308 @@ bool SV_PrivMsg(player_t &player)
 }
 
 //
-// SV_UpdateMissiles
-// Updates missiles position sometimes.
+// SV_UseNetDelta
 //
-void SV_UpdateMissiles(player_t &pl)
+// Returns true if movement updates for this client should be sent as deltas
+// against the states it has acknowledged.
+//
+static bool SV_UseNetDelta(const client_t *cl)
 {
-    AActor *mo;
+	return sv_netdelta && (cl->netcaps & NETCAP_DELTASTATE);
+}
 
-    TThinkerIterator<AActor> iterator;
-    while ( (mo = iterator.Next() ) )
-    {
-        if (!(mo->flags & MF_MISSILE || mo->flags & MF_SKULLFLY))
-			continue;
+//
+// SV_WriteMobjDelta
+//
+// Replaces the svc_movemobj and svc_mobjspeedangle pair for clients that
+// support delta-compressed movement.
+//
+static void SV_WriteMobjDelta(client_t *cl, AActor *mo)
+{
+	NetEntityState state;
+	state.x = mo->x;
+	state.y = mo->y;
+	state.z = mo->z;
+	state.momx = mo->momx;
+	state.momy = mo->momy;
+	state.momz = mo->momz;
+	state.angle = mo->angle;
+	state.extra = mo->rndindex;
 
+	buf_t *buf = SV_StartMessage(cl, NETPRI_ACTORS, svc_movemobj_delta);
+	MSG_WriteShort(buf, mo->netid);
+	cl->delta.write(buf, mo->netid, state, gametic);
+}
+
+//
+// SV_WriteMobjMove
+//
+// Sends an actor's position, angle and momentum.
+//
+static void SV_WriteMobjMove(client_t *cl, AActor *mo)
+{
+	buf_t *buf = SV_StartMessage(cl, NETPRI_ACTORS, svc_movemobj);
+	MSG_WriteShort(buf, mo->netid);
+	MSG_WriteByte(buf, mo->rndindex);
+	MSG_WriteLong(buf, mo->x);
+	MSG_WriteLong(buf, mo->y);
+	MSG_WriteLong(buf, mo->z);
+
+	buf = SV_StartMessage(cl, NETPRI_ACTORS, svc_mobjspeedangle);
+	MSG_WriteShort(buf, mo->netid);
+	MSG_WriteLong(buf, mo->angle);
+	MSG_WriteLong(buf, mo->momx);
+	MSG_WriteLong(buf, mo->momy);
+	MSG_WriteLong(buf, mo->momz);
+}
+
+//
+// SV_ActorUpdateInterval
+//
+// Returns the number of tics between position updates of an actor, or 0 if
+// SV_UpdateMissiles and SV_UpdateMonsters do not update it at all.
+//
+static int SV_ActorUpdateInterval(AActor *mo)
+{
+	if (mo->flags & MF_MISSILE || mo->flags & MF_SKULLFLY)
+	{
 		if (mo->type == MT_PLASMA)
-			continue;
+			return 0;
 
-		// update missile position every 30 tics
-		if (((gametic+mo->netid) % 30) && (mo->type != MT_TRACER) && (mo->type != MT_FATSHOT))
-			continue;
-		// Revenant tracers and Mancubus fireballs need to be  updated more often
-		else if (((gametic+mo->netid) % 5) && (mo->type == MT_TRACER || mo->type == MT_FATSHOT))
+		// Revenant tracers and Mancubus fireballs need to be updated more often
+		if (mo->type == MT_TRACER || mo->type == MT_FATSHOT)
+			return 5;
+
+		return 30;
+	}
+
+	// Ignore corpses.
+	if (mo->flags & MF_CORPSE)
+		return 0;
+
+	// We don't handle updating non-monsters here.
+	if (!(mo->flags & MF_COUNTKILL || mo->type == MT_SKULL))
+		return 0;
+
+	return 7;
+}
+
+// An actor due for a position update and the blockmap block it is in
+struct actorupdate_t
+{
+	AActor	*mo;
+	int		block;
+};
+
+// A run of the actors due for an update that are in the same block
+struct updatebucket_t
+{
+	int		bx, by;
+	size_t	first, last;		// range in the update list, last excluded
+};
+
+// missiles and monsters due for a position update this tic, sorted by block
+static std::vector<actorupdate_t> update_missiles;
+static std::vector<actorupdate_t> update_monsters;
+static std::vector<updatebucket_t> missile_buckets;
+static std::vector<updatebucket_t> monster_buckets;
+
+//
+// SV_ActorBlock
+//
+// Returns the blockmap column and row of a point, clamped to the blockmap.
+//
+static void SV_ActorBlock(fixed_t x, fixed_t y, int &bx, int &by)
+{
+	bx = clamp((x - bmaporgx) >> MAPBLOCKSHIFT, 0, bmapwidth - 1);
+	by = clamp((y - bmaporgy) >> MAPBLOCKSHIFT, 0, bmapheight - 1);
+}
+
+static bool SV_CompareActorUpdates(const actorupdate_t &a, const actorupdate_t &b)
+{
+	return a.block < b.block;
+}
+
+//
+// SV_BucketActorUpdates
+//
+// Sorts the actors due for an update by block and splits them into a bucket
+// per block, so that the distance to a client is worked out once per block
+// instead of once per actor.  Actors in a block keep their thinker order.
+//
+static void SV_BucketActorUpdates(std::vector<actorupdate_t> &updates,
+								  std::vector<updatebucket_t> &buckets)
+{
+	buckets.clear();
+
+	std::stable_sort(updates.begin(), updates.end(), SV_CompareActorUpdates);
+
+	for (size_t i = 0; i < updates.size(); i++)
+	{
+		if (buckets.empty() || updates[i].block != updates[buckets.back().first].block)
+		{
+			updatebucket_t bucket;
+			bucket.bx = updates[i].block % bmapwidth;
+			bucket.by = updates[i].block / bmapwidth;
+			bucket.first = i;
+			buckets.push_back(bucket);
+		}
+
+		buckets.back().last = i + 1;
+	}
+}
+
+//
+// SV_GatherActorUpdates
+//
+// Collects the actors due for a position update once per tic, so that every
+// client does not have to walk all of the thinkers.
+//
+static void SV_GatherActorUpdates()
+{
+	update_missiles.clear();
+	update_monsters.clear();
+
+	AActor *mo;
+	TThinkerIterator<AActor> iterator;
+	while ((mo = iterator.Next()))
+	{
+		int interval = SV_ActorUpdateInterval(mo);
+		if (!interval || (gametic + mo->netid) % interval)
 			continue;
 
-		if(SV_IsPlayerAllowedToSee(pl, mo))
+		int bx, by;
+		SV_ActorBlock(mo->x, mo->y, bx, by);
+
+		actorupdate_t update;
+		update.mo = mo;
+		update.block = by * bmapwidth + bx;
+
+		if (mo->flags & MF_MISSILE || mo->flags & MF_SKULLFLY)
+			update_missiles.push_back(update);
+		else if (mo->target)
+			update_monsters.push_back(update);
+	}
+
+	SV_BucketActorUpdates(update_missiles, missile_buckets);
+	SV_BucketActorUpdates(update_monsters, monster_buckets);
+}
+
+//
+// SV_GetViewActor
+//
+// Returns the actor a client is watching the world from.
+//
+static AActor *SV_GetViewActor(player_t &pl)
+{
+	player_t &target = idplayer(pl.spying);
+	if (validplayer(target) && target.mo && P_CanSpy(pl, target))
+		return target.mo;
+
+	return pl.mo;
+}
+
+//
+// SV_IsBucketFar
+//
+// Returns true if the block of a bucket is more than SV_RELEVANCE_NEAR
+// blocks away from the viewer.
+//
+static const int SV_RELEVANCE_NEAR = 8;	// in blockmap blocks
+
+static bool SV_IsBucketFar(AActor *view, const updatebucket_t &bucket)
+{
+	if (!sv_netrelevance || !view)
+		return false;
+
+	int vbx, vby;
+	SV_ActorBlock(view->x, view->y, vbx, vby);
+
+	return MAX(abs(bucket.bx - vbx), abs(bucket.by - vby)) > SV_RELEVANCE_NEAR;
+}
+
+//
+// SV_IsActorRelevant
+//
+// Decides if a client should get this tic's update of an actor.  Actors
+// in a block near the viewer that it can potentially see are updated at the
+// normal rate.  Actors that are either in a far block or hidden are updated
+// every other time and those that are both, every fourth time.  Hidden
+// means outside the viewer's subsector PVS, or with no sight tables, in a
+// sector the reject table hides.  The client keeps moving them in between,
+// and an actor the client has not been told about is never sent (see
+// SV_IsPlayerAllowedToSee).
+//
+static bool SV_IsActorRelevant(AActor *view, AActor *mo, bool distant)
+{
+	if (!sv_netrelevance || !view || view == mo)
+		return true;
+
+	int divisor = distant ? 2 : 1;
+
+	if (view->subsector && mo->subsector)
+	{
+		if (subsectorpvs)
 		{
-			client_t *cl = &pl.client;
-
-			MSG_WriteMarker (&cl->netbuf, svc_movemobj);
-			MSG_WriteShort (&cl->netbuf, mo->netid);
-			MSG_WriteByte (&cl->netbuf, mo->rndindex);
-			MSG_WriteLong (&cl->netbuf, mo->x);
-			MSG_WriteLong (&cl->netbuf, mo->y);
-			MSG_WriteLong (&cl->netbuf, mo->z);
-
-			MSG_WriteMarker (&cl->netbuf, svc_mobjspeedangle);
-			MSG_WriteShort(&cl->netbuf, mo->netid);
-			MSG_WriteLong (&cl->netbuf, mo->angle);
-			MSG_WriteLong (&cl->netbuf, mo->momx);
-			MSG_WriteLong (&cl->netbuf, mo->momy);
-			MSG_WriteLong (&cl->netbuf, mo->momz);
-
-			if (mo->tracer)
+			if (!P_PotentiallyVisible(view->subsector, mo->subsector))
+				divisor *= 2;
+		}
+		else if (!rejectempty)
+		{
+			int pnum = (view->subsector->sector - sectors) * numsectors +
+					   (mo->subsector->sector - sectors);
+
+			if (rejectmatrix[pnum >> 3] & (1 << (pnum & 7)))
+				divisor *= 2;
+		}
+	}
+
+	return ((gametic + mo->netid) / SV_ActorUpdateInterval(mo)) % divisor == 0;
+}
+
+//
+// SV_UpdateMissiles
+// Updates missiles position sometimes.
+//
+void SV_UpdateMissiles(player_t &pl)
+{
+	AActor *view = SV_GetViewActor(pl);
+
+	for (size_t b = 0; b < missile_buckets.size(); b++)
+	{
+		const updatebucket_t &bucket = missile_buckets[b];
+		const bool distant = SV_IsBucketFar(view, bucket);
+
+		for (size_t i = bucket.first; i < bucket.last; i++)
+		{
+			AActor *mo = update_missiles[i].mo;
+
+			if(SV_IsPlayerAllowedToSee(pl, mo) && SV_IsActorRelevant(view, mo, distant))
 			{
-				MSG_WriteMarker (&cl->netbuf, svc_actor_tracer);
-				MSG_WriteShort(&cl->netbuf, mo->netid);
-				MSG_WriteShort (&cl->netbuf, mo->tracer->netid);
-			}
+				client_t *cl = &pl.client;
+
+				if (SV_UseNetDelta(cl))
+				{
+					SV_WriteMobjDelta(cl, mo);
+				}
+				else
+				{
+					SV_WriteMobjMove(cl, mo);
+				}
+
+				if (mo->tracer)
+				{
+					buf_t *buf = SV_StartMessage(cl, NETPRI_ACTORS, svc_actor_tracer);
+					MSG_WriteShort(buf, mo->netid);
+					MSG_WriteShort (buf, mo->tracer->netid);
+				}
 
-            if (cl->netbuf.cursize >= 1024)
-                if(!SV_SendPacket(pl))
-                    return;
+				if (cl->netqueue[NETPRI_ACTORS].buf.cursize >= 1024)
+					if(!SV_SendPacket(pl))
+						return;
+			}
 		}
-    }
+	}
 }
 
 // Update the given actors state immediately.
@@ -2945,54 +3414,44 @@ void SV_UpdateMobjState(AActor *mo)
 // Keep tabs on monster positions and angles.
 void SV_UpdateMonsters(player_t &pl)
 {
-	AActor *mo;
+	AActor *view = SV_GetViewActor(pl);
 
-	TThinkerIterator<AActor> iterator;
-	while ((mo = iterator.Next()))
+	for (size_t b = 0; b < monster_buckets.size(); b++)
 	{
-		// Ignore corpses.
-		if (mo->flags & MF_CORPSE)
-			continue;
-
-		// We don't handle updating non-monsters here.
-		if (!(mo->flags & MF_COUNTKILL || mo->type == MT_SKULL))
-			continue;
+		const updatebucket_t &bucket = monster_buckets[b];
+		const bool distant = SV_IsBucketFar(view, bucket);
 
-		// update monster position every 7 tics
-		if ((gametic+mo->netid) % 7)
-			continue;
-
-		if (SV_IsPlayerAllowedToSee(pl, mo) && mo->target)
+		for (size_t i = bucket.first; i < bucket.last; i++)
 		{
-			client_t *cl = &pl.client;
-
-			MSG_WriteMarker(&cl->netbuf, svc_movemobj);
-			MSG_WriteShort(&cl->netbuf, mo->netid);
-			MSG_WriteByte(&cl->netbuf, mo->rndindex);
-			MSG_WriteLong(&cl->netbuf, mo->x);
-			MSG_WriteLong(&cl->netbuf, mo->y);
-			MSG_WriteLong(&cl->netbuf, mo->z);
-
-			MSG_WriteMarker(&cl->netbuf, svc_mobjspeedangle);
-			MSG_WriteShort(&cl->netbuf, mo->netid);
-			MSG_WriteLong(&cl->netbuf, mo->angle);
-			MSG_WriteLong(&cl->netbuf, mo->momx);
-			MSG_WriteLong(&cl->netbuf, mo->momy);
-			MSG_WriteLong(&cl->netbuf, mo->momz);
-
-			MSG_WriteMarker(&cl->netbuf, svc_actor_movedir);
-			MSG_WriteShort(&cl->netbuf, mo->netid);
-			MSG_WriteByte(&cl->netbuf, mo->movedir);
-			MSG_WriteLong(&cl->netbuf, mo->movecount);
-
-			MSG_WriteMarker(&cl->netbuf, svc_actor_target);
-			MSG_WriteShort(&cl->netbuf, mo->netid);
-			MSG_WriteShort(&cl->netbuf, mo->target->netid);
-
-			if (cl->netbuf.cursize >= 1024)
+			AActor *mo = update_monsters[i].mo;
+
+			if (SV_IsPlayerAllowedToSee(pl, mo) && SV_IsActorRelevant(view, mo, distant))
 			{
-				if (!SV_SendPacket(pl))
-					return;
+				client_t *cl = &pl.client;
+
+				if (SV_UseNetDelta(cl))
+				{
+					SV_WriteMobjDelta(cl, mo);
+				}
+				else
+				{
+					SV_WriteMobjMove(cl, mo);
+				}
+
+				buf_t *buf = SV_StartMessage(cl, NETPRI_ACTORS, svc_actor_movedir);
+				MSG_WriteShort(buf, mo->netid);
+				MSG_WriteByte(buf, mo->movedir);
+				MSG_WriteLong(buf, mo->movecount);
+
+				buf = SV_StartMessage(cl, NETPRI_ACTORS, svc_actor_target);
+				MSG_WriteShort(buf, mo->netid);
+				MSG_WriteShort(buf, mo->target->netid);
+
+				if (cl->netqueue[NETPRI_ACTORS].buf.cursize >= 1024)
+				{
+					if (!SV_SendPacket(pl))
+						return;
+				}
 			}
 		}
 	}
@@ -3154,8 +3613,14 @@ void SV_UpdateDeadPlayers()
 //
 // SV_ClearClientsBPS
 //
+// Refills every client's rate each tic and resets the bytes per second
+// counters each second.
+//
 void SV_ClearClientsBPS(void)
 {
+	for (Players::iterator it = players.begin();it != players.end();++it)
+		SV_RefillRate(&it->client);
+
 	if (!P_AtInterval(TICRATE))
 		return;
 
@@ -3168,11 +3633,68 @@ void SV_ClearClientsBPS(void)
 	}
 }
 
+//
+// Parallel packet building
+//
+// With sv_netthreads above 1, every client's packet is built and sent on
+// the worker pool once the world has finished ticking.  The world is only
+// read during that time.  Each job writes to its own client's buffers alone,
+// and the few things shared between clients are taken care of on the main
+// thread beforehand: the svc_moveplayer records are encoded up front and
+// actor awareness is updated before fanning out.  net_message is not used at
+// all, since every incoming packet has been parsed by SV_GetPackets already.
+//
+// Anything a job can not do on its own is left for the main thread after
+// the join: a client whose reliable buffer overflowed is dropped there.
+//
+
+// the client whose packet is being built by the current job
+static THREAD_LOCAL player_t *net_job_player = NULL;
+
+static bool SV_ParallelNet()
+{
+	return sv_netthreads > 1 && I_GetWorkerThreads() > 0;
+}
+
+//
+// SV_DropOverflowedClients
+//
+// Drops the clients whose packets could not be sent by a parallel job.
+//
+static void SV_DropOverflowedClients()
+{
+	for (Players::iterator it = players.begin(); it != players.end(); ++it)
+	{
+		if (it->client.reliablebuf.overflowed)
+			SV_SendPacket(*it);
+	}
+}
+
+static void SV_SendPacketJob(void *data, size_t index)
+{
+	player_t *player = (*(std::vector<player_t *> *)data)[index];
+
+	net_job_player = player;
+	SV_SendPacket(*player);
+	net_job_player = NULL;
+}
+
 //
 // SV_SendPackets
 //
 void SV_SendPackets()
 {
+	PROFILE_SCOPE(SV_SendPackets);
+
+	// MSG_WriteMarker sends early when a buffer fills up.  Inside a job only
+	// the job's own client can be sent to.
+	if (I_InParallel())
+	{
+		if (net_job_player)
+			SV_SendPacket(*net_job_player);
+		return;
+	}
+
 	if (players.empty())
 		return;
 
@@ -3189,10 +3711,13 @@ void SV_SendPackets()
 		++begin;
 
 	// Loop through all players in a staggered fashion.
+	std::vector<player_t *> order;
+	order.reserve(num_players);
+
 	Players::iterator it = begin;
 	do
 	{
-		SV_SendPacket(*it);
+		order.push_back(&*it);
 
 		++it;
 		if (it == players.end())
@@ -3200,8 +3725,21 @@ void SV_SendPackets()
 	}
 	while (it != begin);
 
+	if (SV_ParallelNet())
+	{
+		I_RunParallel(SV_SendPacketJob, &order, order.size());
+		SV_DropOverflowedClients();
+	}
+	else
+	{
+		for (size_t i = 0; i < order.size(); i++)
+			SV_SendPacket(*order[i]);
+	}
+
 	// Advance the send index.
 	fair_send++;
+
+	NET_FlushPackets();
 }
 
 void SV_SendPlayerStateUpdate(client_t *client, player_t *player)
@@ -3245,105 +3783,241 @@ void SV_SpyPlayer(player_t &viewer)
 }
 
 //
-// SV_WriteCommands
+// Shared svc_moveplayer encoding
 //
-void SV_WriteCommands(void)
+// Apart from the acknowledged tic, a player's svc_moveplayer message is
+// identical for every client it is sent to.  Encode each player's movement
+// record once per tic into a shared arena and copy the pre-encoded bytes into
+// each client's packet instead of serializing it again for every receiver.
+//
+struct moveplayer_record_t
 {
-	// [SL] 2011-05-11 - Save player positions and moving sector heights so
-	// they can be reconciled later for unlagging
-	Unlag::getInstance().recordPlayerPositions();
-	Unlag::getInstance().recordSectorPositions();
+	int		gametic;
+	size_t	offset, length;
+};
 
-	for (Players::iterator it = players.begin(); it != players.end(); ++it)
+static buf_t moveplayer_arena(MAX_UDP_PACKET);
+static moveplayer_record_t moveplayer_records[MAXPLAYERS];
+
+static void SV_ClearMovePlayerRecords()
+{
+	moveplayer_arena.clear();
+	for (size_t i = 0; i < MAXPLAYERS; i++)
+		moveplayer_records[i].gametic = -1;
+}
+
+//
+// SV_GetMovePlayerRecord
+//
+// Returns the location of the player's movement record in moveplayer_arena,
+// encoding it first if this is the first request this tic.
+//
+static const moveplayer_record_t &SV_GetMovePlayerRecord(player_t &player)
+{
+	moveplayer_record_t &record = moveplayer_records[player.id];
+	if (record.gametic == gametic)
+		return record;
+
+	buf_t *buf = &moveplayer_arena;
+
+	record.gametic = gametic;
+	record.offset = buf->size();
+
+	MSG_WriteLong(buf, player.mo->x);
+	MSG_WriteLong(buf, player.mo->y);
+	MSG_WriteLong(buf, player.mo->z);
+
+	if (GAMEVER > 60)
 	{
-		client_t *cl = &(it->client);
+		MSG_WriteShort(buf, player.mo->angle >> FRACBITS);
+		MSG_WriteShort(buf, player.mo->pitch >> FRACBITS);
+	}
+	else
+	{
+		MSG_WriteLong(buf, player.mo->angle);
+	}
 
-		// Don't need to update origin every tic.
-		// The server sends origin and velocity of a
-		// player and the client always knows origin on
-		// on the next tic.
-		// HOWEVER, update as often as the player requests
-		if (P_AtInterval(it->userinfo.update_rate))
-		{
-			// [SL] 2011-05-11 - Send the client the server's gametic
-			// this gametic is returned to the server with the client's
-			// next cmd
-			if (it->ingame())
-				SV_SendGametic(cl);
+	if (player.mo->frame == 32773)
+		MSG_WriteByte(buf, PLAYER_FULLBRIGHTFRAME);
+	else
+		MSG_WriteByte(buf, player.mo->frame);
+
+	// write velocity
+	MSG_WriteLong(buf, player.mo->momx);
+	MSG_WriteLong(buf, player.mo->momy);
+	MSG_WriteLong(buf, player.mo->momz);
+
+	// [Russell] - hack, tell the client about the partial
+	// invisibility power of another player.. (cheaters can disable
+	// this but its all we have for now)
+	if (GAMEVER > 60)
+		MSG_WriteByte(buf, player.powers[pw_invisibility]);
+	else
+		MSG_WriteLong(buf, player.powers[pw_invisibility]);
 
-			for (Players::iterator pit = players.begin();pit != players.end();++pit)
-			{
-				if (!(pit->ingame()) || !(pit->mo))
-					continue;
+	record.length = buf->size() - record.offset;
 
-				// a player is updated about their own position elsewhere
-				if (&*it == &*pit)
-					continue;
+	return record;
+}
 
-				// GhostlyDeath -- Screw spectators
-				if (pit->spectator)
-					continue;
+//
+// SV_WritePlayerDelta
+//
+// Delta-compressed equivalent of svc_moveplayer for clients that support it.
+// The deltas depend on what each client has acknowledged, so unlike the
+// shared svc_moveplayer record they are encoded per receiver.
+//
+static void SV_WritePlayerDelta(player_t &viewer, player_t &player)
+{
+	client_t *cl = &viewer.client;
 
-				if(!SV_IsPlayerAllowedToSee(*it, pit->mo))
-					continue;
+	NetEntityState state;
+	state.x = player.mo->x;
+	state.y = player.mo->y;
+	state.z = player.mo->z;
+	state.momx = player.mo->momx;
+	state.momy = player.mo->momy;
+	state.momz = player.mo->momz;
+	state.angle = player.mo->angle >> FRACBITS;
+	state.pitch = player.mo->pitch >> FRACBITS;
 
-				MSG_WriteMarker(&cl->netbuf, svc_moveplayer);
-				MSG_WriteByte(&cl->netbuf, pit->id); // player number
+	if (player.mo->frame == 32773)
+		state.frame = PLAYER_FULLBRIGHTFRAME;
+	else
+		state.frame = (byte)player.mo->frame;
 
-				// [SL] 2011-09-14 - the most recently processed ticcmd from the
-				// client we're sending this message to.
-				MSG_WriteLong(&cl->netbuf, it->tic);
+	state.extra = (byte)player.powers[pw_invisibility];
 
-				MSG_WriteLong(&cl->netbuf, pit->mo->x);
-				MSG_WriteLong(&cl->netbuf, pit->mo->y);
-				MSG_WriteLong(&cl->netbuf, pit->mo->z);
+	buf_t *buf = SV_StartMessage(cl, NETPRI_PLAYERS, svc_moveplayer_delta);
+	MSG_WriteByte(buf, player.id);
+	MSG_WriteLong(buf, viewer.tic);
+	cl->delta.write(buf, NET_DELTA_PLAYERKEY | player.id, state, gametic);
+}
 
-				if (GAMEVER > 60)
-				{
-					MSG_WriteShort(&cl->netbuf, pit->mo->angle >> FRACBITS);
-					MSG_WriteShort(&cl->netbuf, pit->mo->pitch >> FRACBITS);
-				}
-				else
-				{
-					MSG_WriteLong(&cl->netbuf, pit->mo->angle);
-				}
+//
+// SV_WriteClientCommands
+//
+// Writes the per-tic updates for one client.  Only the client's own buffers
+// are written to, so this can run in parallel for different clients.
+//
+static void SV_WriteClientCommands(player_t &player)
+{
+	client_t *cl = &player.client;
 
-				if (pit->mo->frame == 32773)
-					MSG_WriteByte(&cl->netbuf, PLAYER_FULLBRIGHTFRAME);
-				else
-					MSG_WriteByte(&cl->netbuf, pit->mo->frame);
-
-				// write velocity
-				MSG_WriteLong(&cl->netbuf, pit->mo->momx);
-				MSG_WriteLong(&cl->netbuf, pit->mo->momy);
-				MSG_WriteLong(&cl->netbuf, pit->mo->momz);
-
-				// [Russell] - hack, tell the client about the partial
-				// invisibility power of another player.. (cheaters can disable
-				// this but its all we have for now)
-				if (GAMEVER > 60)
-					MSG_WriteByte(&cl->netbuf, pit->powers[pw_invisibility]);
-				else
-					MSG_WriteLong(&cl->netbuf, pit->powers[pw_invisibility]);
+	// Don't need to update origin every tic.
+	// The server sends origin and velocity of a
+	// player and the client always knows origin on
+	// on the next tic.
+	// HOWEVER, update as often as the player requests
+	if (P_AtInterval(player.userinfo.update_rate))
+	{
+		// [SL] 2011-05-11 - Send the client the server's gametic
+		// this gametic is returned to the server with the client's
+		// next cmd
+		if (player.ingame())
+			SV_SendGametic(cl);
+
+		for (Players::iterator pit = players.begin();pit != players.end();++pit)
+		{
+			if (!(pit->ingame()) || !(pit->mo))
+				continue;
+
+			// a player is updated about their own position elsewhere
+			if (&player == &*pit)
+				continue;
+
+			// GhostlyDeath -- Screw spectators
+			if (pit->spectator)
+				continue;
+
+			if(!SV_IsPlayerAllowedToSee(player, pit->mo))
+				continue;
+
+			if (SV_UseNetDelta(cl))
+			{
+				SV_WritePlayerDelta(player, *pit);
+				continue;
 			}
+
+			buf_t *buf = SV_StartMessage(cl, NETPRI_PLAYERS, svc_moveplayer);
+			MSG_WriteByte(buf, pit->id); // player number
+
+			// [SL] 2011-09-14 - the most recently processed ticcmd from the
+			// client we're sending this message to.
+			MSG_WriteLong(buf, player.tic);
+
+			// the rest of the message is the same for every client
+			const moveplayer_record_t &record = SV_GetMovePlayerRecord(*pit);
+			MSG_WriteChunk(buf, moveplayer_arena.ptr() + record.offset, record.length);
 		}
+	}
+
+	// [SL] Send client info about player he is spying on
+	player_t *target = &idplayer(player.spying);
+	if (validplayer(*target) && P_CanSpy(player, *target))
+		SV_SendPlayerStateUpdate(cl, target);
+
+	SV_UpdateConsolePlayer(player);
+
+	SV_UpdateMissiles(player);
+
+	SV_UpdateMonsters(player);
+
+	SV_SendPingRequest(cl);     // request ping reply
+
+	SV_UpdatePing(cl);          // send the ping value of all cients to this client
+}
+
+static void SV_WriteClientCommandsJob(void *data, size_t index)
+{
+	player_t *player = (*(std::vector<player_t *> *)data)[index];
 
-		// [SL] Send client info about player he is spying on
-		player_t *target = &idplayer(it->spying);
-		if (validplayer(*target) && P_CanSpy(*it, *target))
-			SV_SendPlayerStateUpdate(&(it->client), target);
+	net_job_player = player;
+	SV_WriteClientCommands(*player);
+	net_job_player = NULL;
+}
 
-		SV_UpdateHiddenMobj();
+//
+// SV_WriteCommands
+//
+void SV_WriteCommands(void)
+{
+	PROFILE_SCOPE(SV_WriteCommands);
 
-		SV_UpdateConsolePlayer(*it);
+	// [SL] 2011-05-11 - Save player positions and moving sector heights so
+	// they can be reconciled later for unlagging
+	Unlag::getInstance().recordPlayerPositions();
+	Unlag::getInstance().recordSectorPositions();
 
-		SV_UpdateMissiles(*it);
+	SV_ClearMovePlayerRecords();
 
-		SV_UpdateMonsters(*it);
+	// Actor awareness is shared between clients, so it is brought up to date
+	// for everyone before any client's updates are written.
+	SV_UpdateHiddenMobj();
 
-		SV_SendPingRequest(cl);     // request ping reply
+	SV_GatherActorUpdates();
 
-		SV_UpdatePing(cl);          // send the ping value of all cients to this client
+	if (SV_ParallelNet())
+	{
+		std::vector<player_t *> jobs;
+		jobs.reserve(players.size());
+
+		for (Players::iterator it = players.begin(); it != players.end(); ++it)
+		{
+			jobs.push_back(&*it);
+
+			// the shared records are written on first use, so do that now
+			if (it->ingame() && it->mo && !it->spectator)
+				SV_GetMovePlayerRecord(*it);
+		}
+
+		I_RunParallel(SV_WriteClientCommandsJob, &jobs, jobs.size());
+		SV_DropOverflowedClients();
+	}
+	else
+	{
+		for (Players::iterator it = players.begin(); it != players.end(); ++it)
+			SV_WriteClientCommands(*it);
 	}
 
 	SV_UpdateDeadPlayers(); // Update dying players.
@@ -3513,6 +4187,25 @@ void SV_UpdateConsolePlayer(player_t &player)
 		return;
 	}
 
+	if (SV_UseNetDelta(cl))
+	{
+		NetEntityState state;
+		state.x = mo->x;
+		state.y = mo->y;
+		state.z = mo->z;
+		state.momx = mo->momx;
+		state.momy = mo->momy;
+		state.momz = mo->momz;
+		state.extra = mo->waterlevel;
+
+		MSG_WriteMarker(&cl->netbuf, svc_updatelocalplayer_delta);
+		MSG_WriteLong(&cl->netbuf, player.tic);
+		cl->delta.write(&cl->netbuf, NET_DELTA_LOCALPLAYERKEY, state, gametic);
+
+		SV_UpdateMovingSectors(player);
+		return;
+	}
+
 	// client player will update his position if packets were missed
 	MSG_WriteMarker (&cl->netbuf, svc_updatelocalplayer);
 
@@ -4091,6 +4784,8 @@ void SV_SendPlayerInfo(player_t &player);
 
 void SV_ParseCommands(player_t &player)
 {
+	PROFILE_SCOPE(SV_ParseCommands);
+
 	 while(validplayer(player))
 	 {
 		clc_t cmd = (clc_t)MSG_ReadByte();
@@ -4143,6 +4838,10 @@ void SV_ParseCommands(player_t &player)
 			SV_AcknowledgePacket(player);
 			break;
 
+		case clc_reliableack:
+			SV_AcknowledgeReliable(player);
+			break;
+
 		case clc_rcon:
 			{
 				std::string str(MSG_ReadString());
@@ -4457,6 +5156,8 @@ void SV_IntermissionTimeCheck()
 //
 void SV_GameTics (void)
 {
+	PROFILE_SCOPE(SV_GameTics);
+
 	if (sv_gametype == GM_CTF)
 		CTF_RunTics();
 
@@ -4520,6 +5221,8 @@ bool SV_Frozen()
 //
 void SV_StepTics(QWORD count)
 {
+	PROFILE_SCOPE(SV_StepTics);
+
 	DObject::BeginFrame();
 
 	// run the newtime tics
@@ -4563,6 +5266,55 @@ void SV_DisplayTics()
 {
 }
 
+//
+// Per-tic network syscall accounting
+//
+// net_syscalls is reset at the start of every SV_RunTics call and
+// sampled at the end, giving the number of socket syscalls made per tic.
+//
+static net_syscall_stats_t tic_netstats[TICRATE];
+static size_t tic_netstats_index = 0;
+
+static void SV_BeginTicNetStats()
+{
+	net_syscalls = net_syscall_stats_t();
+}
+
+static void SV_EndTicNetStats()
+{
+	tic_netstats[tic_netstats_index] = net_syscalls;
+	tic_netstats_index = (tic_netstats_index + 1) % TICRATE;
+}
+
+BEGIN_COMMAND (netstats)
+{
+	const net_syscall_stats_t &last =
+		tic_netstats[(tic_netstats_index + TICRATE - 1) % TICRATE];
+
+	net_syscall_stats_t total, peak;
+	for (size_t i = 0; i < TICRATE; i++)
+	{
+		const net_syscall_stats_t &s = tic_netstats[i];
+
+		total.recv_calls += s.recv_calls;
+		total.recv_packets += s.recv_packets;
+		total.send_calls += s.send_calls;
+		total.send_packets += s.send_packets;
+
+		peak.recv_calls = MAX(peak.recv_calls, s.recv_calls);
+		peak.send_calls = MAX(peak.send_calls, s.send_calls);
+	}
+
+	Printf(PRINT_HIGH, "Batched I/O: %s\n", NET_BatchIOEnabled() ? "on" : "off");
+	Printf(PRINT_HIGH, "Last tic: %u recv syscalls (%u packets), %u send syscalls (%u packets)\n",
+		last.recv_calls, last.recv_packets, last.send_calls, last.send_packets);
+	Printf(PRINT_HIGH, "Last second: %u recv syscalls (%u packets, peak %u/tic), "
+		"%u send syscalls (%u packets, peak %u/tic)\n",
+		total.recv_calls, total.recv_packets, peak.recv_calls,
+		total.send_calls, total.send_packets, peak.send_calls);
+}
+END_COMMAND (netstats)
+
 //
 // SV_RunTics
 //
@@ -4570,6 +5322,9 @@ void SV_DisplayTics()
 //
 void SV_RunTics()
 {
+	SV_BeginTicNetStats();
+	FProfileTic proftic(sv_profiler);
+
 	SV_GetPackets();
 
 	std::string cmd = I_ConsoleInput();
@@ -4625,6 +5380,12 @@ void SV_RunTics()
 		G_InitNew(mapname);
 	}
 	last_player_count = players.size();
+
+	// send anything queued outside of SV_SendPackets
+	NET_FlushPackets();
+
+	proftic.end();
+	SV_EndTicNetStats();
 }
 
 
@@ -4973,19 +5734,7 @@ void SV_SendDamageMobj(AActor *target, int pain)
 		MSG_WriteShort(&cl->reliablebuf, target->health);
 		MSG_WriteByte(&cl->reliablebuf, pain);
 
-		MSG_WriteMarker (&cl->netbuf, svc_movemobj);
-		MSG_WriteShort (&cl->netbuf, target->netid);
-		MSG_WriteByte (&cl->netbuf, target->rndindex);
-		MSG_WriteLong (&cl->netbuf, target->x);
-		MSG_WriteLong (&cl->netbuf, target->y);
-		MSG_WriteLong (&cl->netbuf, target->z);
-
-		MSG_WriteMarker (&cl->netbuf, svc_mobjspeedangle);
-		MSG_WriteShort(&cl->netbuf, target->netid);
-		MSG_WriteLong (&cl->netbuf, target->angle);
-		MSG_WriteLong (&cl->netbuf, target->momx);
-		MSG_WriteLong (&cl->netbuf, target->momy);
-		MSG_WriteLong (&cl->netbuf, target->momz);
+		SV_WriteMobjMove(cl, target);
 	}
 }
 
@@ -5058,6 +5807,8 @@ void SV_SendDestroyActor(AActor *mo)
 				MSG_WriteMarker(&cl->reliablebuf, svc_removemobj);
 				MSG_WriteShort(&cl->reliablebuf, mo->netid);
 			}
+
+			it->client.delta.reset(mo->netid);
 		}
 	}
 
@@ -67,11 +67,15 @@ void SV_ConnectClient(void);
 void SV_WriteCommands(void);
 void SV_ClearClientsBPS(void);
 bool SV_SendPacket(player_t &pl);
+buf_t *SV_StartMessage(client_t *cl, netpriority_t priority, svc_t type);
+void SV_RefillRate(client_t *cl);
 void SV_AcknowledgePacket(player_t &player);
+void SV_AcknowledgeReliable(player_t &player);
 void SV_DisplayTics();
 void SV_RunTics();
 void SV_ParseCommands(player_t &player);
-short SV_FindClientByAddr(void);
+player_t &SV_FindPlayerByAddr(const netadr_t &addr);
+void SV_UnindexPlayerAddress(player_t &player);
 void SV_UpdateFrags (player_t &player);
 void SV_RemoveCorpses (void);
 void SV_DropClient(player_t &who);
@@ -31,144 +31,369 @@
 #include "sv_main.h"
 #include "huffman.h"
 #include "i_net.h"
+#include "i_thread.h"
+#include "stats.h"
 
 QWORD I_MSTime (void);
 
 EXTERN_CVAR (log_packetdebug)
 
-buf_t plain(MAX_UDP_PACKET); // denis - todo - call_terms destroys these statics on quit
-buf_t sendd(MAX_UDP_PACKET);
+// Tics of a client's rate that its token bucket can hold
+static const int SV_RATE_BURST = 4;
+
+// keeps log_packetdebug lines whole when packets are sent in parallel
+static I_Mutex packetdebug_mutex;
 
 //
 // SV_CompressPacket
 //
-// [Russell] - reason this was failing is because of huffman routines, so just
-// use minilzo for now (cuts a packet size down by roughly 45%), huffman is the
-// if 0'd sections
-void SV_CompressPacket(buf_t &send, unsigned int reserved, client_t *cl)
+// Compresses the payload of a packet with minilzo into the client's send
+// buffer, after the sequence number already there.  Returns false, leaving
+// only the sequence number in the send buffer, if that does not help.
+//
+// The adaptive huffman codecs (huffman_server/huffman_client) are still not
+// used, as both ends can end up swapping to different tables when packets
+// are lost or reordered.
+//
+static bool SV_CompressPacket(client_t *cl, const byte *data, size_t len)
 {
-	if(plain.maxsize() < send.maxsize())
-		plain.resize(send.maxsize());
-	
-	plain.setcursize(send.size());
-	
-	memcpy(plain.ptr(), send.ptr(), send.size());
-
-	byte method = 0;
-
-	int need_gap = 2; // for svc_compressed and method, below
-#if 0
-	if(MSG_CompressAdaptive(cl->compressor.get_codec(), send, reserved, need_gap))
+	PROFILE_SCOPE(SV_CompressPacket);
+
+	buf_t &out = cl->sendbuf;
+	size_t reserved = out.size();
+
+	out.WriteByte(svc_compressed);
+	out.WriteByte(minilzo_mask);
+
+	if (!MSG_CompressMinilzo(data, len, out))
 	{
-		reserved += need_gap;
-		need_gap = 0;
+		out.setcursize(reserved);
+		return false;
+	}
+
+	return true;
+}
+
+//
+// SV_WillCompress
+//
+// Returns true if SV_CompressPacket would try to compress a payload of
+// len bytes.
+//
+static bool SV_WillCompress(size_t len)
+{
+	return len >= MINILZO_COMPRESS_MINPACKETSIZE;
+}
+
+//
+// SV_StartMessage
+//
+// Starts an unreliable message in one of the client's priority queues and
+// returns the buffer to write the rest of it to.  Unlike MSG_WriteMarker,
+// this never sends a packet part way through a message.
+//
+buf_t *SV_StartMessage(client_t *cl, netpriority_t priority, svc_t type)
+{
+	client_t::netqueue_t &queue = cl->netqueue[priority];
+
+	// grow rather than overflow, as the queue is only emptied as fast as
+	// the rate allows
+	if (queue.buf.size() + 1024 >= queue.buf.maxsize())
+		queue.buf.resize(queue.buf.maxsize() * 2, false);
+
+	client_t::netmessage_t message;
+	message.start = queue.buf.size();
+	message.tic = gametic;
+	message.delta = -1;
+
+	// the NetDeltaEncoder::write call that follows the marker
+	if (type == svc_moveplayer_delta || type == svc_movemobj_delta)
+		message.delta = (int)cl->delta.pendingStates();
 
-		method |= adaptive_mask;
+	queue.messages.push_back(message);
+	queue.buf.WriteByte(type);
 
-		if(cl->compressor.get_codec_id())
-			method |= adaptive_select_mask;
+	return &queue.buf;
+}
+
+//
+// SV_HasQueuedMessages
+//
+static bool SV_HasQueuedMessages(const client_t *cl)
+{
+	for (int i = 0; i < NUMNETPRIORITIES; i++)
+		if (!cl->netqueue[i].messages.empty())
+			return true;
+
+	return false;
+}
+
+//
+// SV_PackMessages
+//
+// Moves the messages of a queue that fit in both the packet's remaining
+// space and the rate budget into the unreliable segment, in the order they
+// were written.  The ones that do not fit are deferred to the next packet if
+// they were written this tic and dropped if they were already deferred once.
+// States of deferred or dropped delta messages are discarded, since the
+// packet being built does not carry them.
+//
+static void SV_PackMessages(client_t *cl, client_t::netqueue_t &queue, size_t &space, int &budget)
+{
+	if (queue.buf.overflowed)
+	{
+		for (size_t i = 0; i < queue.messages.size(); i++)
+			if (queue.messages[i].delta >= 0)
+				cl->delta.discard(queue.messages[i].delta);
+		queue.clear();
+		return;
 	}
-#endif
-	DPrintf("SV_CompressPacket stage 2: %x %d\n", (int)method, (int)send.size());
 
-	if(MSG_CompressMinilzo(send, reserved, need_gap))
-		method |= minilzo_mask;
+	byte *data = queue.buf.ptr();
+	size_t kept = 0, keptsize = 0;
 
-	if((method & adaptive_mask) || (method & minilzo_mask))
+	for (size_t i = 0; i < queue.messages.size(); i++)
 	{
-#if 0
-		if(cl->compressor.packet_sent(cl->sequence - 1, plain.ptr() + sizeof(int), plain.size() - sizeof(int)))
-			method |= adaptive_record_mask;
-#endif
-		send.ptr()[sizeof(int)] = svc_compressed;
-		send.ptr()[sizeof(int) + 1] = method;
+		client_t::netmessage_t message = queue.messages[i];
+
+		size_t end = i + 1 < queue.messages.size() ? queue.messages[i + 1].start : queue.buf.size();
+		size_t len = end - message.start;
+
+		if (len <= space && (int)len <= budget)
+		{
+			SZ_Write(&cl->sendnet, data + message.start, len);
+			space -= len;
+			budget -= len;
+			continue;
+		}
+
+		if (message.delta >= 0)
+			cl->delta.discard(message.delta);
+
+		if (message.tic != gametic)
+			continue;
+
+		// the kept messages are moved to the front of the buffer, which
+		// never overwrites a message that has not been looked at yet
+		memmove(data + keptsize, data + message.start, len);
+
+		message.start = keptsize;
+		message.delta = -1;
+		queue.messages[kept++] = message;
+		keptsize += len;
 	}
-	DPrintf("SV_CompressPacket %x %d\n", (int)method, (int)send.size());
 
+	queue.messages.resize(kept);
+	queue.buf.setcursize(keptsize);
+}
+
+//
+// SV_RefillRate
+//
+// Adds a tic's worth of the client's rate to its token bucket.  The bucket
+// holds at most a few tics' worth, so a client that has been idle can not
+// send a burst, and its debt is limited so that a burst of reliable
+// messages does not hold back its unreliable ones for long.
+//
+void SV_RefillRate(client_t *cl)
+{
+	int per_tic = cl->rate * 1000 / TICRATE;
+
+	cl->rate_tokens = clamp(cl->rate_tokens + per_tic, -SV_RATE_BURST * per_tic,
+							SV_RATE_BURST * per_tic);
 }
 
 //
 // SV_SendPacket
 //
+// The packet is never assembled in one place.  The sequence number and any
+// compressed payload go in the client's send buffer, while an uncompressed
+// packet is sent straight out of the reliable and unreliable buffers, whose
+// storage is swapped with spare buffers rather than copied.  The network
+// code reads these buffers in place until the send queue is next flushed.
+//
+// For a client with NETCAP_RELIABLE, the reliable buffer is instead moved
+// into the client's reliable channel, which writes whatever fragments are
+// due into the reliable segment.  A burst of reliable messages is spread
+// over as many packets as it takes instead of overflowing the buffer.
+//
 bool SV_SendPacket(player_t &pl)
 {
-	int				bps = 0; // bytes per second, not bits per second
+	PROFILE_SCOPE(SV_SendPacket);
+
+	bool			unreliable_sent = false;
 
 	client_t *cl = &pl.client;
 
+	bool channel = (cl->netcaps & NETCAP_RELIABLE) != 0;
+	dtime_t now = channel ? I_MSTime() : 0;
+
+	// the reliable channel takes everything written to the reliable buffer
+	// and sends it when the window allows
+	if (channel && !cl->reliablebuf.overflowed && cl->reliablebuf.cursize)
+	{
+		cl->reliable.queue(cl->reliablebuf.ptr(), cl->reliablebuf.size());
+		SZ_Clear(&cl->reliablebuf);
+
+		if (cl->reliable.overflowed())
+			cl->reliablebuf.overflowed = true;
+	}
+
 	if (cl->reliablebuf.overflowed)
 	{ 
+		// dropping a client sends messages to every other client, so a
+		// parallel job leaves it to SV_DropOverflowedClients
+		if (I_InParallel())
+			return false;
+
 		SZ_Clear(&cl->netbuf);
 		SZ_Clear(&cl->reliablebuf);
+		cl->reliable.clear();
 	    SV_DropClient(pl);
 		return false;
 	}
 	else
 		if (cl->netbuf.overflowed)
+		{
 			SZ_Clear(&cl->netbuf);
+			cl->delta.packetSent(cl->sequence, false);
+		}
 
 	// [SL] 2012-05-04 - Don't send empty packets - they still have overhead
-	if (cl->reliablebuf.cursize + cl->netbuf.cursize == 0)
+	if (cl->reliablebuf.cursize + cl->netbuf.cursize == 0 &&
+		!(channel && cl->reliable.ready(now)) &&
+		!(cl->rate_tokens > 0 && SV_HasQueuedMessages(cl)))
 		return true;
 
-	sendd.clear();
+	// the previous packet may still be waiting to be sent out of the
+	// buffers that are about to be reused
+	cl->flushPending();
+
+	if (cl->sendbuf.maxsize() < MAX_UDP_PACKET)
+		cl->sendbuf.resize(MAX_UDP_PACKET);
+	if (cl->sendrel.maxsize() < cl->reliablebuf.maxsize())
+		cl->sendrel.resize(cl->reliablebuf.maxsize());
+	if (cl->sendnet.maxsize() < cl->netbuf.maxsize())
+		cl->sendnet.resize(cl->netbuf.maxsize());
 
-	// save the reliable message 
-	// it will be retransmited, if it's missed
+	if (!channel)
+	{
+		// save the reliable message 
+		// it will be retransmited, if it's missed
+
+		// the end of the buffer is reached
+		if (cl->relpackets.cursize + cl->reliablebuf.cursize >= cl->relpackets.maxsize())
+			cl->relpackets.cursize = 0;
 
-	// the end of the buffer is reached
-	if (cl->relpackets.cursize + cl->reliablebuf.cursize >= cl->relpackets.maxsize())
-		cl->relpackets.cursize = 0;
+		// copy the beginning and the size of a packet to the buffer
+		cl->packetbegin[cl->packetnum] = cl->relpackets.cursize;
+		cl->packetsize[cl->packetnum] = cl->reliablebuf.cursize;
+		cl->packetseq[cl->packetnum] = cl->sequence;
 
-	// copy the beginning and the size of a packet to the buffer
-	cl->packetbegin[cl->packetnum] = cl->relpackets.cursize;
-	cl->packetsize[cl->packetnum] = cl->reliablebuf.cursize;
-	cl->packetseq[cl->packetnum] = cl->sequence;
+		if (cl->reliablebuf.cursize)
+			SZ_Write (&cl->relpackets, cl->reliablebuf.data, cl->reliablebuf.cursize);
 
-	if (cl->reliablebuf.cursize)
-		SZ_Write (&cl->relpackets, cl->reliablebuf.data, cl->reliablebuf.cursize);
 
+		cl->packetnum++; // packetnum will never be more than 255
+		                 // because sizeof(packetnum) == 1. Don't need
+		                 // to use &0xff. Cool, eh? ;-)
+	}
 
-	cl->packetnum++; // packetnum will never be more than 255
-	                 // because sizeof(packetnum) == 1. Don't need
-	                 // to use &0xff. Cool, eh? ;-)
 	// copy sequence
-	MSG_WriteLong(&sendd, cl->sequence++);
-    
-	// copy the reliable message to the packet first
-    if (cl->reliablebuf.cursize)
-    {
-		SZ_Write (&sendd, cl->reliablebuf.data, cl->reliablebuf.cursize);
-		cl->reliable_bps += cl->reliablebuf.cursize;
-    }
+	cl->sendbuf.clear();
+	MSG_WriteLong(&cl->sendbuf, cl->sequence++);
+
+	// the reliable message goes first
+	cl->sendrel.clear();
+	if (channel)
+		cl->reliable.write(&cl->sendrel, NET_RELIABLE_PACKET, now);
+	else
+		cl->sendrel.swap(cl->reliablebuf);
+	cl->reliable_bps += cl->sendrel.cursize;
+
+	// reliable messages are never held back, but they use up the rate
+	cl->rate_tokens -= cl->sendrel.cursize;
 
 	// add the unreliable part if space is available and rate value
 	// allows it
-	if (gametic % 35)
-	    bps = (int)((double)( (cl->unreliable_bps + cl->reliable_bps) * TICRATE)/(double)(gametic%35));
+	size_t space = 0;
+	int budget = 0;
+
+	cl->sendnet.clear();
 
-    if (bps < cl->rate*1000)
+	// a nearly full reliable segment leaves no room at all, and the
+	// subtraction must not wrap around
+	if (cl->rate_tokens > 0 && cl->sendrel.cursize + sizeof(int) + 1 < MAX_UDP_PACKET)
+	{
+		space = MAX_UDP_PACKET - sizeof(int) - cl->sendrel.cursize - 1;
 
-	  if (cl->netbuf.cursize && (sendd.maxsize() - sendd.cursize > cl->netbuf.cursize) )
-	  {
-         SZ_Write (&sendd, cl->netbuf.data, cl->netbuf.cursize);
-	     cl->unreliable_bps += cl->netbuf.cursize;
-	  }
+		// netbuf holds the client's own state, which goes first
+		if (cl->netbuf.cursize <= space)
+		{
+			cl->sendnet.swap(cl->netbuf);
+			space -= cl->sendnet.cursize;
+			unreliable_sent = true;
+		}
+
+		budget = cl->rate_tokens - (int)cl->sendnet.cursize;
+	}
+
+	for (int i = 0; i < NUMNETPRIORITIES; i++)
+		SV_PackMessages(cl, cl->netqueue[i], space, budget);
+
+	cl->unreliable_bps += cl->sendnet.cursize;
+	cl->rate_tokens -= cl->sendnet.cursize;
+
+	// delta-compressed states only become baselines once the client
+	// acknowledges the packet carrying them
+	cl->delta.packetSent(cl->sequence - 1, unreliable_sent);
     
 	SZ_Clear(&cl->netbuf);
 	SZ_Clear(&cl->reliablebuf);
-	
+
+	// The compressors need the payload in one piece, so the unreliable part
+	// is only appended to the reliable one for a packet that will be
+	// compressed.  Any other packet is sent straight out of both buffers.
+	bool compress = SV_WillCompress(cl->sendrel.cursize + cl->sendnet.cursize);
+
+	if (compress && cl->sendrel.cursize && cl->sendnet.cursize)
+	{
+		SZ_Write (&cl->sendrel, cl->sendnet.data, cl->sendnet.cursize);
+		cl->sendnet.clear();
+	}
+
+	buf_t &payload = cl->sendrel.cursize ? cl->sendrel : cl->sendnet;
+
+	net_iovec_t iov[3];
+	size_t iovcnt = 1;
+
 	// compress the packet, but not the sequence id
-	if (sendd.size() > sizeof(int))
-		SV_CompressPacket(sendd, sizeof(int), cl);
+	if (!compress || !SV_CompressPacket(cl, payload.ptr(), payload.size()))
+	{
+		iov[1].data = cl->sendrel.ptr();
+		iov[1].len = cl->sendrel.size();
+		iov[2].data = cl->sendnet.ptr();
+		iov[2].len = cl->sendnet.size();
+		iovcnt = 3;
+	}
+
+	iov[0].data = cl->sendbuf.ptr();
+	iov[0].len = cl->sendbuf.size();
 
 	if (log_packetdebug)
 	{
+		size_t size = 0;
+		for (size_t i = 0; i < iovcnt; i++)
+			size += iov[i].len;
+
+		I_MutexLock lock(packetdebug_mutex);
 		Printf(PRINT_HIGH, "ply %03u, pkt %06u, size %04u, tic %07u, time %011u\n",
-			   pl.id, cl->sequence - 1, sendd.cursize, gametic, I_MSTime());
+			   pl.id, cl->sequence - 1, (unsigned)size, gametic, I_MSTime());
 	}
 
-	NET_SendPacket(sendd, cl->address);
+	// sent in a batch with the other clients' packets by SV_SendPackets
+	NET_QueuePacketv(iov, iovcnt, cl->address);
+	cl->sendflush = NET_FlushGeneration();
 
 	return true;
 }
@@ -183,9 +408,11 @@ void SV_AcknowledgePacket(player_t &player)
 	int sequence = MSG_ReadLong();
 
 	cl->compressor.packet_acked(sequence);
+	cl->delta.packetAcked(sequence);
 
 	// packet is missed
-	if (sequence - cl->last_sequence > 1)
+	// the reliable channel retransmits by itself, see SV_AcknowledgeReliable
+	if (!(cl->netcaps & NETCAP_RELIABLE) && sequence - cl->last_sequence > 1)
 	{
 		// resend
 		for (int seq = cl->last_sequence+1; seq < sequence; seq++)
@@ -232,5 +459,15 @@ void SV_AcknowledgePacket(player_t &player)
 	cl->last_sequence = sequence;
 }
 
+//
+// SV_AcknowledgeReliable
+//
+// Reads a clc_reliableack from a client using the reliable channel.
+//
+void SV_AcknowledgeReliable(player_t &player)
+{
+	player.client.reliable.readAck(&net_message, I_MSTime());
+}
+
 VERSION_CONTROL (sv_rproto_cpp, "$Id$")
 